@@ -0,0 +1,240 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ArrayArithmetic.h"
+#if ARRAY_ARITHMETIC_DISPATCH
+#include <immintrin.h>
+#endif
+
+const ArrayArithmeticKernels *ArrayArithmetic::kernels = NULL;
+
+static ArrayArithmeticIsa selectedIsa = ARRAY_ARITHMETIC_ISA_DEFAULT;
+static bool isInitialised = false;
+
+#if ARRAY_ARITHMETIC_DISPATCH
+
+#pragma mark - AVX2
+
+/*
+ * Each kernel first runs scalar until the output is aligned to the vector width, then processes
+ * whole vectors and finishes with a scalar (AVX2) or masked (AVX-512) tail. Every output sample is
+ * computed with a single correctly rounded operation on the same operands as in the other paths,
+ * and the kernels are compiled without FMA, so the results are bit-identical to them (apart from
+ * the sign and payload of NaNs). test/ArrayArithmeticIsa.cpp checks this for every kernel.
+ */
+
+#define ARRAY_ARITHMETIC_AVX2_ARRAY(_name, _op, _intrinsic) \
+  __attribute__((target("avx2"))) \
+  static void _name(float *input0, float *input1, float *output, int startIndex, int endIndex) { \
+    int i = startIndex; \
+    for (; i < endIndex && (((uintptr_t) (output+i)) & 0x1F); i++) output[i] = input0[i] _op input1[i]; \
+    for (; i + 8 <= endIndex; i += 8) { \
+      _mm256_store_ps(output+i, _intrinsic(_mm256_loadu_ps(input0+i), _mm256_loadu_ps(input1+i))); \
+    } \
+    for (; i < endIndex; i++) output[i] = input0[i] _op input1[i]; \
+  }
+
+#define ARRAY_ARITHMETIC_AVX2_CONSTANT(_name, _op, _intrinsic) \
+  __attribute__((target("avx2"))) \
+  static void _name(float *input, float constant, float *output, int startIndex, int endIndex) { \
+    int i = startIndex; \
+    for (; i < endIndex && (((uintptr_t) (output+i)) & 0x1F); i++) output[i] = input[i] _op constant; \
+    const __m256 constVec = _mm256_set1_ps(constant); \
+    for (; i + 8 <= endIndex; i += 8) { \
+      _mm256_store_ps(output+i, _intrinsic(_mm256_loadu_ps(input+i), constVec)); \
+    } \
+    for (; i < endIndex; i++) output[i] = input[i] _op constant; \
+  }
+
+ARRAY_ARITHMETIC_AVX2_ARRAY(addAvx2, +, _mm256_add_ps)
+ARRAY_ARITHMETIC_AVX2_CONSTANT(addConstantAvx2, +, _mm256_add_ps)
+ARRAY_ARITHMETIC_AVX2_ARRAY(subtractAvx2, -, _mm256_sub_ps)
+ARRAY_ARITHMETIC_AVX2_CONSTANT(subtractConstantAvx2, -, _mm256_sub_ps)
+ARRAY_ARITHMETIC_AVX2_ARRAY(multiplyAvx2, *, _mm256_mul_ps)
+ARRAY_ARITHMETIC_AVX2_CONSTANT(multiplyConstantAvx2, *, _mm256_mul_ps)
+ARRAY_ARITHMETIC_AVX2_ARRAY(divideAvx2, /, _mm256_div_ps)
+ARRAY_ARITHMETIC_AVX2_CONSTANT(divideConstantAvx2, /, _mm256_div_ps)
+
+__attribute__((target("avx2")))
+static void fillAvx2(float *input, float constant, int startIndex, int endIndex) {
+  int i = startIndex;
+  for (; i < endIndex && (((uintptr_t) (input+i)) & 0x1F); i++) input[i] = constant;
+  const __m256 constVec = _mm256_set1_ps(constant);
+  for (; i + 8 <= endIndex; i += 8) _mm256_store_ps(input+i, constVec);
+  for (; i < endIndex; i++) input[i] = constant;
+}
+
+__attribute__((target("avx2")))
+static void addManyPassAvx2(float **inputs, int numInputs, bool isAccumulating, float *output,
+    int startIndex, int endIndex) {
+  int i = startIndex;
+  for (; i < endIndex && (((uintptr_t) (output+i)) & 0x1F); i++) {
+    float sum = isAccumulating ? output[i] + inputs[0][i] : inputs[0][i];
+    for (int k = 1; k < numInputs; k++) sum += inputs[k][i];
+    output[i] = sum;
+  }
+  for (; i + 8 <= endIndex; i += 8) {
+    __m256 sum = isAccumulating ? _mm256_load_ps(output+i) : _mm256_loadu_ps(inputs[0]+i);
+    for (int k = isAccumulating ? 0 : 1; k < numInputs; k++) {
+      sum = _mm256_add_ps(sum, _mm256_loadu_ps(inputs[k]+i));
+    }
+    _mm256_store_ps(output+i, sum);
+  }
+  for (; i < endIndex; i++) {
+    float sum = isAccumulating ? output[i] + inputs[0][i] : inputs[0][i];
+    for (int k = 1; k < numInputs; k++) sum += inputs[k][i];
+    output[i] = sum;
+  }
+}
+
+static const ArrayArithmeticKernels avx2Kernels = {
+  addAvx2, addConstantAvx2,
+  subtractAvx2, subtractConstantAvx2,
+  multiplyAvx2, multiplyConstantAvx2,
+  divideAvx2, divideConstantAvx2,
+  fillAvx2,
+  addManyPassAvx2
+};
+
+#pragma mark - AVX-512
+
+#define ARRAY_ARITHMETIC_AVX512_ARRAY(_name, _op, _intrinsic) \
+  __attribute__((target("avx512f"))) \
+  static void _name(float *input0, float *input1, float *output, int startIndex, int endIndex) { \
+    int i = startIndex; \
+    for (; i < endIndex && (((uintptr_t) (output+i)) & 0x3F); i++) output[i] = input0[i] _op input1[i]; \
+    for (; i + 16 <= endIndex; i += 16) { \
+      _mm512_store_ps(output+i, _intrinsic(_mm512_loadu_ps(input0+i), _mm512_loadu_ps(input1+i))); \
+    } \
+    if (i < endIndex) { \
+      const __mmask16 mask = (__mmask16) ((1 << (endIndex - i)) - 1); \
+      _mm512_mask_storeu_ps(output+i, mask, \
+          _intrinsic(_mm512_maskz_loadu_ps(mask, input0+i), _mm512_maskz_loadu_ps(mask, input1+i))); \
+    } \
+  }
+
+#define ARRAY_ARITHMETIC_AVX512_CONSTANT(_name, _op, _intrinsic) \
+  __attribute__((target("avx512f"))) \
+  static void _name(float *input, float constant, float *output, int startIndex, int endIndex) { \
+    int i = startIndex; \
+    for (; i < endIndex && (((uintptr_t) (output+i)) & 0x3F); i++) output[i] = input[i] _op constant; \
+    const __m512 constVec = _mm512_set1_ps(constant); \
+    for (; i + 16 <= endIndex; i += 16) { \
+      _mm512_store_ps(output+i, _intrinsic(_mm512_loadu_ps(input+i), constVec)); \
+    } \
+    if (i < endIndex) { \
+      const __mmask16 mask = (__mmask16) ((1 << (endIndex - i)) - 1); \
+      _mm512_mask_storeu_ps(output+i, mask, _intrinsic(_mm512_maskz_loadu_ps(mask, input+i), constVec)); \
+    } \
+  }
+
+ARRAY_ARITHMETIC_AVX512_ARRAY(addAvx512, +, _mm512_add_ps)
+ARRAY_ARITHMETIC_AVX512_CONSTANT(addConstantAvx512, +, _mm512_add_ps)
+ARRAY_ARITHMETIC_AVX512_ARRAY(subtractAvx512, -, _mm512_sub_ps)
+ARRAY_ARITHMETIC_AVX512_CONSTANT(subtractConstantAvx512, -, _mm512_sub_ps)
+ARRAY_ARITHMETIC_AVX512_ARRAY(multiplyAvx512, *, _mm512_mul_ps)
+ARRAY_ARITHMETIC_AVX512_CONSTANT(multiplyConstantAvx512, *, _mm512_mul_ps)
+ARRAY_ARITHMETIC_AVX512_ARRAY(divideAvx512, /, _mm512_div_ps)
+ARRAY_ARITHMETIC_AVX512_CONSTANT(divideConstantAvx512, /, _mm512_div_ps)
+
+__attribute__((target("avx512f")))
+static void fillAvx512(float *input, float constant, int startIndex, int endIndex) {
+  int i = startIndex;
+  for (; i < endIndex && (((uintptr_t) (input+i)) & 0x3F); i++) input[i] = constant;
+  const __m512 constVec = _mm512_set1_ps(constant);
+  for (; i + 16 <= endIndex; i += 16) _mm512_store_ps(input+i, constVec);
+  if (i < endIndex) _mm512_mask_storeu_ps(input+i, (__mmask16) ((1 << (endIndex - i)) - 1), constVec);
+}
+
+__attribute__((target("avx512f")))
+static void addManyPassAvx512(float **inputs, int numInputs, bool isAccumulating, float *output,
+    int startIndex, int endIndex) {
+  int i = startIndex;
+  for (; i < endIndex && (((uintptr_t) (output+i)) & 0x3F); i++) {
+    float sum = isAccumulating ? output[i] + inputs[0][i] : inputs[0][i];
+    for (int k = 1; k < numInputs; k++) sum += inputs[k][i];
+    output[i] = sum;
+  }
+  for (; i + 16 <= endIndex; i += 16) {
+    __m512 sum = isAccumulating ? _mm512_load_ps(output+i) : _mm512_loadu_ps(inputs[0]+i);
+    for (int k = isAccumulating ? 0 : 1; k < numInputs; k++) {
+      sum = _mm512_add_ps(sum, _mm512_loadu_ps(inputs[k]+i));
+    }
+    _mm512_store_ps(output+i, sum);
+  }
+  for (; i < endIndex; i++) {
+    float sum = isAccumulating ? output[i] + inputs[0][i] : inputs[0][i];
+    for (int k = 1; k < numInputs; k++) sum += inputs[k][i];
+    output[i] = sum;
+  }
+}
+
+static const ArrayArithmeticKernels avx512Kernels = {
+  addAvx512, addConstantAvx512,
+  subtractAvx512, subtractConstantAvx512,
+  multiplyAvx512, multiplyConstantAvx512,
+  divideAvx512, divideConstantAvx512,
+  fillAvx512,
+  addManyPassAvx512
+};
+
+#endif // ARRAY_ARITHMETIC_DISPATCH
+
+#pragma mark - Dispatch
+
+ArrayArithmeticIsa ArrayArithmetic::init() {
+  if (!isInitialised) {
+    isInitialised = true;
+    if (!setIsa(ARRAY_ARITHMETIC_ISA_AVX512)) setIsa(ARRAY_ARITHMETIC_ISA_AVX2);
+  }
+  return selectedIsa;
+}
+
+bool ArrayArithmetic::isIsaSupported(ArrayArithmeticIsa isa) {
+  switch (isa) {
+    case ARRAY_ARITHMETIC_ISA_DEFAULT: return true;
+    #if ARRAY_ARITHMETIC_DISPATCH
+    // __builtin_cpu_supports() also checks that the OS saves the wider registers
+    case ARRAY_ARITHMETIC_ISA_AVX2: __builtin_cpu_init(); return __builtin_cpu_supports("avx2");
+    case ARRAY_ARITHMETIC_ISA_AVX512: __builtin_cpu_init(); return __builtin_cpu_supports("avx512f");
+    #endif
+    default: return false;
+  }
+}
+
+bool ArrayArithmetic::setIsa(ArrayArithmeticIsa isa) {
+  if (!isIsaSupported(isa)) return false;
+  switch (isa) {
+    #if ARRAY_ARITHMETIC_DISPATCH
+    case ARRAY_ARITHMETIC_ISA_AVX2: kernels = &avx2Kernels; break;
+    case ARRAY_ARITHMETIC_ISA_AVX512: kernels = &avx512Kernels; break;
+    #endif
+    default: kernels = NULL; break;
+  }
+  selectedIsa = isa;
+  isInitialised = true;
+  return true;
+}
+
+ArrayArithmeticIsa ArrayArithmetic::getIsa() {
+  return selectedIsa;
+}
@@ -26,31 +26,112 @@
 #if __APPLE__
 // The Accelerate framework is a library of tuned vector operations
 #include <Accelerate/Accelerate.h>
+#include <string.h>
 #endif
 #if __SSE__
 #include <xmmintrin.h>
+#if __SSE2__
+#include <emmintrin.h>
+#endif
 #elif __ARM_NEON__
 // __ARM_NEON__ is defined by the compiler if the arguments "-mfloat-abi=softfp -mfpu=neon" are passed.
 #include <arm_neon.h>
 #endif
 
+/** The largest number of inputs which <code>ArrayArithmetic::addMany()</code> reads in one pass. */
+#define ARRAY_ARITHMETIC_FAN_IN 8
+
+/*
+ * On x86 (other than with Accelerate) the SSE paths may hand a range over to wider AVX2 or AVX-512
+ * kernels, which are compiled into ArrayArithmetic.cpp regardless of the compiler's target flags
+ * and selected at run time with <code>ArrayArithmetic::init()</code>.
+ */
+#if __SSE__ && !__APPLE__ && (__GNUC__ || __clang__)
+#define ARRAY_ARITHMETIC_DISPATCH 1
+#else
+#define ARRAY_ARITHMETIC_DISPATCH 0
+#endif
+
+/** Ranges shorter than this are left to the inline SSE path, as they do not repay the call. */
+#define ARRAY_ARITHMETIC_DISPATCH_MIN 32
+
+#if ARRAY_ARITHMETIC_DISPATCH
+#define ARRAY_ARITHMETIC_TRY_DISPATCH(_kernel, _length, ...) \
+  if (kernels != NULL && (_length) >= ARRAY_ARITHMETIC_DISPATCH_MIN) { \
+    kernels->_kernel(__VA_ARGS__); \
+    return; \
+  }
+#else
+#define ARRAY_ARITHMETIC_TRY_DISPATCH(_kernel, _length, ...)
+#endif
+
+/** The instruction sets which <code>ArrayArithmetic</code> can select between at run time. */
+typedef enum ArrayArithmeticIsa {
+  ARRAY_ARITHMETIC_ISA_DEFAULT, // the path chosen at compile time (SSE, NEON, Accelerate or scalar)
+  ARRAY_ARITHMETIC_ISA_AVX2,    // 8-wide
+  ARRAY_ARITHMETIC_ISA_AVX512   // 16-wide
+} ArrayArithmeticIsa;
+
+/**
+ * One set of run time selectable kernels. Each has the same signature and semantics as the
+ * <code>ArrayArithmetic</code> function of the same name, and produces bit-identical results.
+ */
+typedef struct ArrayArithmeticKernels {
+  void (*add)(float *input0, float *input1, float *output, int startIndex, int endIndex);
+  void (*addConstant)(float *input, float constant, float *output, int startIndex, int endIndex);
+  void (*subtract)(float *input0, float *input1, float *output, int startIndex, int endIndex);
+  void (*subtractConstant)(float *input, float constant, float *output, int startIndex, int endIndex);
+  void (*multiply)(float *input0, float *input1, float *output, int startIndex, int endIndex);
+  void (*multiplyConstant)(float *input, float constant, float *output, int startIndex, int endIndex);
+  void (*divide)(float *input0, float *input1, float *output, int startIndex, int endIndex);
+  void (*divideConstant)(float *input, float constant, float *output, int startIndex, int endIndex);
+  void (*fill)(float *input, float constant, int startIndex, int endIndex);
+  void (*addManyPass)(float **inputs, int numInputs, bool isAccumulating, float *output,
+      int startIndex, int endIndex);
+} ArrayArithmeticKernels;
+
 /**
  * This class offers static inline functions for computing basic arithmetic with float arrays.
  * It offers a central place for optimised implementations of common compute-intensive operations.
  * In all SSE cases, input vectors can be (16-byte) unaligned, but output vectors must be aligned.
  */
 class ArrayArithmetic {
-  
+
   public:
-  
+
+    /**
+     * Selects the widest instruction set which both this build and the CPU support, and returns
+     * it. This is called whenever a context is created, and only the first call does any work.
+     */
+    static ArrayArithmeticIsa init();
+
+    /**
+     * Forces the given instruction set, e.g. to compare the kernels against each other. Returns
+     * <code>false</code> (and leaves the current selection as it is) if it is not supported.
+     */
+    static bool setIsa(ArrayArithmeticIsa isa);
+
+    /** Returns the currently selected instruction set. */
+    static ArrayArithmeticIsa getIsa();
+
+    /** Returns <code>true</code> if the given instruction set can be selected on this machine. */
+    static bool isIsaSupported(ArrayArithmeticIsa isa);
+
     static inline void add(float *input0, float *input1, float *output, int startIndex, int endIndex) {
       #if __APPLE__
       vDSP_vadd(input0+startIndex, 1, input1+startIndex, 1, output+startIndex, 1, endIndex-startIndex);
       #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(add, endIndex - startIndex,
+          input0, input1, output, startIndex, endIndex)
       input0 += startIndex;
       input1 += startIndex;
       output += startIndex;
       int n = endIndex - startIndex;
+      if (n < 4) {
+        // too short to reach a 16-byte boundary
+        for (int i = 0; i < n; i++) output[i] = input0[i] + input1[i];
+        return;
+      }
       
       // align buffer to 16-byte boundary
       switch (startIndex & 0x3) {
@@ -106,16 +187,23 @@ class ArrayArithmetic {
       #if __APPLE__
       vDSP_vsadd(input+startIndex, 1, &constant, output+startIndex, 1, endIndex-startIndex);
       #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(addConstant, endIndex - startIndex,
+          input, constant, output, startIndex, endIndex)
       input += startIndex;
       output += startIndex;
       int n = endIndex - startIndex;
+      if (n < 4) {
+        // too short to reach a 16-byte boundary
+        for (int i = 0; i < n; i++) output[i] = input[i] + constant;
+        return;
+      }
       
       // align buffer to 16-byte boundary
       switch (startIndex & 0x3) {
         case 0: default: break;
-        case 1: *output++ += constant; --n;
-        case 2: *output++ += constant; --n;
-        case 3: *output++ += constant; --n;
+        case 1: *output++ = *input++ + constant; --n;
+        case 2: *output++ = *input++ + constant; --n;
+        case 3: *output++ = *input++ + constant; --n;
       }
       
       int n4 = n & 0xFFFFFFFC;
@@ -126,9 +214,9 @@ class ArrayArithmetic {
       }
       
       switch (n & 0x3) {
-        case 3: *output++ += constant;
-        case 2: *output++ += constant;
-        case 1: *output++ += constant;
+        case 3: *output++ = *input++ + constant;
+        case 2: *output++ = *input++ + constant;
+        case 1: *output++ = *input++ + constant;
         case 0: default: break;
       }
       #elif __ARM_NEON__
@@ -146,9 +234,9 @@ class ArrayArithmetic {
         output += 4;
       }
       switch (n & 0x3) {
-        case 3: *output++ += constant;
-        case 2: *output++ += constant;
-        case 1: *output++ += constant;
+        case 3: *output++ = *input++ + constant;
+        case 2: *output++ = *input++ + constant;
+        case 1: *output++ = *input++ + constant;
         default: break;
       }
       #else
@@ -163,10 +251,17 @@ class ArrayArithmetic {
       #if __APPLE__
       vDSP_vsub(input1+startIndex, 1, input0+startIndex, 1, output+startIndex, 1, endIndex-startIndex);
       #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(subtract, endIndex - startIndex,
+          input0, input1, output, startIndex, endIndex)
       input0 += startIndex;
       input1 += startIndex;
       output += startIndex;
       int n = endIndex - startIndex;
+      if (n < 4) {
+        // too short to reach a 16-byte boundary
+        for (int i = 0; i < n; i++) output[i] = input0[i] - input1[i];
+        return;
+      }
       
       switch (startIndex & 0x3) {
         case 0: default: break;
@@ -222,15 +317,22 @@ class ArrayArithmetic {
       float negation = -1.0f * constant;
       vDSP_vsadd(input+startIndex, 1, &negation, output+startIndex, 1, endIndex-startIndex);
       #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(subtractConstant, endIndex - startIndex,
+          input, constant, output, startIndex, endIndex)
       input += startIndex;
       output += startIndex;
       int n = endIndex - startIndex;
+      if (n < 4) {
+        // too short to reach a 16-byte boundary
+        for (int i = 0; i < n; i++) output[i] = input[i] - constant;
+        return;
+      }
       
       switch (startIndex & 0x3) {
         case 0: default: break;
-        case 1: *output++ -= constant; --n;
-        case 2: *output++ -= constant; --n;
-        case 3: *output++ -= constant; --n;
+        case 1: *output++ = *input++ - constant; --n;
+        case 2: *output++ = *input++ - constant; --n;
+        case 3: *output++ = *input++ - constant; --n;
       }
       
       int n4 = n & 0xFFFFFFFC;
@@ -241,9 +343,9 @@ class ArrayArithmetic {
       }
       
       switch (n & 0x3) {
-        case 3: *output++ -= constant;
-        case 2: *output++ -= constant;
-        case 1: *output++ -= constant;
+        case 3: *output++ = *input++ - constant;
+        case 2: *output++ = *input++ - constant;
+        case 1: *output++ = *input++ - constant;
         case 0: default: break;
       }
       #elif __ARM_NEON__
@@ -261,9 +363,9 @@ class ArrayArithmetic {
         output += 4;
       }
       switch (n & 0x3) {
-        case 3: *output++ -= constant;
-        case 2: *output++ -= constant;
-        case 1: *output++ -= constant;
+        case 3: *output++ = *input++ - constant;
+        case 2: *output++ = *input++ - constant;
+        case 1: *output++ = *input++ - constant;
         default: break;
       }
       #else
@@ -277,10 +379,17 @@ class ArrayArithmetic {
       #if __APPLE__
       vDSP_vmul(input0+startIndex, 1, input1+startIndex, 1, output+startIndex, 1, endIndex-startIndex);
       #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(multiply, endIndex - startIndex,
+          input0, input1, output, startIndex, endIndex)
       input0 += startIndex;
       input1 += startIndex;
       output += startIndex;
       int n = endIndex - startIndex;
+      if (n < 4) {
+        // too short to reach a 16-byte boundary
+        for (int i = 0; i < n; i++) output[i] = input0[i] * input1[i];
+        return;
+      }
       
       switch (startIndex & 0x3) {
         case 0: default: break;
@@ -335,15 +444,22 @@ class ArrayArithmetic {
       #if __APPLE__
       vDSP_vsmul(input+startIndex, 1, &constant, output+startIndex, 1, endIndex-startIndex);
       #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(multiplyConstant, endIndex - startIndex,
+          input, constant, output, startIndex, endIndex)
       input += startIndex;
       output += startIndex;
       int n = endIndex - startIndex;
+      if (n < 4) {
+        // too short to reach a 16-byte boundary
+        for (int i = 0; i < n; i++) output[i] = input[i] * constant;
+        return;
+      }
       
       switch (startIndex & 0x3) {
         case 0: default: break;
-        case 1: *output++ *= constant; --n;
-        case 2: *output++ *= constant; --n;
-        case 3: *output++ *= constant; --n;
+        case 1: *output++ = *input++ * constant; --n;
+        case 2: *output++ = *input++ * constant; --n;
+        case 3: *output++ = *input++ * constant; --n;
       }
       
       int n4 = n & 0xFFFFFFFC;
@@ -354,9 +470,9 @@ class ArrayArithmetic {
       }
       
       switch (n & 0x3) {
-        case 3: *output++ *= constant;
-        case 2: *output++ *= constant;
-        case 1: *output++ *= constant;
+        case 3: *output++ = *input++ * constant;
+        case 2: *output++ = *input++ * constant;
+        case 1: *output++ = *input++ * constant;
         case 0: default: break;
       }
       #elif __ARM_NEON__
@@ -374,9 +490,9 @@ class ArrayArithmetic {
         output += 4;
       }
       switch (n & 0x3) {
-        case 3: *output++ *= constant;
-        case 2: *output++ *= constant;
-        case 1: *output++ *= constant;
+        case 3: *output++ = *input++ * constant;
+        case 2: *output++ = *input++ * constant;
+        case 1: *output++ = *input++ * constant;
         default: break;
       }
       #else
@@ -391,10 +507,17 @@ class ArrayArithmetic {
       #if __APPLE__
       vDSP_vdiv(input1+startIndex, 1, input0+startIndex, 1, output+startIndex, 1, endIndex-startIndex);
       #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(divide, endIndex - startIndex,
+          input0, input1, output, startIndex, endIndex)
       input0 += startIndex;
       input1 += startIndex;
       output += startIndex;
       int n = endIndex - startIndex;
+      if (n < 4) {
+        // too short to reach a 16-byte boundary
+        for (int i = 0; i < n; i++) output[i] = input0[i] / input1[i];
+        return;
+      }
       
       switch (startIndex & 0x3) {
         case 0: default: break;
@@ -426,15 +549,22 @@ class ArrayArithmetic {
       #if __APPLE__
       vDSP_vsdiv(input+startIndex, 1, &constant, output+startIndex, 1, endIndex-startIndex);
       #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(divideConstant, endIndex - startIndex,
+          input, constant, output, startIndex, endIndex)
       input += startIndex;
       output += startIndex;
       int n = endIndex - startIndex;
+      if (n < 4) {
+        // too short to reach a 16-byte boundary
+        for (int i = 0; i < n; i++) output[i] = input[i] / constant;
+        return;
+      }
       
       switch (startIndex & 0x3) {
         case 0: default: break;
-        case 1: *output++ /= constant; --n;
-        case 2: *output++ /= constant; --n;
-        case 3: *output++ /= constant; --n;
+        case 1: *output++ = *input++ / constant; --n;
+        case 2: *output++ = *input++ / constant; --n;
+        case 3: *output++ = *input++ / constant; --n;
       }
       
       int n4 = n & 0xFFFFFFFC;
@@ -445,9 +575,9 @@ class ArrayArithmetic {
       }
       
       switch (n & 0x3) {
-        case 3: *output++ /= constant;
-        case 2: *output++ /= constant;
-        case 1: *output++ /= constant;
+        case 3: *output++ = *input++ / constant;
+        case 2: *output++ = *input++ / constant;
+        case 1: *output++ = *input++ / constant;
         case 0: default: break;
       }
       #else
@@ -461,8 +591,14 @@ class ArrayArithmetic {
       #if __APPLE__
       vDSP_vfill(&constant, input+startIndex, 1, endIndex-startIndex);
       #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(fill, endIndex - startIndex, input, constant, startIndex, endIndex)
       input += startIndex;
       int n = endIndex - startIndex;
+      if (n < 4) {
+        // too short to reach a 16-byte boundary
+        for (int i = 0; i < n; i++) input[i] = constant;
+        return;
+      }
       
       switch (startIndex & 0x3) {
         case 0: default: break;
@@ -507,7 +643,576 @@ class ArrayArithmetic {
       #endif
     }
     
+    /**
+     * Sums any number (at least one) of arrays into <code>output</code>, reading up to
+     * <code>ARRAY_ARITHMETIC_FAN_IN</code> inputs in each pass over the output instead of one. The
+     * output may be the same array as one of the inputs, as the pass which reads that input is
+     * always the first. There is no single pass equivalent in vDSP, so this is implemented
+     * directly on all platforms.
+     */
+    static inline void addMany(float **inputs, int numInputs, float *output, int startIndex, int endIndex) {
+      int first = 0;
+      for (int k = 1; k < numInputs; k++) {
+        if (inputs[k] == output) {
+          first = k;
+          break;
+        }
+      }
+      
+      float *group[ARRAY_ARITHMETIC_FAN_IN];
+      int numGrouped = 1;
+      bool isAccumulating = false;
+      group[0] = inputs[first];
+      for (int k = 0; k < numInputs; k++) {
+        if (k == first) continue;
+        group[numGrouped++] = inputs[k];
+        if (numGrouped == ARRAY_ARITHMETIC_FAN_IN) {
+          addManyPass(group, numGrouped, isAccumulating, output, startIndex, endIndex);
+          numGrouped = 0;
+          isAccumulating = true;
+        }
+      }
+      if (numGrouped > 0) addManyPass(group, numGrouped, isAccumulating, output, startIndex, endIndex);
+    }
+  
+    #pragma mark - Signal Primitives
+
+    /*
+     * The following primitives are the portable counterparts of the vDSP functions named in their
+     * descriptions. Like the kernels above they accept an unaligned input, but write to the output
+     * in aligned groups of four from the first index which is a multiple of four.
+     */
+
+    /** Clips the input into [lower, upper], as <code>vDSP_vclip</code>. NaN is passed through. */
+    static inline void clip(float *input, float lower, float upper, float *output,
+        int startIndex, int endIndex) {
+      #if __APPLE__
+      vDSP_vclip(input+startIndex, 1, &lower, &upper, output+startIndex, 1, endIndex-startIndex);
+      #else
+      int i = startIndex;
+      #if __SSE__ || __ARM_NEON__
+      for (; i < endIndex && (i & 0x3); i++) output[i] = clipSample(input[i], lower, upper);
+      #if __SSE__
+      const __m128 lowerVec = _mm_set1_ps(lower);
+      const __m128 upperVec = _mm_set1_ps(upper);
+      for (; i + 4 <= endIndex; i += 4) {
+        __m128 x = _mm_loadu_ps(input+i);
+        const __m128 isAbove = _mm_cmpgt_ps(x, upperVec);
+        const __m128 isBelow = _mm_cmplt_ps(x, lowerVec);
+        x = _mm_or_ps(_mm_and_ps(isAbove, upperVec), _mm_andnot_ps(isAbove, x));
+        _mm_store_ps(output+i, _mm_or_ps(_mm_and_ps(isBelow, lowerVec), _mm_andnot_ps(isBelow, x)));
+      }
+      #else
+      const float32x4_t lowerVec = vdupq_n_f32(lower);
+      const float32x4_t upperVec = vdupq_n_f32(upper);
+      for (; i + 4 <= endIndex; i += 4) {
+        const float32x4_t x = vld1q_f32((const float32_t *) (input+i));
+        const float32x4_t y = vbslq_f32(vcgtq_f32(x, upperVec), upperVec, x);
+        vst1q_f32((float32_t *) (output+i), vbslq_f32(vcltq_f32(x, lowerVec), lowerVec, y));
+      }
+      #endif
+      #endif
+      for (; i < endIndex; i++) output[i] = clipSample(input[i], lower, upper);
+      #endif
+    }
+
+    /**
+     * Writes <code>start + (i-startIndex)*step</code> to each output sample, as
+     * <code>vDSP_vramp</code>. Every sample is computed from its offset rather than by accumulating
+     * the step, so long ramps do not drift.
+     */
+    static inline void ramp(float start, float step, float *output, int startIndex, int endIndex) {
+      #if __APPLE__
+      vDSP_vramp(&start, &step, output+startIndex, 1, endIndex-startIndex);
+      #else
+      int i = startIndex;
+      #if __SSE__ || __ARM_NEON__
+      for (; i < endIndex && (i & 0x3); i++) output[i] = start + ((float) (i-startIndex)) * step;
+      const float k = (float) (i-startIndex);
+      #if __SSE__
+      const __m128 startVec = _mm_set1_ps(start);
+      const __m128 stepVec = _mm_set1_ps(step);
+      const __m128 fourVec = _mm_set1_ps(4.0f);
+      __m128 kVec = _mm_setr_ps(k, k+1.0f, k+2.0f, k+3.0f);
+      for (; i + 4 <= endIndex; i += 4) {
+        _mm_store_ps(output+i, _mm_add_ps(startVec, _mm_mul_ps(kVec, stepVec)));
+        kVec = _mm_add_ps(kVec, fourVec);
+      }
+      #else
+      const float32x4_t startVec = vdupq_n_f32(start);
+      const float32x4_t fourVec = vdupq_n_f32(4.0f);
+      const float kArray[4] = {k, k+1.0f, k+2.0f, k+3.0f};
+      float32x4_t kVec = vld1q_f32((const float32_t *) kArray);
+      for (; i + 4 <= endIndex; i += 4) {
+        vst1q_f32((float32_t *) (output+i), vaddq_f32(startVec, vmulq_n_f32(kVec, step)));
+        kVec = vaddq_f32(kVec, fourVec);
+      }
+      #endif
+      #endif
+      for (; i < endIndex; i++) output[i] = start + ((float) (i-startIndex)) * step;
+      #endif
+    }
+
+    /**
+     * Reads <code>table</code> at the fractional <code>indices</code> with linear interpolation, like
+     * <code>vDSP_vlint</code>, except that the indices are first clipped into
+     * [0, <code>tableLength</code>-1], so that any index can be read safely. The output may be the
+     * same array as the indices.
+     */
+    static inline void interpolate(float *table, int tableLength, float *indices, float *output,
+        int startIndex, int endIndex) {
+      const float maxIndex = (float) (tableLength-1);
+      int i = startIndex;
+      #if __SSE2__ || __ARM_NEON__
+      for (; i < endIndex && (i & 0x3); i++) output[i] = interpolateSample(table, maxIndex, indices[i]);
+      int j0[4], j1[4];
+      #if __SSE2__
+      const __m128 zeroVec = _mm_setzero_ps();
+      const __m128 maxVec = _mm_set1_ps(maxIndex);
+      const __m128 oneVec = _mm_set1_ps(1.0f);
+      for (; i + 4 <= endIndex; i += 4) {
+        const __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(indices+i), zeroVec), maxVec);
+        const __m128i x0 = _mm_cvttps_epi32(x);
+        const __m128 x0f = _mm_cvtepi32_ps(x0);
+        _mm_storeu_si128((__m128i *) j0, x0);
+        _mm_storeu_si128((__m128i *) j1, _mm_cvttps_epi32(_mm_min_ps(_mm_add_ps(x0f, oneVec), maxVec)));
+        const __m128 y0 = _mm_setr_ps(table[j0[0]], table[j0[1]], table[j0[2]], table[j0[3]]);
+        const __m128 y1 = _mm_setr_ps(table[j1[0]], table[j1[1]], table[j1[2]], table[j1[3]]);
+        _mm_store_ps(output+i, _mm_add_ps(y0, _mm_mul_ps(_mm_sub_ps(x, x0f), _mm_sub_ps(y1, y0))));
+      }
+      #else
+      const float32x4_t zeroVec = vdupq_n_f32(0.0f);
+      const float32x4_t maxVec = vdupq_n_f32(maxIndex);
+      const float32x4_t oneVec = vdupq_n_f32(1.0f);
+      for (; i + 4 <= endIndex; i += 4) {
+        const float32x4_t x = vminq_f32(vmaxq_f32(vld1q_f32((const float32_t *) (indices+i)), zeroVec), maxVec);
+        const int32x4_t x0 = vcvtq_s32_f32(x);
+        const float32x4_t x0f = vcvtq_f32_s32(x0);
+        vst1q_s32(j0, x0);
+        vst1q_s32(j1, vcvtq_s32_f32(vminq_f32(vaddq_f32(x0f, oneVec), maxVec)));
+        const float y0Array[4] = {table[j0[0]], table[j0[1]], table[j0[2]], table[j0[3]]};
+        const float y1Array[4] = {table[j1[0]], table[j1[1]], table[j1[2]], table[j1[3]]};
+        const float32x4_t y0 = vld1q_f32((const float32_t *) y0Array);
+        const float32x4_t y1 = vld1q_f32((const float32_t *) y1Array);
+        vst1q_f32((float32_t *) (output+i), vaddq_f32(y0, vmulq_f32(vsubq_f32(x, x0f), vsubq_f32(y1, y0))));
+      }
+      #endif
+      #endif
+      for (; i < endIndex; i++) output[i] = interpolateSample(table, maxIndex, indices[i]);
+    }
+
+    /** Returns the sum of <code>input0[i] * input1[i]</code>, as <code>vDSP_dotpr</code>. */
+    static inline float dot(float *input0, float *input1, int startIndex, int endIndex) {
+      #if __APPLE__
+      float result = 0.0f;
+      vDSP_dotpr(input0+startIndex, 1, input1+startIndex, 1, &result, endIndex-startIndex);
+      return result;
+      #else
+      float sum = 0.0f;
+      int i = startIndex;
+      #if __SSE__
+      __m128 sumVec = _mm_setzero_ps();
+      for (; i + 4 <= endIndex; i += 4) {
+        sumVec = _mm_add_ps(sumVec, _mm_mul_ps(_mm_loadu_ps(input0+i), _mm_loadu_ps(input1+i)));
+      }
+      sum = horizontalSum(sumVec);
+      #elif __ARM_NEON__
+      float32x4_t sumVec = vdupq_n_f32(0.0f);
+      for (; i + 4 <= endIndex; i += 4) {
+        sumVec = vmlaq_f32(sumVec, vld1q_f32((const float32_t *) (input0+i)),
+            vld1q_f32((const float32_t *) (input1+i)));
+      }
+      sum = horizontalSum(sumVec);
+      #endif
+      for (; i < endIndex; i++) sum += input0[i] * input1[i];
+      return sum;
+      #endif
+    }
+
+    /** Returns the sum of <code>input[i]^2</code>, as <code>vDSP_svesq</code>. */
+    static inline float sumOfSquares(float *input, int startIndex, int endIndex) {
+      #if __APPLE__
+      float result = 0.0f;
+      vDSP_svesq(input+startIndex, 1, &result, endIndex-startIndex);
+      return result;
+      #else
+      return dot(input, input, startIndex, endIndex);
+      #endif
+    }
+
+    /**
+     * Returns the sum of <code>input[i]^2 * weights[i]</code> in one pass, which vDSP can only do
+     * in three (<code>vDSP_vsq</code>, <code>vDSP_vmul</code> and <code>vDSP_sve</code>) through a
+     * temporary buffer.
+     */
+    static inline float sumOfSquares(float *input, float *weights, int startIndex, int endIndex) {
+      float sum = 0.0f;
+      int i = startIndex;
+      #if __SSE__
+      __m128 sumVec = _mm_setzero_ps();
+      for (; i + 4 <= endIndex; i += 4) {
+        const __m128 x = _mm_loadu_ps(input+i);
+        sumVec = _mm_add_ps(sumVec, _mm_mul_ps(_mm_mul_ps(x, x), _mm_loadu_ps(weights+i)));
+      }
+      sum = horizontalSum(sumVec);
+      #elif __ARM_NEON__
+      float32x4_t sumVec = vdupq_n_f32(0.0f);
+      for (; i + 4 <= endIndex; i += 4) {
+        const float32x4_t x = vld1q_f32((const float32_t *) (input+i));
+        sumVec = vmlaq_f32(sumVec, vmulq_f32(x, x), vld1q_f32((const float32_t *) (weights+i)));
+      }
+      sum = horizontalSum(sumVec);
+      #endif
+      for (; i < endIndex; i++) sum += input[i] * input[i] * weights[i];
+      return sum;
+    }
+
+    /**
+     * Runs a biquad over the range, as <code>vDSP_deq22</code>:
+     * y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] - b3*y[n-1] - b4*y[n-2], where <code>coefficients</code>
+     * holds b0 to b4. <code>history</code> holds {x[n-1], x[n-2], y[n-1], y[n-2]} from the previous
+     * call and is updated for the next one. The output may be the same array as the input.
+     */
+    static inline void biquad(float *input, float *output, const float *coefficients, float *history,
+        int startIndex, int endIndex) {
+      #if __APPLE__
+      // vDSP_deq22 expects the two previous samples in front of the input and output
+      int n = endIndex - startIndex;
+      float bufferIn[n+2];
+      bufferIn[0] = history[1]; bufferIn[1] = history[0];
+      memcpy(bufferIn+2, input+startIndex, n*sizeof(float));
+      float bufferOut[n+2];
+      bufferOut[0] = history[3]; bufferOut[1] = history[2];
+      vDSP_deq22(bufferIn, 1, (float *) coefficients, bufferOut, 1, n);
+      memcpy(output+startIndex, bufferOut+2, n*sizeof(float));
+      history[1] = bufferIn[n]; history[0] = bufferIn[n+1];
+      history[3] = bufferOut[n]; history[2] = bufferOut[n+1];
+      #else
+      const float b0 = coefficients[0], b1 = coefficients[1], b2 = coefficients[2];
+      const float b3 = coefficients[3], b4 = coefficients[4];
+      float x1 = history[0], x2 = history[1], y1 = history[2], y2 = history[3];
+      for (int i = startIndex; i < endIndex; i++) {
+        const float x0 = input[i];
+        const float y0 = b0*x0 + b1*x1 + b2*x2 - b3*y1 - b4*y2;
+        output[i] = y0;
+        x2 = x1; x1 = x0;
+        y2 = y1; y1 = y0;
+      }
+      history[0] = x1; history[1] = x2; history[2] = y1; history[3] = y2;
+      #endif
+    }
+
+    #pragma mark - Block Kernels
+  
+    /*
+     * The following kernels process exactly one whole block of <code>N</code> samples, where
+     * <code>N</code> is a power of two of at least 16. Because the length is known at compile time
+     * and all buffers must be 16-byte aligned, they have neither an alignment prologue nor a tail,
+     * and the compiler is free to unroll them completely. They are selected by objects with
+     * <code>DSP_SELECT_BLOCK_FUNCTION</code> when a block is not split by messages.
+     */
+  
+    template <int N>
+    static inline void addBlock(float *input0, float *input1, float *output) {
+      #if __APPLE__
+      vDSP_vadd(input0, 1, input1, 1, output, 1, N);
+      #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(add, N, input0, input1, output, 0, N)
+      for (int i = 0; i < N; i += 16) {
+        _mm_store_ps(output+i, _mm_add_ps(_mm_load_ps(input0+i), _mm_load_ps(input1+i)));
+        _mm_store_ps(output+i+4, _mm_add_ps(_mm_load_ps(input0+i+4), _mm_load_ps(input1+i+4)));
+        _mm_store_ps(output+i+8, _mm_add_ps(_mm_load_ps(input0+i+8), _mm_load_ps(input1+i+8)));
+        _mm_store_ps(output+i+12, _mm_add_ps(_mm_load_ps(input0+i+12), _mm_load_ps(input1+i+12)));
+      }
+      #elif __ARM_NEON__
+      for (int i = 0; i < N; i += 8) {
+        vst1q_f32((float32_t *) (output+i),
+            vaddq_f32(vld1q_f32((const float32_t *) (input0+i)), vld1q_f32((const float32_t *) (input1+i))));
+        vst1q_f32((float32_t *) (output+i+4),
+            vaddq_f32(vld1q_f32((const float32_t *) (input0+i+4)), vld1q_f32((const float32_t *) (input1+i+4))));
+      }
+      #else
+      for (int i = 0; i < N; i++) {
+        output[i] = input0[i] + input1[i];
+      }
+      #endif
+    }
+  
+    template <int N>
+    static inline void addBlock(float *input, float constant, float *output) {
+      #if __APPLE__
+      vDSP_vsadd(input, 1, &constant, output, 1, N);
+      #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(addConstant, N, input, constant, output, 0, N)
+      const __m128 constVec = _mm_set1_ps(constant);
+      for (int i = 0; i < N; i += 16) {
+        _mm_store_ps(output+i, _mm_add_ps(_mm_load_ps(input+i), constVec));
+        _mm_store_ps(output+i+4, _mm_add_ps(_mm_load_ps(input+i+4), constVec));
+        _mm_store_ps(output+i+8, _mm_add_ps(_mm_load_ps(input+i+8), constVec));
+        _mm_store_ps(output+i+12, _mm_add_ps(_mm_load_ps(input+i+12), constVec));
+      }
+      #elif __ARM_NEON__
+      const float32x4_t constVec = vdupq_n_f32(constant);
+      for (int i = 0; i < N; i += 8) {
+        vst1q_f32((float32_t *) (output+i), vaddq_f32(vld1q_f32((const float32_t *) (input+i)), constVec));
+        vst1q_f32((float32_t *) (output+i+4), vaddq_f32(vld1q_f32((const float32_t *) (input+i+4)), constVec));
+      }
+      #else
+      for (int i = 0; i < N; i++) {
+        output[i] = input[i] + constant;
+      }
+      #endif
+    }
+  
+    // output = input0 - input1
+    template <int N>
+    static inline void subtractBlock(float *input0, float *input1, float *output) {
+      #if __APPLE__
+      vDSP_vsub(input1, 1, input0, 1, output, 1, N);
+      #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(subtract, N, input0, input1, output, 0, N)
+      for (int i = 0; i < N; i += 16) {
+        _mm_store_ps(output+i, _mm_sub_ps(_mm_load_ps(input0+i), _mm_load_ps(input1+i)));
+        _mm_store_ps(output+i+4, _mm_sub_ps(_mm_load_ps(input0+i+4), _mm_load_ps(input1+i+4)));
+        _mm_store_ps(output+i+8, _mm_sub_ps(_mm_load_ps(input0+i+8), _mm_load_ps(input1+i+8)));
+        _mm_store_ps(output+i+12, _mm_sub_ps(_mm_load_ps(input0+i+12), _mm_load_ps(input1+i+12)));
+      }
+      #elif __ARM_NEON__
+      for (int i = 0; i < N; i += 8) {
+        vst1q_f32((float32_t *) (output+i),
+            vsubq_f32(vld1q_f32((const float32_t *) (input0+i)), vld1q_f32((const float32_t *) (input1+i))));
+        vst1q_f32((float32_t *) (output+i+4),
+            vsubq_f32(vld1q_f32((const float32_t *) (input0+i+4)), vld1q_f32((const float32_t *) (input1+i+4))));
+      }
+      #else
+      for (int i = 0; i < N; i++) {
+        output[i] = input0[i] - input1[i];
+      }
+      #endif
+    }
+  
+    template <int N>
+    static inline void subtractBlock(float *input, float constant, float *output) {
+      #if __APPLE__
+      float negation = -1.0f * constant;
+      vDSP_vsadd(input, 1, &negation, output, 1, N);
+      #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(subtractConstant, N, input, constant, output, 0, N)
+      const __m128 constVec = _mm_set1_ps(constant);
+      for (int i = 0; i < N; i += 16) {
+        _mm_store_ps(output+i, _mm_sub_ps(_mm_load_ps(input+i), constVec));
+        _mm_store_ps(output+i+4, _mm_sub_ps(_mm_load_ps(input+i+4), constVec));
+        _mm_store_ps(output+i+8, _mm_sub_ps(_mm_load_ps(input+i+8), constVec));
+        _mm_store_ps(output+i+12, _mm_sub_ps(_mm_load_ps(input+i+12), constVec));
+      }
+      #elif __ARM_NEON__
+      const float32x4_t constVec = vdupq_n_f32(constant);
+      for (int i = 0; i < N; i += 8) {
+        vst1q_f32((float32_t *) (output+i), vsubq_f32(vld1q_f32((const float32_t *) (input+i)), constVec));
+        vst1q_f32((float32_t *) (output+i+4), vsubq_f32(vld1q_f32((const float32_t *) (input+i+4)), constVec));
+      }
+      #else
+      for (int i = 0; i < N; i++) {
+        output[i] = input[i] - constant;
+      }
+      #endif
+    }
+  
+    template <int N>
+    static inline void multiplyBlock(float *input0, float *input1, float *output) {
+      #if __APPLE__
+      vDSP_vmul(input0, 1, input1, 1, output, 1, N);
+      #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(multiply, N, input0, input1, output, 0, N)
+      for (int i = 0; i < N; i += 16) {
+        _mm_store_ps(output+i, _mm_mul_ps(_mm_load_ps(input0+i), _mm_load_ps(input1+i)));
+        _mm_store_ps(output+i+4, _mm_mul_ps(_mm_load_ps(input0+i+4), _mm_load_ps(input1+i+4)));
+        _mm_store_ps(output+i+8, _mm_mul_ps(_mm_load_ps(input0+i+8), _mm_load_ps(input1+i+8)));
+        _mm_store_ps(output+i+12, _mm_mul_ps(_mm_load_ps(input0+i+12), _mm_load_ps(input1+i+12)));
+      }
+      #elif __ARM_NEON__
+      for (int i = 0; i < N; i += 8) {
+        vst1q_f32((float32_t *) (output+i),
+            vmulq_f32(vld1q_f32((const float32_t *) (input0+i)), vld1q_f32((const float32_t *) (input1+i))));
+        vst1q_f32((float32_t *) (output+i+4),
+            vmulq_f32(vld1q_f32((const float32_t *) (input0+i+4)), vld1q_f32((const float32_t *) (input1+i+4))));
+      }
+      #else
+      for (int i = 0; i < N; i++) {
+        output[i] = input0[i] * input1[i];
+      }
+      #endif
+    }
+  
+    template <int N>
+    static inline void multiplyBlock(float *input, float constant, float *output) {
+      #if __APPLE__
+      vDSP_vsmul(input, 1, &constant, output, 1, N);
+      #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(multiplyConstant, N, input, constant, output, 0, N)
+      const __m128 constVec = _mm_set1_ps(constant);
+      for (int i = 0; i < N; i += 16) {
+        _mm_store_ps(output+i, _mm_mul_ps(_mm_load_ps(input+i), constVec));
+        _mm_store_ps(output+i+4, _mm_mul_ps(_mm_load_ps(input+i+4), constVec));
+        _mm_store_ps(output+i+8, _mm_mul_ps(_mm_load_ps(input+i+8), constVec));
+        _mm_store_ps(output+i+12, _mm_mul_ps(_mm_load_ps(input+i+12), constVec));
+      }
+      #elif __ARM_NEON__
+      const float32x4_t constVec = vdupq_n_f32(constant);
+      for (int i = 0; i < N; i += 8) {
+        vst1q_f32((float32_t *) (output+i), vmulq_f32(vld1q_f32((const float32_t *) (input+i)), constVec));
+        vst1q_f32((float32_t *) (output+i+4), vmulq_f32(vld1q_f32((const float32_t *) (input+i+4)), constVec));
+      }
+      #else
+      for (int i = 0; i < N; i++) {
+        output[i] = input[i] * constant;
+      }
+      #endif
+    }
+  
+    // output = input0 / input1
+    template <int N>
+    static inline void divideBlock(float *input0, float *input1, float *output) {
+      #if __APPLE__
+      vDSP_vdiv(input1, 1, input0, 1, output, 1, N);
+      #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(divide, N, input0, input1, output, 0, N)
+      for (int i = 0; i < N; i += 16) {
+        _mm_store_ps(output+i, _mm_div_ps(_mm_load_ps(input0+i), _mm_load_ps(input1+i)));
+        _mm_store_ps(output+i+4, _mm_div_ps(_mm_load_ps(input0+i+4), _mm_load_ps(input1+i+4)));
+        _mm_store_ps(output+i+8, _mm_div_ps(_mm_load_ps(input0+i+8), _mm_load_ps(input1+i+8)));
+        _mm_store_ps(output+i+12, _mm_div_ps(_mm_load_ps(input0+i+12), _mm_load_ps(input1+i+12)));
+      }
+      #else
+      for (int i = 0; i < N; i++) {
+        output[i] = input0[i] / input1[i];
+      }
+      #endif
+    }
+  
+    template <int N>
+    static inline void divideBlock(float *input, float constant, float *output) {
+      #if __APPLE__
+      vDSP_vsdiv(input, 1, &constant, output, 1, N);
+      #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(divideConstant, N, input, constant, output, 0, N)
+      const __m128 constVec = _mm_set1_ps(constant);
+      for (int i = 0; i < N; i += 16) {
+        _mm_store_ps(output+i, _mm_div_ps(_mm_load_ps(input+i), constVec));
+        _mm_store_ps(output+i+4, _mm_div_ps(_mm_load_ps(input+i+4), constVec));
+        _mm_store_ps(output+i+8, _mm_div_ps(_mm_load_ps(input+i+8), constVec));
+        _mm_store_ps(output+i+12, _mm_div_ps(_mm_load_ps(input+i+12), constVec));
+      }
+      #else
+      for (int i = 0; i < N; i++) {
+        output[i] = input[i] / constant;
+      }
+      #endif
+    }
+  
+    template <int N>
+    static inline void fillBlock(float *input, float constant) {
+      #if __APPLE__
+      vDSP_vfill(&constant, input, 1, N);
+      #elif __SSE__
+      ARRAY_ARITHMETIC_TRY_DISPATCH(fill, N, input, constant, 0, N)
+      const __m128 constVec = _mm_set1_ps(constant);
+      for (int i = 0; i < N; i += 16) {
+        _mm_store_ps(input+i, constVec);
+        _mm_store_ps(input+i+4, constVec);
+        _mm_store_ps(input+i+8, constVec);
+        _mm_store_ps(input+i+12, constVec);
+      }
+      #elif __ARM_NEON__
+      const float32x4_t constVec = vdupq_n_f32(constant);
+      for (int i = 0; i < N; i += 8) {
+        vst1q_f32((float32_t *) (input+i), constVec);
+        vst1q_f32((float32_t *) (input+i+4), constVec);
+      }
+      #else
+      for (int i = 0; i < N; i++) {
+        input[i] = constant;
+      }
+      #endif
+    }
+    
   private:
+    /** The scalar form of <code>clip()</code>. */
+    static inline float clipSample(float x, float lower, float upper) {
+      if (x < lower) return lower;
+      else if (x > upper) return upper;
+      else return x;
+    }
+
+    /** The scalar form of <code>interpolate()</code>, with the same clipping and rounding. */
+    static inline float interpolateSample(float *table, float maxIndex, float index) {
+      float x = (index > 0.0f) ? index : 0.0f; // NaN reads the first sample
+      if (!(x < maxIndex)) x = maxIndex;
+      const int x0 = (int) x;
+      const float x0f = (float) x0;
+      float x1f = x0f + 1.0f;
+      if (!(x1f < maxIndex)) x1f = maxIndex;
+      const float y0 = table[x0];
+      return y0 + (x - x0f) * (table[(int) x1f] - y0);
+    }
+
+    #if __SSE__
+    static inline float horizontalSum(__m128 v) {
+      float partial[4];
+      _mm_storeu_ps(partial, v);
+      return (partial[0] + partial[1]) + (partial[2] + partial[3]);
+    }
+    #elif __ARM_NEON__
+    static inline float horizontalSum(float32x4_t v) {
+      const float32x2_t half = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+      return vget_lane_f32(vpadd_f32(half, half), 0);
+    }
+    #endif
+
+    /** The kernels selected at run time, or <code>NULL</code> if the inline paths are used. */
+    static const ArrayArithmeticKernels *kernels;
+
+    /**
+     * One pass of <code>addMany()</code>. Each output sample is written only after the same sample
+     * of all inputs has been read. If <code>isAccumulating</code>, the output is added to as well.
+     */
+    static inline void addManyPass(float **inputs, int numInputs, bool isAccumulating, float *output,
+        int startIndex, int endIndex) {
+      ARRAY_ARITHMETIC_TRY_DISPATCH(addManyPass, endIndex - startIndex,
+          inputs, numInputs, isAccumulating, output, startIndex, endIndex)
+      int i = startIndex;
+      #if __SSE__ || __ARM_NEON__
+      // the scalar loop aligns the output to a 16-byte boundary
+      for (; i < endIndex && (i & 0x3); i++) {
+        float sum = isAccumulating ? output[i] + inputs[0][i] : inputs[0][i];
+        for (int k = 1; k < numInputs; k++) sum += inputs[k][i];
+        output[i] = sum;
+      }
+      #if __SSE__
+      for (; i + 4 <= endIndex; i += 4) {
+        __m128 sum = isAccumulating ? _mm_load_ps(output+i) : _mm_loadu_ps(inputs[0]+i);
+        for (int k = isAccumulating ? 0 : 1; k < numInputs; k++) {
+          sum = _mm_add_ps(sum, _mm_loadu_ps(inputs[k]+i));
+        }
+        _mm_store_ps(output+i, sum);
+      }
+      #else
+      for (; i + 4 <= endIndex; i += 4) {
+        float32x4_t sum = vld1q_f32((const float32_t *) (isAccumulating ? output+i : inputs[0]+i));
+        for (int k = isAccumulating ? 0 : 1; k < numInputs; k++) {
+          sum = vaddq_f32(sum, vld1q_f32((const float32_t *) (inputs[k]+i)));
+        }
+        vst1q_f32((float32_t *) (output+i), sum);
+      }
+      #endif
+      #endif
+      for (; i < endIndex; i++) {
+        float sum = isAccumulating ? output[i] + inputs[0][i] : inputs[0][i];
+        for (int k = 1; k < numInputs; k++) sum += inputs[k][i];
+        output[i] = sum;
+      }
+    }
+  
     ArrayArithmetic(); // no instances of this object are allowed
     ~ArrayArithmetic();
 };
@@ -0,0 +1,286 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "BiquadEngine.h"
+#if __AVX__
+#include <immintrin.h>
+#elif __SSE__
+#include <xmmintrin.h>
+#elif __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+// The engine is only bit-identical to the scalar recursion if every product is rounded before it is
+// summed. Compilers may otherwise fuse them (e.g. with -mfma or -march=native), even in intrinsics.
+#if __clang__
+#pragma clang fp contract(off)
+#elif __GNUC__
+#pragma GCC optimize ("fp-contract=off")
+#else
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+void BiquadEngine::processScalar(const float *coefficients, float *history, float *input, float *output,
+    int startIndex, int endIndex) {
+  const float b0 = coefficients[0], b1 = coefficients[1], b2 = coefficients[2];
+  const float b3 = coefficients[3], b4 = coefficients[4];
+  float x1 = history[0], x2 = history[1], y1 = history[2], y2 = history[3];
+  for (int i = startIndex; i < endIndex; i++) {
+    const float x0 = input[i];
+    const float y0 = b0*x0 + b1*x1 + b2*x2 - b3*y1 - b4*y2;
+    output[i] = y0;
+    x2 = x1; x1 = x0;
+    y2 = y1; y1 = y0;
+  }
+  history[0] = x1; history[1] = x2; history[2] = y1; history[3] = y2;
+}
+
+void BiquadEngine::process(BiquadFilter *filter, int startIndex, int endIndex) {
+  int i = startIndex;
+  #if __SSE__ || __ARM_NEON__
+  if (endIndex - i >= 4) {
+    // The feedforward terms do not depend on the previous outputs and are summed four samples at a
+    // time, in the same order as in processScalar(). Only the two feedback terms are left to the
+    // recursion.
+    const float *coefficients = filter->coefficients;
+    float *input = filter->input;
+    float *output = filter->output;
+    float *history = filter->history;
+    const float b3 = coefficients[3];
+    const float b4 = coefficients[4];
+    float y1 = history[2];
+    float y2 = history[3];
+    float feedforward[4] __attribute__((aligned(16)));
+    #if __SSE__
+    const __m128 b0 = _mm_set1_ps(coefficients[0]);
+    const __m128 b1 = _mm_set1_ps(coefficients[1]);
+    const __m128 b2 = _mm_set1_ps(coefficients[2]);
+    __m128 previous = _mm_set_ps(0.0f, 0.0f, history[1], history[0]); // x[n-1], x[n-2], -, -
+    for (; i + 4 <= endIndex; i += 4) {
+      const __m128 x0 = _mm_loadu_ps(input+i);
+      // {x[n-1], .., x[n+2]} and {x[n-2], .., x[n+1]}
+      const __m128 x1 = _mm_shuffle_ps(_mm_shuffle_ps(previous, x0, _MM_SHUFFLE(0,0,0,0)), x0,
+          _MM_SHUFFLE(2,1,2,0));
+      const __m128 x2 = _mm_shuffle_ps(previous, x0, _MM_SHUFFLE(1,0,0,1));
+      _mm_store_ps(feedforward, _mm_add_ps(_mm_add_ps(_mm_mul_ps(b0, x0), _mm_mul_ps(b1, x1)),
+          _mm_mul_ps(b2, x2)));
+      previous = _mm_shuffle_ps(x0, x0, _MM_SHUFFLE(0,0,2,3));
+      for (int k = 0; k < 4; k++) {
+        const float y0 = feedforward[k] - b3*y1 - b4*y2;
+        output[i+k] = y0;
+        y2 = y1; y1 = y0;
+      }
+    }
+    history[0] = _mm_cvtss_f32(previous);
+    history[1] = _mm_cvtss_f32(_mm_shuffle_ps(previous, previous, _MM_SHUFFLE(1,1,1,1)));
+    #else
+    const float32x4_t b0 = vdupq_n_f32(coefficients[0]);
+    const float32x4_t b1 = vdupq_n_f32(coefficients[1]);
+    const float32x4_t b2 = vdupq_n_f32(coefficients[2]);
+    float32x4_t previous = vsetq_lane_f32(history[0], vsetq_lane_f32(history[1],
+        vdupq_n_f32(0.0f), 2), 3); // -, -, x[n-2], x[n-1]
+    // multiplies and adds are kept separate, so that the rounding equals the scalar recursion
+    for (; i + 4 <= endIndex; i += 4) {
+      const float32x4_t x0 = vld1q_f32((const float32_t *) (input+i));
+      const float32x4_t x1 = vextq_f32(previous, x0, 3);
+      const float32x4_t x2 = vextq_f32(previous, x0, 2);
+      vst1q_f32((float32_t *) feedforward, vaddq_f32(vaddq_f32(vmulq_f32(b0, x0), vmulq_f32(b1, x1)),
+          vmulq_f32(b2, x2)));
+      previous = x0;
+      for (int k = 0; k < 4; k++) {
+        const float y0 = feedforward[k] - b3*y1 - b4*y2;
+        output[i+k] = y0;
+        y2 = y1; y1 = y0;
+      }
+    }
+    history[0] = vgetq_lane_f32(previous, 3);
+    history[1] = vgetq_lane_f32(previous, 2);
+    #endif
+    history[2] = y1;
+    history[3] = y2;
+  }
+  #endif
+  processScalar(filter->coefficients, filter->history, filter->input, filter->output, i, endIndex);
+}
+
+void BiquadEngine::processParallel(BiquadFilter *filters, int numFilters, int startIndex, int endIndex) {
+  int k = 0;
+  #if BIQUAD_ENGINE_NUM_LANES > 1
+  for (; k + BIQUAD_ENGINE_NUM_LANES <= numFilters; k += BIQUAD_ENGINE_NUM_LANES) {
+    processLanes(filters+k, startIndex, endIndex);
+  }
+  #endif
+  for (; k < numFilters; k++) {
+    process(filters+k, startIndex, endIndex);
+  }
+}
+
+#if __AVX__
+/** Transposes the 8x8 matrix held in the given rows. */
+static inline void transpose8(__m256 *r) {
+  const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+  const __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+  const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+  const __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+  const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+  const __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+  const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+  const __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+  const __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1,0,1,0));
+  const __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3,2,3,2));
+  const __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1,0,1,0));
+  const __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3,2,3,2));
+  const __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1,0,1,0));
+  const __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3,2,3,2));
+  const __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1,0,1,0));
+  const __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3,2,3,2));
+  r[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+  r[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+  r[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+  r[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+  r[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+  r[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+  r[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+  r[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+#endif
+
+void BiquadEngine::processLanes(BiquadFilter *filters, int startIndex, int endIndex) {
+  #if BIQUAD_ENGINE_NUM_LANES > 1
+  const int L = BIQUAD_ENGINE_NUM_LANES;
+
+  // the coefficients and history of filter j are kept in lane j
+  float lanes[9][BIQUAD_ENGINE_NUM_LANES];
+  for (int j = 0; j < L; j++) {
+    for (int c = 0; c < 5; c++) lanes[c][j] = filters[j].coefficients[c];
+    for (int h = 0; h < 4; h++) lanes[5+h][j] = filters[j].history[h];
+  }
+
+  int i = startIndex;
+  float gather[BIQUAD_ENGINE_NUM_LANES];
+
+  #if __AVX__
+  const __m256 b0 = _mm256_loadu_ps(lanes[0]);
+  const __m256 b1 = _mm256_loadu_ps(lanes[1]);
+  const __m256 b2 = _mm256_loadu_ps(lanes[2]);
+  const __m256 b3 = _mm256_loadu_ps(lanes[3]);
+  const __m256 b4 = _mm256_loadu_ps(lanes[4]);
+  __m256 x1 = _mm256_loadu_ps(lanes[5]);
+  __m256 x2 = _mm256_loadu_ps(lanes[6]);
+  __m256 y1 = _mm256_loadu_ps(lanes[7]);
+  __m256 y2 = _mm256_loadu_ps(lanes[8]);
+  #define BIQUAD_ENGINE_STEP(_x0, _y0) \
+    const __m256 _y0 = _mm256_sub_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_add_ps( \
+        _mm256_mul_ps(b0, _x0), _mm256_mul_ps(b1, x1)), _mm256_mul_ps(b2, x2)), \
+        _mm256_mul_ps(b3, y1)), _mm256_mul_ps(b4, y2)); \
+    x2 = x1; x1 = _x0; y2 = y1; y1 = _y0;
+  for (; i + L <= endIndex; i += L) {
+    // read L samples of each filter, such that row s then holds sample i+s of all filters
+    __m256 rows[BIQUAD_ENGINE_NUM_LANES];
+    for (int j = 0; j < L; j++) rows[j] = _mm256_loadu_ps(filters[j].input+i);
+    transpose8(rows);
+    for (int s = 0; s < L; s++) {
+      BIQUAD_ENGINE_STEP(rows[s], y0)
+      rows[s] = y0;
+    }
+    transpose8(rows);
+    for (int j = 0; j < L; j++) _mm256_storeu_ps(filters[j].output+i, rows[j]);
+  }
+  for (; i < endIndex; i++) {
+    for (int j = 0; j < L; j++) gather[j] = filters[j].input[i];
+    BIQUAD_ENGINE_STEP(_mm256_loadu_ps(gather), y0)
+    _mm256_storeu_ps(gather, y0);
+    for (int j = 0; j < L; j++) filters[j].output[i] = gather[j];
+  }
+  #undef BIQUAD_ENGINE_STEP
+  _mm256_storeu_ps(lanes[5], x1);
+  _mm256_storeu_ps(lanes[6], x2);
+  _mm256_storeu_ps(lanes[7], y1);
+  _mm256_storeu_ps(lanes[8], y2);
+  #elif __SSE__
+  const __m128 b0 = _mm_loadu_ps(lanes[0]);
+  const __m128 b1 = _mm_loadu_ps(lanes[1]);
+  const __m128 b2 = _mm_loadu_ps(lanes[2]);
+  const __m128 b3 = _mm_loadu_ps(lanes[3]);
+  const __m128 b4 = _mm_loadu_ps(lanes[4]);
+  __m128 x1 = _mm_loadu_ps(lanes[5]);
+  __m128 x2 = _mm_loadu_ps(lanes[6]);
+  __m128 y1 = _mm_loadu_ps(lanes[7]);
+  __m128 y2 = _mm_loadu_ps(lanes[8]);
+  #define BIQUAD_ENGINE_STEP(_x0, _y0) \
+    const __m128 _y0 = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(_mm_add_ps( \
+        _mm_mul_ps(b0, _x0), _mm_mul_ps(b1, x1)), _mm_mul_ps(b2, x2)), \
+        _mm_mul_ps(b3, y1)), _mm_mul_ps(b4, y2)); \
+    x2 = x1; x1 = _x0; y2 = y1; y1 = _y0;
+  for (; i + L <= endIndex; i += L) {
+    // read L samples of each filter, such that row s then holds sample i+s of all filters
+    __m128 rows[BIQUAD_ENGINE_NUM_LANES];
+    for (int j = 0; j < L; j++) rows[j] = _mm_loadu_ps(filters[j].input+i);
+    _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+    for (int s = 0; s < L; s++) {
+      BIQUAD_ENGINE_STEP(rows[s], y0)
+      rows[s] = y0;
+    }
+    _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+    for (int j = 0; j < L; j++) _mm_storeu_ps(filters[j].output+i, rows[j]);
+  }
+  for (; i < endIndex; i++) {
+    for (int j = 0; j < L; j++) gather[j] = filters[j].input[i];
+    BIQUAD_ENGINE_STEP(_mm_loadu_ps(gather), y0)
+    _mm_storeu_ps(gather, y0);
+    for (int j = 0; j < L; j++) filters[j].output[i] = gather[j];
+  }
+  #undef BIQUAD_ENGINE_STEP
+  _mm_storeu_ps(lanes[5], x1);
+  _mm_storeu_ps(lanes[6], x2);
+  _mm_storeu_ps(lanes[7], y1);
+  _mm_storeu_ps(lanes[8], y2);
+  #else
+  const float32x4_t b0 = vld1q_f32((const float32_t *) lanes[0]);
+  const float32x4_t b1 = vld1q_f32((const float32_t *) lanes[1]);
+  const float32x4_t b2 = vld1q_f32((const float32_t *) lanes[2]);
+  const float32x4_t b3 = vld1q_f32((const float32_t *) lanes[3]);
+  const float32x4_t b4 = vld1q_f32((const float32_t *) lanes[4]);
+  float32x4_t x1 = vld1q_f32((const float32_t *) lanes[5]);
+  float32x4_t x2 = vld1q_f32((const float32_t *) lanes[6]);
+  float32x4_t y1 = vld1q_f32((const float32_t *) lanes[7]);
+  float32x4_t y2 = vld1q_f32((const float32_t *) lanes[8]);
+  // multiplies and adds are kept separate, so that the rounding equals the scalar recursion
+  for (; i < endIndex; i++) {
+    for (int j = 0; j < L; j++) gather[j] = filters[j].input[i];
+    const float32x4_t x0 = vld1q_f32((const float32_t *) gather);
+    const float32x4_t y0 = vsubq_f32(vsubq_f32(vaddq_f32(vaddq_f32(
+        vmulq_f32(b0, x0), vmulq_f32(b1, x1)), vmulq_f32(b2, x2)),
+        vmulq_f32(b3, y1)), vmulq_f32(b4, y2));
+    x2 = x1; x1 = x0; y2 = y1; y1 = y0;
+    vst1q_f32((float32_t *) gather, y0);
+    for (int j = 0; j < L; j++) filters[j].output[i] = gather[j];
+  }
+  vst1q_f32((float32_t *) lanes[5], x1);
+  vst1q_f32((float32_t *) lanes[6], x2);
+  vst1q_f32((float32_t *) lanes[7], y1);
+  vst1q_f32((float32_t *) lanes[8], y2);
+  #endif
+
+  for (int j = 0; j < L; j++) {
+    for (int h = 0; h < 4; h++) filters[j].history[h] = lanes[5+h][j];
+  }
+  #endif
+}
@@ -0,0 +1,77 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _BIQUAD_ENGINE_H_
+#define _BIQUAD_ENGINE_H_
+
+/** The number of filters which <code>BiquadEngine::processParallel()</code> runs side by side. */
+#if __AVX__
+#define BIQUAD_ENGINE_NUM_LANES 8
+#elif __SSE__ || __ARM_NEON__
+#define BIQUAD_ENGINE_NUM_LANES 4
+#else
+#define BIQUAD_ENGINE_NUM_LANES 1
+#endif
+
+/** One biquad as seen by the <code>BiquadEngine</code>. All of its state is owned by the caller. */
+typedef struct BiquadFilter {
+  const float *coefficients; // b0, b1, b2, a1, a2, as in ArrayArithmetic::biquad()
+  float *history; // x[n-1], x[n-2], y[n-1], y[n-2]
+  float *input;
+  float *output; // may be the same array as the input
+} BiquadFilter;
+
+/**
+ * Runs biquads (with the same difference equation as <code>ArrayArithmetic::biquad()</code>). The
+ * recursion cannot be vectorised over time, so the speedup comes from running several filters
+ * side by side, one per lane.
+ *
+ * A single filter only computes its feedforward terms four samples at a time. The feedback terms
+ * remain a scalar recursion, whose latency bounds its speed. Both paths compute the same operations
+ * in the same order as the scalar recursion, with multiply-add contraction disabled for this file,
+ * such that the results are bit-identical to it and a filter sounds the same whether it is batched
+ * or not.
+ */
+class BiquadEngine {
+
+  public:
+    /** Processes one filter over the given range. */
+    static void process(BiquadFilter *filter, int startIndex, int endIndex);
+
+    /**
+     * Processes any number of independent filters over the same range, in groups of
+     * <code>BIQUAD_ENGINE_NUM_LANES</code>. Filters left over are processed with
+     * <code>process()</code>. No filter may write an array which another reads.
+     */
+    static void processParallel(BiquadFilter *filters, int numFilters, int startIndex, int endIndex);
+
+  private:
+    /** Processes exactly <code>BIQUAD_ENGINE_NUM_LANES</code> filters, one per lane. */
+    static void processLanes(BiquadFilter *filters, int startIndex, int endIndex);
+
+    /** The plain recursion, which finishes ranges that are not a whole number of groups. */
+    static void processScalar(const float *coefficients, float *history, float *input, float *output,
+        int startIndex, int endIndex);
+
+    BiquadEngine(); // no instances of this object are allowed
+    ~BiquadEngine();
+};
+
+#endif // _BIQUAD_ENGINE_H_
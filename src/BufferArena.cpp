@@ -0,0 +1,139 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#if __linux__
+#include <sys/mman.h>
+#endif
+#include "BufferArena.h"
+
+BufferArena::BufferArena() {
+  numBytesAllocated = 0;
+  numBytesReserved = 0;
+  useHugePages = false;
+}
+
+BufferArena::~BufferArena() {
+  for (unsigned int i = 0; i < chunks.size(); i++) {
+    freeChunk(&chunks[i]);
+  }
+  for (map<float *, ArenaChunk>::iterator it = largeBuffers.begin(); it != largeBuffers.end(); ++it) {
+    freeChunk(&it->second);
+  }
+}
+
+void BufferArena::freeChunk(ArenaChunk *chunk) {
+  #if __linux__
+  if (chunk->isMapped) {
+    munmap(chunk->base, chunk->size);
+    return;
+  }
+  #endif
+  free(chunk->base);
+}
+
+bool BufferArena::reserveChunk(size_t size, bool fromHugePages, ArenaChunk *chunk) {
+  chunk->base = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->isMapped = false;
+  #if __linux__
+  if (fromHugePages) {
+    size = ((size + BUFFER_ARENA_HUGE_PAGE_SIZE - 1) / BUFFER_ARENA_HUGE_PAGE_SIZE) * BUFFER_ARENA_HUGE_PAGE_SIZE;
+    #ifdef MAP_HUGETLB
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (base != MAP_FAILED) {
+      chunk->base = (char *) base;
+      chunk->isMapped = true;
+    }
+    #endif
+    chunk->size = size;
+  }
+  #endif
+
+  if (chunk->base == NULL) {
+    void *base = NULL;
+    size_t alignment = fromHugePages ? BUFFER_ARENA_HUGE_PAGE_SIZE : BUFFER_ARENA_ALIGNMENT;
+    if (posix_memalign(&base, alignment, chunk->size) != 0) return false;
+    chunk->base = (char *) base;
+    #if __linux__ && defined(MADV_HUGEPAGE)
+    // no huge pages have been reserved, but the kernel may still provide transparent ones
+    if (fromHugePages) madvise(base, chunk->size, MADV_HUGEPAGE);
+    #endif
+  }
+
+  // mapped pages are already zeroed
+  if (!chunk->isMapped) memset(chunk->base, 0, chunk->size);
+  numBytesReserved += chunk->size;
+  return true;
+}
+
+float *BufferArena::allocate(size_t numBytes) {
+  size_t size = ((numBytes + BUFFER_ARENA_ALIGNMENT - 1) / BUFFER_ARENA_ALIGNMENT) * BUFFER_ARENA_ALIGNMENT;
+  if (size == 0) size = BUFFER_ARENA_ALIGNMENT;
+
+  if (size >= BUFFER_ARENA_LARGE_BUFFER_SIZE) {
+    ArenaChunk chunk;
+    // a large buffer is not rounded up to a huge page unless it fills one anyway
+    if (!reserveChunk(size, useHugePages && size >= BUFFER_ARENA_HUGE_PAGE_SIZE, &chunk)) return NULL;
+    float *buffer = (float *) chunk.base;
+    largeBuffers[buffer] = chunk;
+    numBytesAllocated += size;
+    return buffer;
+  }
+
+  float *buffer = NULL;
+  map<size_t, vector<float *> >::iterator it = freeBuffers.find(size);
+  if (it != freeBuffers.end() && !it->second.empty()) {
+    buffer = it->second.back();
+    it->second.pop_back();
+    memset(buffer, 0, size);
+  } else {
+    // buffers are only carved from the most recent chunk, such that they follow the order of
+    // allocation. The remainder of an older chunk (less than a large buffer) is left unused.
+    if (chunks.empty() || chunks.back().size - chunks.back().used < size) {
+      ArenaChunk chunk;
+      if (!reserveChunk(BUFFER_ARENA_CHUNK_SIZE, useHugePages, &chunk)) return NULL;
+      chunks.push_back(chunk);
+    }
+    ArenaChunk *chunk = &chunks.back();
+    buffer = (float *) (chunk->base + chunk->used);
+    chunk->used += size;
+  }
+  numBytesAllocated += size;
+  return buffer;
+}
+
+void BufferArena::release(float *buffer, size_t numBytes) {
+  if (buffer == NULL) return;
+  size_t size = ((numBytes + BUFFER_ARENA_ALIGNMENT - 1) / BUFFER_ARENA_ALIGNMENT) * BUFFER_ARENA_ALIGNMENT;
+  if (size == 0) size = BUFFER_ARENA_ALIGNMENT;
+  numBytesAllocated -= size;
+  if (size >= BUFFER_ARENA_LARGE_BUFFER_SIZE) {
+    map<float *, ArenaChunk>::iterator it = largeBuffers.find(buffer);
+    if (it == largeBuffers.end()) return;
+    numBytesReserved -= it->second.size;
+    freeChunk(&it->second);
+    largeBuffers.erase(it);
+  } else {
+    freeBuffers[size].push_back(buffer);
+  }
+}
@@ -0,0 +1,113 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _BUFFER_ARENA_H_
+#define _BUFFER_ARENA_H_
+
+#include <stddef.h>
+#include <map>
+#include <vector>
+using namespace std;
+
+/** The alignment of every buffer in the arena, one cache line (and one AVX-512 vector). */
+#define BUFFER_ARENA_ALIGNMENT 64
+
+/** The size of each chunk from which buffers are carved. */
+#define BUFFER_ARENA_CHUNK_SIZE (256 * 1024)
+
+/**
+ * Buffers of at least this size (e.g. delay lines) are not carved from a chunk, but are given a
+ * chunk of their own which is freed when they are released.
+ */
+#define BUFFER_ARENA_LARGE_BUFFER_SIZE (64 * 1024)
+
+#define BUFFER_ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * A <code>BufferArena</code> is the backing store of all block buffers of a root graph, those
+ * shared through its <code>BufferPool</code>s as well as those owned by objects such as
+ * <code>send~</code>, <code>receive~</code>, <code>throw~</code> and <code>delwrite~</code>.
+ * Buffers are carved from large chunks in the order in which they are requested, each aligned to
+ * a cache line such that no two buffers share one. Usually there is only one chunk. A buffer which
+ * is released is reused by the next request of the same size. As only block sized buffers are
+ * carved from chunks, all chunks have the same size and at most a large buffer's worth is left
+ * unused at the end of each. Large buffers have their own chunk and return it to the system when
+ * they are released, such that the arena does not keep the memory of e.g. a deleted delay line.
+ *
+ * Chunks may optionally be backed by huge pages. On Linux an explicit huge page mapping is tried
+ * first, falling back to transparent huge pages.
+ */
+class BufferArena {
+
+  public:
+    BufferArena();
+    ~BufferArena();
+
+    /**
+     * Returns a zeroed buffer of at least <code>numBytes</code>, aligned to a cache line, or
+     * <code>NULL</code> if no memory could be reserved for it.
+     */
+    float *allocate(size_t numBytes);
+
+    /** Returns a buffer of the given size to the arena. <code>NULL</code> is ignored. */
+    void release(float *buffer, size_t numBytes);
+
+    /** Chunks which are reserved after this call are backed by huge pages if possible. */
+    void setUseHugePages(bool useHugePages) { this->useHugePages = useHugePages; }
+
+    /** The number of bytes currently handed out as buffers, including alignment padding. */
+    size_t getNumBytesAllocated() { return numBytesAllocated; }
+
+    /** The number of bytes reserved by the arena, i.e. its memory footprint. */
+    size_t getNumBytesReserved() { return numBytesReserved; }
+
+    unsigned int getNumChunks() { return chunks.size(); }
+
+  private:
+    typedef struct ArenaChunk {
+      char *base;
+      size_t size;
+      size_t used;
+      bool isMapped; // allocated with mmap() rather than posix_memalign()
+    } ArenaChunk;
+
+    /**
+     * Reserves zeroed memory of at least the given size, from huge pages if requested. Returns
+     * <code>false</code> on failure.
+     */
+    bool reserveChunk(size_t size, bool fromHugePages, ArenaChunk *chunk);
+
+    /** Returns the memory of the chunk to the system. */
+    void freeChunk(ArenaChunk *chunk);
+
+    vector<ArenaChunk> chunks;
+
+    /** The chunks of all large buffers which are in use, by their address. */
+    map<float *, ArenaChunk> largeBuffers;
+
+    /** Released buffers, by their (padded) size. */
+    map<size_t, vector<float *> > freeBuffers;
+
+    size_t numBytesAllocated;
+    size_t numBytesReserved;
+    bool useHugePages;
+};
+
+#endif // _BUFFER_ARENA_H_
@@ -20,74 +20,183 @@
  *
  */
 
+#include <stdint.h>
+#include <string.h>
 #include "BufferPool.h"
 #include "DspObject.h"
 
-BufferPool::BufferPool(unsigned short size) {
+BufferPool::BufferPool(unsigned short size, BufferArena *arena) {
   bufferSize = size;
- 
-  zeroBuffer = ALLOC_ALIGNED_BUFFER(bufferSize * sizeof(float));
-  memset(zeroBuffer, 0, bufferSize*sizeof(float)); // zero the zero buffer!
+  numReservedBuffers = 0;
+  handleTable = vector<unsigned int>(16, 0);
+  ownsArena = (arena == NULL);
+  this->arena = ownsArena ? new BufferArena() : arena;
+
+  zeroBuffer = this->arena->allocate(bufferSize * sizeof(float)); // arena buffers are zeroed
+  scratchBuffer = this->arena->allocate(bufferSize * sizeof(float));
+  numAllocationFailures = 0;
 }
 
 BufferPool::~BufferPool() {
-  // free all buffers, reserved and available
-  for (list<std::pair<float *, unsigned int> >::iterator it = reserved.begin(); it != reserved.end(); ++it) {
-    FREE_ALIGNED_BUFFER((*it).first);
+  // sized pools share the arena, so they must be gone before it is deleted
+  for (map<unsigned short, BufferPool *>::iterator it = sizedPools.begin(); it != sizedPools.end(); ++it) {
+    delete it->second;
+  }
+
+  // return all buffers, reserved and available
+  for (unsigned int i = 0; i < buffers.size(); i++) {
+    arena->release(buffers[i], bufferSize * sizeof(float));
   }
-  while (!pool.empty()) {
-    FREE_ALIGNED_BUFFER(pool.top());
-    pool.pop();
+  for (unsigned int i = 0; i < freeBuffers.size(); i++) {
+    arena->release(freeBuffers[i], bufferSize * sizeof(float));
   }
-  FREE_ALIGNED_BUFFER(zeroBuffer);
+  arena->release(zeroBuffer, bufferSize * sizeof(float));
+  arena->release(scratchBuffer, bufferSize * sizeof(float));
+
+  if (ownsArena) delete arena;
 }
 
-float *BufferPool::getBuffer(unsigned int numDependencies) {
-  float *buffer = NULL;
-  if (pool.size() > 0) {
-    buffer = pool.top();
-    pool.pop();
+unsigned int BufferPool::findSlot(float *buffer) {
+  // buffers are cache line aligned, so the low bits of the address carry no information
+  const unsigned int mask = handleTable.size() - 1;
+  unsigned int slot = (((unsigned int) (((uintptr_t) buffer) >> 6)) * 2654435761u) & mask;
+  while (handleTable[slot] != 0 && buffers[handleTable[slot]-1] != buffer) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+int BufferPool::getHandle(float *buffer) {
+  if (buffer == NULL) return -1;
+  unsigned int slot = findSlot(buffer);
+  return ((int) handleTable[slot]) - 1;
+}
+
+void BufferPool::addBuffer(float *buffer) {
+  unsigned int handle = buffers.size();
+  buffers.push_back(buffer);
+  referenceCounts.push_back(0);
+  isReserved.push_back(0);
+  availableHandles.push_back(handle);
+
+  if (2 * buffers.size() > handleTable.size()) {
+    // grow the table and reinsert all buffers
+    handleTable = vector<unsigned int>(2 * handleTable.size(), 0);
+    for (unsigned int i = 0; i < buffers.size(); i++) {
+      handleTable[findSlot(buffers[i])] = i + 1;
+    }
   } else {
-    buffer = ALLOC_ALIGNED_BUFFER(bufferSize * sizeof(float));
-    memset(buffer, 0, bufferSize * sizeof(float));
+    handleTable[findSlot(buffer)] = handle + 1;
+  }
+}
+
+float *BufferPool::allocateBuffer() {
+  float *buffer = arena->allocate(bufferSize * sizeof(float));
+  if (buffer == NULL) {
+    if (numAllocationFailures++ == 0) {
+      printf("Could not allocate a buffer of %i samples. Some signals will be corrupted.\n", bufferSize);
+    }
+    // if even the scratch buffer could not be allocated, there is nothing left to hand out
+    if (scratchBuffer != NULL) memset(scratchBuffer, 0, bufferSize * sizeof(float));
+    return scratchBuffer;
   }
-  reserved.push_back(std::pair<float *, unsigned int>(buffer, numDependencies));
-//  printf("%i/%i buffer used.\n", getNumReservedBuffers(), getNumTotalBuffers());
   return buffer;
 }
 
+unsigned int BufferPool::getNumAllocationFailures() {
+  unsigned int numFailures = numAllocationFailures;
+  for (map<unsigned short, BufferPool *>::iterator it = sizedPools.begin(); it != sizedPools.end(); ++it) {
+    numFailures += it->second->getNumAllocationFailures();
+  }
+  return numFailures;
+}
+
+float *BufferPool::getBuffer(unsigned int numDependencies) {
+  if (availableHandles.empty()) {
+    if (freeBuffers.empty()) {
+      float *buffer = allocateBuffer();
+      if (buffer == scratchBuffer) return buffer;
+      addBuffer(buffer);
+    } else {
+      addBuffer(freeBuffers.back());
+      freeBuffers.pop_back();
+    }
+  }
+  unsigned int handle = availableHandles.back();
+  availableHandles.pop_back();
+  referenceCounts[handle] = numDependencies;
+  isReserved[handle] = 1;
+  numReservedBuffers++;
+//  printf("%i/%i buffer used.\n", getNumReservedBuffers(), getNumTotalBuffers());
+  return buffers[handle];
+}
+
 void BufferPool::releaseBuffer(float *buffer) {
   // an object may try to release the zero buffer. This should not be possible.
-  if (buffer == zeroBuffer) return;
+  if (buffer == zeroBuffer || buffer == scratchBuffer) return;
   
-  for (list<std::pair<float *, unsigned int> >::iterator it = reserved.begin(); it != reserved.end(); ++it) {
-    if ((*it).first == buffer) {
-      --((*it).second);
-      if ((*it).second <= 0) {
-        reserved.erase(it);
-        pool.push(buffer);
-//        printf("%i/%i buffer used.\n", getNumReservedBuffers(), getNumTotalBuffers());
-        break;
-      }
-    }
-  }
   // if the buffer is not in the reserved pool, nothing changes. Untracked buffers are left alone.
+  int handle = getHandle(buffer);
+  if (handle < 0 || !isReserved[handle] || referenceCounts[handle] == 0) return;
+  
+  if (--referenceCounts[handle] == 0) {
+    isReserved[handle] = 0;
+    numReservedBuffers--;
+    availableHandles.push_back(handle);
+//    printf("%i/%i buffer used.\n", getNumReservedBuffers(), getNumTotalBuffers());
+  }
 }
 
 void BufferPool::reserveBuffer(float *buffer, unsigned int reserveCount) {
-  if (buffer == zeroBuffer) return; // no need to reserve the zero buffer
+  if (buffer == zeroBuffer || buffer == scratchBuffer) return; // no need to reserve these
   
-  for (list<std::pair<float *, unsigned int> >::iterator it = reserved.begin(); it != reserved.end(); ++it) {
-    if ((*it).first == buffer) {
-      (*it).second += reserveCount;
-      return;
-    }
+  int handle = getHandle(buffer);
+  if (handle >= 0 && isReserved[handle]) {
+    referenceCounts[handle] += reserveCount;
+    return;
   }
   
   printf("Attempt to reserve unreserved buffer %p +%i.\n  "
       "This may be ok if the buffer is global such as an adc~ input buffer.\n", buffer, reserveCount);
 }
 
+BufferPool *BufferPool::getPoolForSize(unsigned short size) {
+  if (size == bufferSize) return this;
+  map<unsigned short, BufferPool *>::iterator it = sizedPools.find(size);
+  if (it != sizedPools.end()) return it->second;
+  BufferPool *pool = new BufferPool(size, arena);
+  sizedPools[size] = pool;
+  return pool;
+}
+
+float *BufferPool::getExclusiveBuffer() {
+  // never taken from the available buffers, which are still in use by objects which were ordered
+  // earlier, even though their reference count has dropped to zero
+  if (freeBuffers.empty()) return allocateBuffer();
+  float *buffer = freeBuffers.back();
+  freeBuffers.pop_back();
+  memset(buffer, 0, bufferSize * sizeof(float));
+  return buffer;
+}
+
+void BufferPool::returnExclusiveBuffer(float *buffer) {
+  if (buffer == scratchBuffer) return;
+  freeBuffers.push_back(buffer);
+}
+
+float *BufferPool::getNewBuffer() {
+  float *buffer = NULL;
+  if (freeBuffers.empty()) {
+    buffer = allocateBuffer();
+    if (buffer == scratchBuffer) return buffer;
+  } else {
+    buffer = freeBuffers.back();
+    freeBuffers.pop_back();
+  }
+  addBuffer(buffer);
+  return buffer;
+}
+
 /*
 void BufferPool::resizeBuffers(unsigned int newBufferSize) {
   for (list<std::pair<float *, unsigned int> >::iterator it = reserved.begin(); it != reserved.end(); ++it) {
@@ -23,13 +23,28 @@
 #ifndef _BUFFER_POOL_
 #define _BUFFER_POOL_
 
-#include <list>
-#include <stack>
+#include <map>
+#include <vector>
+#include "BufferArena.h"
 using namespace std;
 
+/**
+ * The <code>BufferPool</code> owns the block buffers which are shared between dsp objects. Each
+ * buffer is identified by a handle, its index in the pool. Reference counts are stored by handle
+ * and the handle of a buffer is found through a small hash table keyed by its address, such that
+ * reserving and releasing a buffer are constant time operations.
+ *
+ * All buffers are carved from a <code>BufferArena</code>. The root pool owns it and shares it with
+ * its sized pools. Buffers are allocated from the arena in handle order, so that their layout in
+ * memory follows the order in which the <code>DspPlan</code> first uses them. If the arena cannot
+ * provide a new buffer, the pool hands out its scratch buffer instead. It is shared by all such
+ * signals and is not tracked, so that the graph keeps running (with corrupted signals) rather than
+ * writing through a <code>NULL</code> buffer. These failures are counted.
+ */
 class BufferPool {
   public:
-    BufferPool(unsigned short bufferSize);
+    /** If <code>arena</code> is <code>NULL</code>, the pool creates and owns its own arena. */
+    BufferPool(unsigned short bufferSize, BufferArena *arena = NULL);
     ~BufferPool();
   
     /**
@@ -43,26 +58,110 @@ class BufferPool {
   
     /** Add to the reserve cound of the given buffer. */
     void reserveBuffer(float *buffer, unsigned int reserveCount);
+
+    /**
+     * Returns a zeroed buffer which is not shared with any other object. It is taken from the
+     * returned exclusive buffers if there are any, and is otherwise newly allocated. The pool does
+     * not track the buffer.
+     */
+    float *getExclusiveBuffer();
+
+    /**
+     * Puts a buffer from <code>getExclusiveBuffer()</code> back on the free list, from which both
+     * exclusive and shared buffers are taken before new ones are allocated.
+     */
+    void returnExclusiveBuffer(float *buffer);
   
+    /**
+     * Adds a buffer which is not held by any object to the pool, and returns it. It is taken from
+     * the returned exclusive buffers if there are any. Like all buffers whose reference count has
+     * dropped to zero, it is available. Used by the <code>DspPlan</code> if its assignment needs
+     * more buffers than the objects hold.
+     */
+    float *getNewBuffer();
+
     /** Resizes all buffers in the pool (reserved and available). */
 //    void resizeBuffers(unsigned int newBufferSize);
   
     float *get_zero_buffer() { return zeroBuffer; }
+
+    /** The number of times that the arena could not provide a buffer, in this pool or its sized pools. */
+    unsigned int getNumAllocationFailures();
+
+    unsigned short getBufferSize() { return bufferSize; }
+
+    /** The arena from which all buffers of this pool are allocated. */
+    BufferArena *getArena() { return arena; }
+
+    /**
+     * Returns the pool of buffers with the given size, which is owned by this pool. It is created
+     * if necessary. Used by subgraphs with a block size different from that of the root graph.
+     */
+    BufferPool *getPoolForSize(unsigned short size);
+
+    /**
+     * Returns the handle of the given buffer, or -1 if the buffer is not tracked by this pool (e.g.
+     * the zero buffer, buffers owned by objects, or exclusive buffers).
+     */
+    int getHandle(float *buffer);
+
+    /** Returns the buffer with the given handle. */
+    float *getBufferWithHandle(unsigned int handle) { return buffers[handle]; }
   
-    unsigned int getNumReservedBuffers() { return reserved.size(); }
-    unsigned int getNumAvailableBuffers() { return pool.size(); }
-    unsigned int getNumTotalBuffers() { return (pool.size() + reserved.size()); }
+    unsigned int getNumReservedBuffers() { return numReservedBuffers; }
+    unsigned int getNumAvailableBuffers() { return availableHandles.size(); }
+    unsigned int getNumTotalBuffers() { return buffers.size(); }
   
   private:
-    /** A pool of reserved buffers, paired with the number of outstanding dependencies. */
-    list<std::pair<float *, unsigned int> > reserved;
-  
-    /** A pool of available buffers. */
-    stack<float *> pool;
+    /** Starts tracking the given buffer as an available buffer. */
+    void addBuffer(float *buffer);
+
+    /**
+     * Returns a new buffer from the arena, or the scratch buffer if the arena fails. The scratch
+     * buffer must not be tracked.
+     */
+    float *allocateBuffer();
+
+    /** Returns the slot of the given buffer in the hash table, which is empty if it is not tracked. */
+    unsigned int findSlot(float *buffer);
+
+    /** All tracked buffers, indexed by handle. */
+    vector<float *> buffers;
+
+    /** The number of outstanding dependencies of each buffer. */
+    vector<unsigned int> referenceCounts;
+
+    /** Set if the buffer with the same handle is reserved. */
+    vector<unsigned char> isReserved;
+
+    /** The handles of all available buffers. The most recently released buffer is at the back. */
+    vector<unsigned int> availableHandles;
+
+    /**
+     * An open-addressed hash table from buffer address to handle+1. Zero marks an empty slot.
+     * The table is never more than half full. Buffers are never removed from the pool.
+     */
+    vector<unsigned int> handleTable;
+
+    /** Exclusive buffers which have been returned and are not yet used again. */
+    vector<float *> freeBuffers;
+
+    unsigned int numReservedBuffers;
   
     float *zeroBuffer;
+
+    /** Handed out in place of buffers which the arena could not provide. */
+    float *scratchBuffer;
+
+    unsigned int numAllocationFailures;
+
+    /** Pools of buffers with other sizes, by size. */
+    map<unsigned short, BufferPool *> sizedPools;
   
     unsigned short bufferSize;
+
+    BufferArena *arena;
+    bool ownsArena;
 };
 
 #endif // _BUFFER_POOL_
@@ -0,0 +1,102 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _CONNECTION_TABLE_H_
+#define _CONNECTION_TABLE_H_
+
+#include <vector>
+#include "MessageObject.h"
+using namespace std;
+
+/**
+ * A view of the connections at one inlet or outlet, as stored in a <code>ConnectionTable</code>.
+ * It is cheap to copy and does not allocate, but is only valid until the table changes.
+ */
+class ConnectionSpan {
+
+  public:
+    typedef const ObjectConnection *iterator;
+
+    ConnectionSpan() : first(NULL), length(0) {}
+    ConnectionSpan(const ObjectConnection *first, unsigned int length) : first(first), length(length) {}
+
+    iterator begin() const { return first; }
+    iterator end() const { return first + length; }
+    unsigned int size() const { return length; }
+    bool empty() const { return length == 0; }
+    const ObjectConnection &front() const { return first[0]; }
+    const ObjectConnection &operator[](unsigned int i) const { return first[i]; }
+
+  private:
+    const ObjectConnection *first;
+    unsigned int length;
+};
+
+/**
+ * The connections at all inlets (or all outlets) of an object, stored contiguously and ordered by
+ * let. The connections of let <i>i</i> are <code>[offsets[i], offsets[i+1])</code>. Connections
+ * change rarely and are read often, e.g. whenever the process order is computed, so adding or
+ * removing one shifts the connections of the following lets.
+ */
+class ConnectionTable {
+
+  public:
+    ConnectionTable() {}
+    explicit ConnectionTable(unsigned int numLets) : offsets(numLets+1, 0) {}
+
+    /** Returns the number of lets. */
+    unsigned int size() const { return offsets.empty() ? 0 : offsets.size()-1; }
+    bool empty() const { return size() == 0; }
+
+    /** Returns the connections at the given let. */
+    ConnectionSpan operator[](unsigned int letIndex) const {
+      return (letIndex < size())
+          ? ConnectionSpan(connections.data() + offsets[letIndex], offsets[letIndex+1] - offsets[letIndex])
+          : ConnectionSpan();
+    }
+
+    /** Returns the total number of connections at all lets. */
+    unsigned int getNumConnections() const { return connections.size(); }
+
+    /** Appends the connection to those at the given let. */
+    void add(unsigned int letIndex, ObjectConnection connection) {
+      connections.insert(connections.begin() + offsets[letIndex+1], connection);
+      for (unsigned int i = letIndex+1; i < offsets.size(); i++) offsets[i]++;
+    }
+
+    /** Removes all occurrences of the connection from the given let. */
+    void remove(unsigned int letIndex, ObjectConnection connection) {
+      unsigned int i = offsets[letIndex];
+      while (i < offsets[letIndex+1]) {
+        if (connections[i] == connection) {
+          connections.erase(connections.begin() + i);
+          for (unsigned int j = letIndex+1; j < offsets.size(); j++) offsets[j]--;
+        } else {
+          i++;
+        }
+      }
+    }
+
+  private:
+    vector<ObjectConnection> connections;
+    vector<unsigned int> offsets;
+};
+
+#endif // _CONNECTION_TABLE_H_
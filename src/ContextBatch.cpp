@@ -0,0 +1,191 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+#include <time.h>
+#include "ContextBatch.h"
+#include "pd::Context.h"
+
+ContextBatch::ContextBatch(unsigned int numThreads, bool shouldPinThreads) {
+  contexts = NULL;
+  inputBuffers = NULL;
+  outputBuffers = NULL;
+  renderTimes = NULL;
+  numWorkersRemaining = 0;
+  batchIndex = 0;
+  isRunning = true;
+  pthread_mutex_init(&batchLock, NULL);
+  pthread_cond_init(&batchStartCondition, NULL);
+  pthread_cond_init(&batchDoneCondition, NULL);
+
+  if (numThreads < 1) numThreads = 1;
+  for (unsigned int i = 0; i < numThreads; i++) {
+    Worker *worker = new Worker();
+    worker->batch = this;
+    worker->index = i;
+    worker->load = 0.0;
+    workers.push_back(worker);
+    pthread_create(&worker->thread, NULL, &workerThread, worker);
+
+    #if __linux__
+    if (shouldPinThreads) {
+      long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+      if (numCores > 0) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(i % numCores, &cpuSet);
+        pthread_setaffinity_np(worker->thread, sizeof(cpu_set_t), &cpuSet);
+      }
+    }
+    #endif
+  }
+}
+
+ContextBatch::~ContextBatch() {
+  pthread_mutex_lock(&batchLock);
+  isRunning = false;
+  pthread_cond_broadcast(&batchStartCondition);
+  pthread_mutex_unlock(&batchLock);
+
+  for (unsigned int i = 0; i < workers.size(); i++) {
+    pthread_join(workers[i]->thread, NULL);
+    delete workers[i];
+  }
+  pthread_cond_destroy(&batchDoneCondition);
+  pthread_cond_destroy(&batchStartCondition);
+  pthread_mutex_destroy(&batchLock);
+}
+
+ContextBatch::ContextLoad *ContextBatch::getContextLoad(ZGContext *context) {
+  map<ZGContext *, ContextLoad>::iterator it = contextLoads.find(context);
+  if (it != contextLoads.end()) return &it->second;
+
+  // assign new contexts to the least loaded worker. The new context is estimated to cost as much
+  // as an average measured context. Without any render history, contexts are distributed evenly.
+  double totalRenderTime = 0.0;
+  unsigned int numMeasured = 0;
+  for (it = contextLoads.begin(); it != contextLoads.end(); ++it) {
+    if (it->second.isMeasured) {
+      totalRenderTime += it->second.renderTime;
+      numMeasured++;
+    }
+  }
+  unsigned int leastLoadedWorker = 0;
+  for (unsigned int i = 0; i < workers.size(); i++) {
+    if (workers[i]->load < workers[leastLoadedWorker]->load) leastLoadedWorker = i;
+  }
+  ContextLoad *contextLoad = &contextLoads[context];
+  contextLoad->worker = leastLoadedWorker;
+  contextLoad->renderTime = (numMeasured > 0) ? totalRenderTime / numMeasured : 1.0;
+  contextLoad->isMeasured = false;
+  workers[leastLoadedWorker]->load += contextLoad->renderTime;
+  return contextLoad;
+}
+
+void ContextBatch::updateWorkerLoads() {
+  for (unsigned int i = 0; i < workers.size(); i++) {
+    workers[i]->load = 0.0;
+  }
+  for (map<ZGContext *, ContextLoad>::iterator it = contextLoads.begin(); it != contextLoads.end(); ++it) {
+    workers[it->second.worker]->load += it->second.renderTime;
+  }
+}
+
+void ContextBatch::removeContext(ZGContext *context) {
+  contextLoads.erase(context);
+  updateWorkerLoads();
+}
+
+void ContextBatch::process(ZGContext **contexts, float **inputBuffers, float **outputBuffers,
+    unsigned int numContexts, double *renderTimes) {
+  for (unsigned int i = 0; i < workers.size(); i++) {
+    workers[i]->jobs.clear();
+    workers[i]->jobLoads.clear();
+  }
+  for (unsigned int i = 0; i < numContexts; i++) {
+    ContextLoad *contextLoad = getContextLoad(contexts[i]);
+    workers[contextLoad->worker]->jobs.push_back(i);
+    workers[contextLoad->worker]->jobLoads.push_back(contextLoad);
+  }
+
+  pthread_mutex_lock(&batchLock);
+  this->contexts = contexts;
+  this->inputBuffers = inputBuffers;
+  this->outputBuffers = outputBuffers;
+  this->renderTimes = renderTimes;
+  numWorkersRemaining = workers.size();
+  ++batchIndex;
+  pthread_cond_broadcast(&batchStartCondition);
+  while (numWorkersRemaining > 0) {
+    pthread_cond_wait(&batchDoneCondition, &batchLock);
+  }
+  pthread_mutex_unlock(&batchLock);
+
+  updateWorkerLoads();
+}
+
+void *ContextBatch::workerThread(void *arg) {
+  Worker *worker = reinterpret_cast<Worker *>(arg);
+  ContextBatch *batch = worker->batch;
+  unsigned int lastBatchIndex = 0;
+  while (true) {
+    pthread_mutex_lock(&batch->batchLock);
+    while (batch->isRunning && batch->batchIndex == lastBatchIndex) {
+      pthread_cond_wait(&batch->batchStartCondition, &batch->batchLock);
+    }
+    lastBatchIndex = batch->batchIndex;
+    bool isRunning = batch->isRunning;
+    pthread_mutex_unlock(&batch->batchLock);
+
+    if (!isRunning) break;
+    batch->runWorker(worker);
+
+    pthread_mutex_lock(&batch->batchLock);
+    if (--batch->numWorkersRemaining == 0) {
+      pthread_cond_signal(&batch->batchDoneCondition);
+    }
+    pthread_mutex_unlock(&batch->batchLock);
+  }
+  return NULL;
+}
+
+void ContextBatch::runWorker(Worker *worker) {
+  for (unsigned int j = 0; j < worker->jobs.size(); j++) {
+    unsigned int i = worker->jobs[j];
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    contexts[i]->process(inputBuffers[i], outputBuffers[i]);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double renderTime = (double) (end.tv_sec - start.tv_sec) + 1.0e-9 * (end.tv_nsec - start.tv_nsec);
+    if (renderTimes != NULL) renderTimes[i] = renderTime;
+
+    // the load of the worker is only recomputed from these once all workers are done
+    ContextLoad *contextLoad = worker->jobLoads[j];
+    if (contextLoad->isMeasured) {
+      contextLoad->renderTime += CONTEXT_BATCH_RENDER_TIME_SMOOTHING * (renderTime - contextLoad->renderTime);
+    } else {
+      contextLoad->renderTime = renderTime;
+      contextLoad->isMeasured = true;
+    }
+  }
+}
@@ -0,0 +1,108 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _CONTEXT_BATCH_H_
+#define _CONTEXT_BATCH_H_
+
+#include <map>
+#include <pthread.h>
+#include <vector>
+#include "ZenGarden.h"
+using namespace std;
+
+/** The weight of the latest render time of a context in its smoothed render time. */
+#define CONTEXT_BATCH_RENDER_TIME_SMOOTHING 0.05
+
+/**
+ * A <code>ContextBatch</code> processes many independent contexts on a persistent pool of worker
+ * threads. Each context is assigned to a worker when it is first seen and stays with that worker
+ * on subsequent calls, such that its state remains in the caches of the same core. The render time
+ * of each context is smoothed over many calls, and the load of a worker is the sum of those of the
+ * contexts assigned to it. New contexts are assigned to the least loaded worker. Workers may
+ * optionally be pinned to cores (Linux only).
+ */
+class ContextBatch {
+
+  public:
+    ContextBatch(unsigned int numThreads, bool shouldPinThreads);
+    ~ContextBatch();
+
+    /**
+     * Processes one block of each of the given contexts. Buffers are as for
+     * <code>zg_context_process()</code>. If <code>renderTimes</code> is not NULL, the time in
+     * seconds that each context took to render is written to it.
+     */
+    void process(ZGContext **contexts, float **inputBuffers, float **outputBuffers,
+        unsigned int numContexts, double *renderTimes);
+
+    /** Forgets the worker assignment of the given context, e.g. before it is deleted. */
+    void removeContext(ZGContext *context);
+
+    unsigned int getNumThreads() { return workers.size(); }
+
+  private:
+    typedef struct ContextLoad {
+      unsigned int worker;
+      /** The smoothed render time of the context, in seconds. An estimate until it is measured. */
+      double renderTime;
+      bool isMeasured;
+    } ContextLoad;
+
+    typedef struct Worker {
+      ContextBatch *batch;
+      unsigned int index;
+      pthread_t thread;
+      /** Indicies into the arrays of the current call which this worker should process. */
+      vector<unsigned int> jobs;
+      /** The load of the context of each job. Only this worker updates them during a call. */
+      vector<ContextLoad *> jobLoads;
+      /** The sum of the smoothed render times of all contexts assigned to this worker, in seconds. */
+      double load;
+    } Worker;
+
+    static void *workerThread(void *arg);
+    void runWorker(Worker *worker);
+
+    /** Returns the load of the given context, assigning it to a worker if necessary. */
+    ContextLoad *getContextLoad(ZGContext *context);
+
+    /** Recomputes the load of each worker from the contexts assigned to it. */
+    void updateWorkerLoads();
+
+    vector<Worker *> workers;
+
+    /** The worker assignment and render time of each known context. */
+    map<ZGContext *, ContextLoad> contextLoads;
+
+    // the arguments of the current call to process()
+    ZGContext **contexts;
+    float **inputBuffers;
+    float **outputBuffers;
+    double *renderTimes;
+
+    unsigned int numWorkersRemaining;
+    unsigned int batchIndex;
+    bool isRunning;
+    pthread_mutex_t batchLock;
+    pthread_cond_t batchStartCondition;
+    pthread_cond_t batchDoneCondition;
+};
+
+#endif // _CONTEXT_BATCH_H_
@@ -21,6 +21,7 @@
  */
 
 #include "DelayReceiver.h"
+#include "DspDelayWrite.h"
 
 DelayReceiver::DelayReceiver(int numMessageInlets, int numDspInlets, int numMessageOutlets, int numDspOutlets, PdGraph *graph) : 
     DspObject(numMessageInlets, numDspInlets, numMessageOutlets, numDspOutlets, graph) {
@@ -39,3 +40,7 @@ const char *DelayReceiver::get_name() {
 void DelayReceiver::set_delay_line(DspDelayWrite *delayline) {
   this->delayline = delayline;
 }
+
+bool DelayReceiver::isSilentBlock(unsigned int silentInletMask) {
+  return (delayline != NULL) && delayline->hasTailDecayed();
+}
@@ -42,6 +42,13 @@ class DelayReceiver : public DspObject {
   
     const char *get_name();
     void set_delay_line(DspDelayWrite *delayline);
+
+    /** Reads from a delay line shared with a delwrite~. */
+    bool isParallelSafe() { return false; }
+
+    /** Only silence can be read from a delay line which contains only zeros. */
+    bool canPropagateSilence() { return true; }
+    bool isSilentBlock(unsigned int silentInletMask);
     
   protected:
     char *name;
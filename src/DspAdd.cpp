@@ -31,7 +31,7 @@ message::Object *DspAdd::new_object(pd::Message *init_message, PdGraph *graph) {
 
 DspAdd::DspAdd(pd::Message *init_message, PdGraph *graph) : DspObject(2, 2, 0, 1, graph) {
   constant = init_message->is_float(0) ? init_message->get_float(0) : 0.0f;
-  process_functionNoMessage = &processScalar;
+  updateProcessFunction();
 }
 
 DspAdd::~DspAdd() {
@@ -39,8 +39,23 @@ DspAdd::~DspAdd() {
 }
 
 void DspAdd::onInletConnectionUpdate(unsigned int inlet_index) {
-  process_function = (incomingDspConnections[0].size() > 0 && incomingDspConnections[1].size() > 0)
-      ? &processSignal : &processScalar;
+  updateProcessFunction();
+}
+
+void DspAdd::onBlockSizeUpdate(int block_size) {
+  DspObject::onBlockSizeUpdate(block_size);
+  updateProcessFunction();
+}
+
+void DspAdd::updateProcessFunction() {
+  // because this can only be called at block boundaries, it is guaranteed that no messages will
+  // be in the message queue.
+  if (incomingDspConnections[0].size() > 0 && incomingDspConnections[1].size() > 0) {
+    process_function = DSP_SELECT_BLOCK_FUNCTION(processSignalBlock, block_sizeInt, processSignal);
+  } else {
+    process_function = DSP_SELECT_BLOCK_FUNCTION(processScalarBlock, block_sizeInt, processScalar);
+  }
+  process_functionNoMessage = process_function;
 }
 
 std::string DspAdd::toString() {
@@ -50,6 +65,14 @@ std::string DspAdd::toString() {
   return str;
 }
 
+bool DspAdd::isSilentBlock(unsigned int silentInletMask) {
+  if (incomingDspConnections[0].size() > 0 && incomingDspConnections[1].size() > 0) {
+    return (silentInletMask & 0x3) == 0x3;
+  } else {
+    return (silentInletMask & 0x1) && (constant == 0.0f);
+  }
+}
+
 void DspAdd::process_message(int inlet_index, pd::Message *message) {
   if (inlet_index == 1 && message->is_float(0)) {
     constant = message->get_float(0);
@@ -65,5 +88,25 @@ void DspAdd::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
 void DspAdd::processScalar(DspObject *dspObject, int fromIndex, int toIndex) {
   DspAdd *d = reinterpret_cast<DspAdd *>(dspObject);
   ArrayArithmetic::add(d->dspBufferAtInlet[0] , d->constant,
-      d->dspBufferAtOutlet[0], fromIndex, fromIndex);
+      d->dspBufferAtOutlet[0], fromIndex, toIndex);
+}
+
+template <int N>
+void DspAdd::processSignalBlock(DspObject *dspObject, int fromIndex, int toIndex) {
+  if (fromIndex == 0 && toIndex == N) {
+    DspAdd *d = reinterpret_cast<DspAdd *>(dspObject);
+    ArrayArithmetic::addBlock<N>(d->dspBufferAtInlet[0], d->dspBufferAtInlet[1], d->dspBufferAtOutlet[0]);
+  } else {
+    processSignal(dspObject, fromIndex, toIndex);
+  }
+}
+
+template <int N>
+void DspAdd::processScalarBlock(DspObject *dspObject, int fromIndex, int toIndex) {
+  if (fromIndex == 0 && toIndex == N) {
+    DspAdd *d = reinterpret_cast<DspAdd *>(dspObject);
+    ArrayArithmetic::addBlock<N>(d->dspBufferAtInlet[0], d->constant, d->dspBufferAtOutlet[0]);
+  } else {
+    processScalar(dspObject, fromIndex, toIndex);
+  }
 }
@@ -37,10 +37,18 @@ class DspAdd : public DspObject {
     std::string toString();
   
     void onInletConnectionUpdate(unsigned int inlet_index);
+    void onBlockSizeUpdate(int block_size);
+
+    bool canProcessInPlace() { return true; }
+    bool canPropagateSilence() { return true; }
+    bool isSilentBlock(unsigned int silentInletMask);
     
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
     static void processScalar(DspObject *dspObject, int fromIndex, int toIndex);
+    template <int N> static void processSignalBlock(DspObject *dspObject, int fromIndex, int toIndex);
+    template <int N> static void processScalarBlock(DspObject *dspObject, int fromIndex, int toIndex);
+    void updateProcessFunction();
     void process_message(int inlet_index, PdMessage *message);
   
     float constant;
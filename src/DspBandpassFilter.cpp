@@ -46,6 +46,7 @@ void DspBandpassFilter::calcFiltCoeff(float fc, float q) {
   float wc = 2.0f*M_PI*fc/graph->get_sample_rate();
   float alpha = sinf(wc)/(2.0f*q);
 
+  float *b = getState()->b;
   b[0] = alpha/(1.0f+alpha);
   b[1] = 0.0f;
   b[2] = -alpha/(1.0f+alpha);
@@ -57,7 +58,7 @@ void DspBandpassFilter::process_message(int inlet_index, pd::Message *message) {
   switch (inlet_index) {
     case 0: {
       if (message->is_symbol_str(0, "clear")) {
-        x1 = x2 = dspBufferAtOutlet[0][0] = dspBufferAtOutlet[0][1] = 0.0f;
+        getState()->history[0] = getState()->history[1] = dspBufferAtOutlet[0][0] = dspBufferAtOutlet[0][1] = 0.0f;
       }
       break;
     }
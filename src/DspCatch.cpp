@@ -39,13 +39,37 @@ DspCatch::DspCatch(pd::Message *init_message, PdGraph *graph) : DspObject(0, 0,
     name = NULL;
     graph->print_err("catch~ must be initialised with a name.");
   }
-  process_function = &processNone;
+  dspBufferAtOutlet[0] = graph->get_buffer_pool()->getArena()->allocate(graph->get_block_size() * sizeof(float));
+  lateBuffer = graph->get_buffer_pool()->getArena()->allocate(graph->get_block_size() * sizeof(float));
+  isAccumulating = false;
+  accumulationTimestamp = 0.0;
+  hasLateInput = false;
+  processTimestamp = -1.0;
+  isOrderingThrows = false;
+  isThrowInFeedback = false;
+  process_function = &processSignal;
 }
 
 DspCatch::~DspCatch() {
+  for (list<DspThrow *>::iterator it = throw_list.begin(); it != throw_list.end(); ++it) {
+    (*it)->setCatch(NULL);
+  }
+  graph->get_buffer_pool()->getArena()->release(dspBufferAtOutlet[0], block_sizeInt * sizeof(float));
+  graph->get_buffer_pool()->getArena()->release(lateBuffer, block_sizeInt * sizeof(float));
   free(name);
 }
 
+void DspCatch::onBlockSizeUpdate(int block_size) {
+  BufferArena *arena = graph->get_buffer_pool()->getArena();
+  arena->release(dspBufferAtOutlet[0], block_sizeInt * sizeof(float));
+  arena->release(lateBuffer, block_sizeInt * sizeof(float));
+  dspBufferAtOutlet[0] = arena->allocate(block_size * sizeof(float));
+  lateBuffer = arena->allocate(block_size * sizeof(float));
+  isAccumulating = false;
+  hasLateInput = false;
+  DspObject::onBlockSizeUpdate(block_size);
+}
+
 string DspCatch::toString() {
   char str[snprintf(NULL, 0, "%s %s", get_object_label(), name)+1];
   snprintf(str, sizeof(str), "%s %s", get_object_label(), name);
@@ -55,76 +79,106 @@ string DspCatch::toString() {
 void DspCatch::add_throw(DspThrow *dspThrow) {
   if (!strcmp(dspThrow->get_name(), name)) { // make sure that the throw~ really does match this catch~
     throw_list.push_back(dspThrow); // NOTE(mhroth): no dupicate detection
-    
-    // update the process function
-    switch (throw_list.size()) {
-      case 0: process_function = &processNone; break;
-      case 1: process_function = &processOne; break;
-      default: process_function = &processMany; break;
-    }
+    dspThrow->setCatch(this);
   }
 }
 
 void DspCatch::removeThrow(DspThrow *dspThrow) {
   if (!strcmp(dspThrow->get_name(), name)) {
     throw_list.remove(dspThrow);
-    
-    switch (throw_list.size()) {
-      case 0: process_function = &processNone; break;
-      case 1: process_function = &processOne; break;
-      default: process_function = &processMany; break;
-    }
+    dspThrow->setCatch(NULL);
   }
 }
 
-void DspCatch::processNone(DspObject *dspObject, int fromIndex, int toIndex) {
-  DspCatch *d = reinterpret_cast<DspCatch *>(dspObject);
-  memset(d->dspBufferAtOutlet[0], 0, toIndex*sizeof(float));
+bool DspCatch::hasInput() {
+  return isAccumulating && accumulationTimestamp == graph->getContext()->get_block_start_timestamp();
 }
 
-void DspCatch::processOne(DspObject *dspObject, int fromIndex, int toIndex) {
-  DspCatch *d = reinterpret_cast<DspCatch *>(dspObject);
-  DspThrow *dspThrow = d->throw_list.front();
-  memcpy(d->dspBufferAtOutlet[0], dspThrow->getBuffer(), toIndex*sizeof(float));
+bool DspCatch::isSilentBlock(unsigned int silentInletMask) {
+  if (hasInput() || hasLateInput) return false;
+  // the catch~ is skipped, but a throw~ which runs after it must still add to the next block
+  processTimestamp = graph->getContext()->get_block_start_timestamp();
+  return true;
 }
 
-// process at least two throw~s
-void DspCatch::processMany(DspObject *dspObject, int fromIndex, int toIndex) {
+void DspCatch::accumulate(float *input, int fromIndex, int toIndex) {
+  double blockTimestamp = graph->getContext()->get_block_start_timestamp();
+  if (processTimestamp == blockTimestamp) {
+    // The catch~ has already run in this block. The sum is kept until it runs again, however long
+    // that is, as a throw~ in a switched or reblocked subgraph need not run in every block.
+    if (hasLateInput) {
+      ArrayArithmetic::add(lateBuffer, input, lateBuffer, fromIndex, toIndex);
+    } else {
+      memcpy(lateBuffer+fromIndex, input+fromIndex, (toIndex-fromIndex)*sizeof(float));
+      if (toIndex == block_sizeInt) hasLateInput = true;
+    }
+  } else if (hasInput()) {
+    ArrayArithmetic::add(dspBufferAtOutlet[0], input, dspBufferAtOutlet[0], fromIndex, toIndex);
+  } else {
+    // the first throw~ in this block. It may write its block in several parts if it has messages.
+    memcpy(dspBufferAtOutlet[0]+fromIndex, input+fromIndex, (toIndex-fromIndex)*sizeof(float));
+    if (toIndex == block_sizeInt) {
+      isAccumulating = true;
+      accumulationTimestamp = blockTimestamp;
+    }
+  }
+}
+
+void DspCatch::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
   DspCatch *d = reinterpret_cast<DspCatch *>(dspObject);
-  list<DspThrow *>::iterator it = d->throw_list.begin();
-  ArrayArithmetic::add((*it++)->getBuffer(), (*it++)->getBuffer(), d->dspBufferAtOutlet[0], 0, toIndex);
-  while (it != d->throw_list.end()) {
-    ArrayArithmetic::add(d->dspBufferAtOutlet[0], (*it++)->getBuffer(), d->dspBufferAtOutlet[0],
-        0, toIndex);
-  };
+  float *output = d->dspBufferAtOutlet[0];
+  // the late sum is copied rather than swapped in, as the outlet buffer is read by other objects
+  if (d->hasLateInput) {
+    if (d->hasInput()) {
+      ArrayArithmetic::add(output, d->lateBuffer, output, 0, toIndex);
+    } else {
+      memcpy(output, d->lateBuffer, toIndex*sizeof(float));
+    }
+    d->hasLateInput = false;
+  } else if (!d->hasInput()) {
+    memset(output, 0, toIndex*sizeof(float));
+  }
+  d->isAccumulating = false; // the next throw~ begins the sum of the next block
+  d->processTimestamp = d->graph->getContext()->get_block_start_timestamp();
 }
 
 // catch objects should be processed after their corresponding throw object even though
 // there is no connection between them
 list<DspObject *> DspCatch::get_process_order() {
   if (is_ordered) {
-    // if this object has already been ordered, then move on
+    // if this object has already been ordered, then move on. If its throw~s are being ordered,
+    // then the current one is fed by this catch~.
+    if (isOrderingThrows) isThrowInFeedback = true;
     return list<DspObject *>();
   } else {
     is_ordered = true;
     list<DspObject *> processList;
+    list<DspObject *> lateProcessList;
     
+    isOrderingThrows = true;
     for (std::list<DspThrow *>::iterator throwIt = throw_list.begin(); throwIt != throw_list.end(); ++throwIt) {
+      isThrowInFeedback = false;
       list<DspObject *> parentProcessList = (*throwIt)->get_process_order();
-      // combine the process lists
-      processList.splice(processList.end(), parentProcessList);
+      // combine the process lists. A throw~ which is fed by this catch~ (and everything between
+      // them) must follow it, such that its signal arrives in the next block as in Pd.
+      if (isThrowInFeedback) {
+        lateProcessList.splice(lateProcessList.end(), parentProcessList);
+      } else {
+        processList.splice(processList.end(), parentProcessList);
+      }
     }
+    isOrderingThrows = false;
     
     // set the outlet buffers
     for (int i = 0; i < getNumDspOutlets(); i++) {
       if (canSetBufferAtOutlet(i)) {
-        float *buffer = graph->getContext()->get_buffer_pool()->getBuffer(outgoingDspConnections[i].size());
+        float *buffer = graph->get_buffer_pool()->getBuffer(outgoingDspConnections[i].size());
         setDspBufferAtOutlet(buffer, i);
       }
     }
     
     processList.push_back(this);
+    processList.splice(processList.end(), lateProcessList);
     return processList;
   }
 }
-
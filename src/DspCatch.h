@@ -29,7 +29,11 @@ class DspThrow;
 
 /**
  * [catch~ symbol]
- * Implements the receiver of a many-to-one audio connection.
+ * Implements the receiver of a many-to-one audio connection. The catch~ owns its outlet buffer,
+ * into which all of its throw~s (ordered before it) add their input directly. The first throw~ in
+ * each block stores its input instead. A throw~ which runs after the catch~ in a block (e.g. one
+ * which is fed by the catch~, or which is in another graph) adds to a second buffer, which is
+ * output in the next block. As in Pd, its signal arrives one block late.
  */
 class DspCatch : public DspObject {
   
@@ -42,19 +46,60 @@ class DspCatch : public DspObject {
   
     void add_throw(DspThrow *dspThrow);
     void removeThrow(DspThrow *dspThrow);
+
+    /**
+     * Adds the given signal of a throw~ to the outlet buffer, between the given indices. If the
+     * catch~ has already run in this block, it is added to the sum of the next block instead.
+     */
+    void accumulate(float *input, int fromIndex, int toIndex);
+
+    /** The outlet buffer belongs to the catch~, as it is written by throw~s before the catch~ runs. */
+    bool canSetBufferAtOutlet(unsigned int outlet_index) { return false; }
+
+    void onBlockSizeUpdate(int block_size);
   
     const char *get_name() { return name; }
     static const char *get_object_label() { return "catch~"; }
     object::Type get_object_type() { return DSP_CATCH; }
     string toString();
+
+    /** Its buffer is written by all associated throw~ objects. */
+    bool isParallelSafe() { return false; }
+
+    /** The catch~ is silent if none of its throw~s have run (e.g. because they are silent). */
+    bool canPropagateSilence() { return true; }
+    bool isSilentBlock(unsigned int silentInletMask);
   
   private:
-    static void processNone(DspObject *dspObject, int fromIndex, int toIndex);
-    static void processOne(DspObject *dspObject, int fromIndex, int toIndex);
-    static void processMany(DspObject *dspObject, int fromIndex, int toIndex);
+    static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
+
+    /**
+     * Returns true if a throw~ has written to the buffer in the current block. A sum which was
+     * left over from an earlier block (e.g. while the catch~ was switched off) is discarded.
+     */
+    bool hasInput();
     
     char *name;
     list<DspThrow *> throw_list; // list of associated throw~ objects
+
+    /** Set once a throw~ has written a whole block to the buffer. Cleared when the catch~ runs. */
+    bool isAccumulating;
+
+    /** The start of the block in which the current sum was begun. */
+    double accumulationTimestamp;
+
+    /** The sum of the throw~s which ran after the catch~ in the last block in which it ran. */
+    float *lateBuffer;
+
+    /** Set once a late throw~ has written a whole block. Cleared when the sum is output. */
+    bool hasLateInput;
+
+    /** The start of the block in which the catch~ last ran (or was skipped as silent). */
+    double processTimestamp;
+
+    /** Set while the throw~s are ordered, and while a throw~ is found to be fed by the catch~. */
+    bool isOrderingThrows;
+    bool isThrowInFeedback;
 };
 
 #endif // _DSP_CATCH_H_
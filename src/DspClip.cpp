@@ -56,20 +56,6 @@ void DspClip::process_message(int inlet_index, pd::Message *message) {
 
 void DspClip::processScalar(DspObject *dspObject, int fromIndex, int toIndex) {
   DspClip *d = reinterpret_cast<DspClip *>(dspObject);
-  #if __APPLE__
-  vDSP_vclip(d->dspBufferAtInlet[0]+fromIndex, 1, &(d->lowerBound), &(d->upperBound),
-      d->dspBufferAtOutlet[0]+fromIndex, 1, toIndex-fromIndex);
-  #else
-  float *in = d->dspBufferAtInlet[0];
-  float *out = d->dspBufferAtOutlet[0];
-  for (int i = fromIndex; i < toIndex; i++) {
-    if (in[i] < d->lowerBound) {
-      out[i] = d->lowerBound;
-    } else if (in[i] > d->upperBound) {
-      out[i] = d->upperBound;
-    } else {
-      out[i] = in[i];
-    }
-  }
-  #endif
+  ArrayArithmetic::clip(d->dspBufferAtInlet[0], d->lowerBound, d->upperBound, d->dspBufferAtOutlet[0],
+      fromIndex, toIndex);
 }
@@ -35,6 +35,8 @@ class DspClip : public DspObject {
     static const char *get_object_label();
     std::string toString();
 
+    bool canProcessInPlace() { return true; }
+
   private:
    static void processScalar(DspObject *dspObject, int fromIndex, int toIndex);
    void process_message(int inlet_index, PdMessage *message);
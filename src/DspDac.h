@@ -34,6 +34,12 @@ class DspDac : public DspObject {
   
     static const char *get_object_label();
     std::string toString();
+
+    /** Accumulates into the global output buffers. */
+    bool isParallelSafe() { return false; }
+
+    /** Adding silence to the output buffers changes nothing. */
+    bool canPropagateSilence() { return true; }
   
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
@@ -21,6 +21,7 @@
  */
 
 #include "ArrayArithmetic.h"
+#include "BufferPool.h"
 #include "DspDelayWrite.h"
 #include "PdGraph.h"
 
@@ -39,9 +40,8 @@ DspDelayWrite::DspDelayWrite(pd::Message *init_message, PdGraph *graph) : DspObj
     }
     headIndex = 0;
     // buffer[bufferLength] == buffer[0], which makes calculation in vd~ easier
-    int numBufferLengthBytes = (bufferLength+1)*sizeof(float);
-    dspBufferAtOutlet[0] = ALLOC_ALIGNED_BUFFER(numBufferLengthBytes);
-    memset(dspBufferAtOutlet[0], 0, numBufferLengthBytes); // zero the delay buffer
+    // the arena returns zeroed buffers
+    dspBufferAtOutlet[0] = graph->get_buffer_pool()->getArena()->allocate((bufferLength+1)*sizeof(float));
     name = utils::copy_string(init_message->get_symbol(0));
   } else {
     graph->print_err("ERROR: delwrite~ must be initialised as [delwrite~ name delay].");
@@ -49,13 +49,39 @@ DspDelayWrite::DspDelayWrite(pd::Message *init_message, PdGraph *graph) : DspObj
     bufferLength = 0;
     name = NULL;
   }
+  numSilentSamples = bufferLength; // the delay line starts out zeroed
+  isInputSilent = false;
   process_function = &processSignal;
 }
 
 DspDelayWrite::~DspDelayWrite() {
-  free(name);
-  FREE_ALIGNED_BUFFER(dspBufferAtOutlet[0]);
+  if (name != NULL) {
+    graph->get_buffer_pool()->getArena()->release(dspBufferAtOutlet[0], (bufferLength+1)*sizeof(float));
+  }
   dspBufferAtOutlet[0] = NULL;
+  free(name);
+}
+
+void DspDelayWrite::onBlockSizeUpdate(int block_size) {
+  DspObject::onBlockSizeUpdate(block_size);
+  if (name == NULL) return;
+
+  // the buffer length must remain a multiple of the block size, as whole blocks are written
+  int newBufferLength = ((bufferLength-1)/block_size + 1) * block_size;
+  if (newBufferLength == bufferLength) return;
+  BufferArena *arena = graph->get_buffer_pool()->getArena();
+  arena->release(dspBufferAtOutlet[0], (bufferLength+1)*sizeof(float));
+  bufferLength = newBufferLength;
+  headIndex = 0;
+  dspBufferAtOutlet[0] = arena->allocate((bufferLength+1)*sizeof(float));
+  numSilentSamples = bufferLength;
+}
+
+bool DspDelayWrite::isSilentBlock(unsigned int silentInletMask) {
+  if (!(silentInletMask & 0x1)) return false;
+  if (hasTailDecayed()) return true;
+  isInputSilent = true; // the zeros must still be written until the whole delay line is silent
+  return false;
 }
 
 void DspDelayWrite::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
@@ -66,4 +92,6 @@ void DspDelayWrite::processSignal(DspObject *dspObject, int fromIndex, int toInd
   if (d->headIndex == 0) d->dspBufferAtOutlet[0][d->bufferLength] = d->dspBufferAtOutlet[0][0];
   d->headIndex += toIndex;
   if (d->headIndex >= d->bufferLength) d->headIndex = 0;
+  d->numSilentSamples = d->isInputSilent ? (d->numSilentSamples + toIndex) : 0;
+  d->isInputSilent = false;
 }
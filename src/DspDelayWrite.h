@@ -37,6 +37,19 @@ class DspDelayWrite : public DspObject {
     object::Type get_object_type();
   
     const char *get_name();
+
+    void onBlockSizeUpdate(int block_size);
+
+    /** The delay line is shared with delread~ and vd~ objects. */
+    bool isParallelSafe() { return false; }
+
+    /**
+     * The delay line need not be written once it contains only zeros. It is then silent until its
+     * input is not.
+     */
+    bool canPropagateSilence() { return true; }
+    bool isSilentBlock(unsigned int silentInletMask);
+    bool hasTailDecayed() { return (numSilentSamples >= bufferLength); }
   
     inline float *getBuffer(int *index, int *length) {
       *index = headIndex;
@@ -50,6 +63,12 @@ class DspDelayWrite : public DspObject {
     char *name;
     int bufferLength;
     int headIndex;
+
+    /** The number of consecutive zeros most recently written to the delay line. */
+    int numSilentSamples;
+
+    /** Set if the block which is about to be written is silent. */
+    bool isInputSilent;
 };
 
 inline std::string DspDelayWrite::toString()  {
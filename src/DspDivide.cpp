@@ -30,8 +30,7 @@ message::Object *DspDivide::new_object(pd::Message *init_message, PdGraph *graph
 
 DspDivide::DspDivide(pd::Message *init_message, PdGraph *graph) : DspObject(2, 2, 0, 1, graph) {
   constant = init_message->is_float(0) ? init_message->get_float(0) : 0.0f;
-  process_function = &processScalar;
-  process_functionNoMessage = &processScalar;
+  updateProcessFunction();
 }
 
 DspDivide::~DspDivide() {
@@ -39,8 +38,23 @@ DspDivide::~DspDivide() {
 }
 
 void DspDivide::onInletConnectionUpdate(unsigned int inlet_index) {
-  process_function = (incomingDspConnections[0].size() > 0 && incomingDspConnections[1].size() > 0)
-      ? &processSignal : &processScalar;
+  updateProcessFunction();
+}
+
+void DspDivide::onBlockSizeUpdate(int block_size) {
+  DspObject::onBlockSizeUpdate(block_size);
+  updateProcessFunction();
+}
+
+void DspDivide::updateProcessFunction() {
+  // because this can only be called at block boundaries, it is guaranteed that no messages will
+  // be in the message queue.
+  if (incomingDspConnections[0].size() > 0 && incomingDspConnections[1].size() > 0) {
+    process_function = DSP_SELECT_BLOCK_FUNCTION(processSignalBlock, block_sizeInt, processSignal);
+  } else {
+    process_function = DSP_SELECT_BLOCK_FUNCTION(processScalarBlock, block_sizeInt, processScalar);
+  }
+  process_functionNoMessage = process_function;
 }
 
 string DspDivide::toString() {
@@ -73,3 +87,23 @@ void DspDivide::processScalar(DspObject *dspObject, int fromIndex, int toIndex)
   DspDivide *d = reinterpret_cast<DspDivide *>(dspObject);
   ArrayArithmetic::divide(d->dspBufferAtInlet[0], d->constant, d->dspBufferAtOutlet[0], fromIndex, toIndex);
 }
+
+template <int N>
+void DspDivide::processSignalBlock(DspObject *dspObject, int fromIndex, int toIndex) {
+  if (fromIndex == 0 && toIndex == N) {
+    DspDivide *d = reinterpret_cast<DspDivide *>(dspObject);
+    ArrayArithmetic::divideBlock<N>(d->dspBufferAtInlet[0], d->dspBufferAtInlet[1], d->dspBufferAtOutlet[0]);
+  } else {
+    processSignal(dspObject, fromIndex, toIndex);
+  }
+}
+
+template <int N>
+void DspDivide::processScalarBlock(DspObject *dspObject, int fromIndex, int toIndex) {
+  if (fromIndex == 0 && toIndex == N) {
+    DspDivide *d = reinterpret_cast<DspDivide *>(dspObject);
+    ArrayArithmetic::divideBlock<N>(d->dspBufferAtInlet[0], d->constant, d->dspBufferAtOutlet[0]);
+  } else {
+    processScalar(dspObject, fromIndex, toIndex);
+  }
+}
@@ -80,6 +80,16 @@ string DspEnvelope::toString() {
   return string(str);
 }
 
+void DspEnvelope::onBlockSizeUpdate(int block_size) {
+  DspObject::onBlockSizeUpdate(block_size);
+  // the window size and interval are constrained by the block size, as in the constructor
+  if (windowSize < block_size) windowSize = block_size;
+  setWindowInterval((windowInterval < block_size) ? block_size : windowInterval);
+  free(signalBuffer);
+  free(hanningCoefficients);
+  initBuffers();
+}
+
 void DspEnvelope::setWindowInterval(int newInterval) {
   int i = newInterval % graph->get_block_size();
   if (i == 0) {
@@ -129,17 +139,7 @@ void DspEnvelope::processSignal(DspObject *dspObject, int fromIndex, int toIndex
   if (d->numSamplesReceivedSinceLastInterval == d->windowInterval) {
     d->numSamplesReceivedSinceLastInterval -= d->windowInterval;
     // apply hanning window to signal and calculate Root Mean Square
-    float rms = 0.0f;
-    #if __APPLE__
-    float rmsBuffer[d->windowSize];
-    vDSP_vsq(d->signalBuffer, 1, rmsBuffer, 1, d->windowSize); // signalBuffer^2 
-    vDSP_vmul(rmsBuffer, 1, d->hanningCoefficients, 1, rmsBuffer, 1, d->windowSize); // * hanning window
-    vDSP_sve(rmsBuffer, 1, &rms, d->windowSize); // sum the result
-    #else
-    for (int i = 0; i < d->windowSize; ++i) {
-      rms += d->signalBuffer[i] * d->signalBuffer[i] * d->hanningCoefficients[i];
-    }
-    #endif
+    float rms = ArrayArithmetic::sumOfSquares(d->signalBuffer, d->hanningCoefficients, 0, d->windowSize);
     // finish RMS calculation. sqrt is removed as it can be combined with the log operation.
     // result is normalised such that 1 RMS == 100 dB
     rms = 10.0f * log10f(rms) + 100.0f;
@@ -45,6 +45,8 @@ class DspEnvelope : public DspObject {
 
     connection::Type get_connection_type(int outlet_index) { return MESSAGE; }
 
+    void onBlockSizeUpdate(int block_size);
+
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
 
@@ -26,10 +26,11 @@
 class PdGraph;
 
 DspFilter::DspFilter(int numMessageInlets, PdGraph *graph) : DspObject(numMessageInlets, 1, 0, 1, graph) {
-  x1 = x2 = y1 = y2 = 0.0f;
+  allocateHotState(sizeof(DspFilterState)); // zeroed
 
   process_function = &processFilter;
   process_functionNoMessage = &processFilter;
+  process_functionBatch = &processFilterBatch;
 }
 
 DspFilter::~DspFilter() {
@@ -40,30 +41,34 @@ void DspFilter::onInletConnectionUpdate(unsigned int inlet_index) {
   // TODO(mhroth)
 }
 
+bool DspFilter::hasTailDecayed() {
+  DspFilterState *state = getState();
+  float *history = state->history;
+  if (fabsf(history[0]) < DSP_SILENCE_THRESHOLD && fabsf(history[1]) < DSP_SILENCE_THRESHOLD &&
+      fabsf(history[2]) < DSP_SILENCE_THRESHOLD && fabsf(history[3]) < DSP_SILENCE_THRESHOLD) {
+    // such that the filter resumes exactly from silence
+    history[0] = history[1] = history[2] = history[3] = 0.0f;
+    return true;
+  }
+  return false;
+}
+
 void DspFilter::processFilter(DspObject *dspObject, int fromIndex, int toIndex) {
   DspFilter *d = reinterpret_cast<DspFilter *>(dspObject);
-  
-  int n = toIndex - fromIndex; // number of samples to process
-  float bufferIn[n+2]; // new inlet buffer
-  bufferIn[0] = d->x2; bufferIn[1] = d->x1;
-  memcpy(bufferIn+2, d->dspBufferAtInlet[0]+fromIndex, n*sizeof(float));
-  
-  float bufferOut[n+2]; // new outlet buffer
-  bufferOut[0] = d->y2; bufferOut[1] = d->y1;
-  
-  #if __APPLE__
-  vDSP_deq22(bufferIn, 1, d->b, bufferOut, 1, n);
-  #else
-  int _toIndex = n + 2;
-  for (int i = 2; i < _toIndex; ++i) {
-    bufferOut[i] = d->b[0]*bufferIn[i] + d->b[1]*bufferIn[i-1] + d->b[2]*bufferIn[i-2] -
-        d->b[3]*bufferOut[i-1] - d->b[4]*bufferOut[i-2];
+  DspFilterState *state = d->getState();
+  BiquadFilter filter = {state->b, state->history,
+      d->dspBufferAtInlet[0], d->dspBufferAtOutlet[0]};
+  BiquadEngine::process(&filter, fromIndex, toIndex);
+}
+
+void DspFilter::processFilterBatch(DspObject **dspObjects, int numObjects, int fromIndex, int toIndex) {
+  BiquadFilter filters[numObjects];
+  for (int i = 0; i < numObjects; i++) {
+    DspFilter *d = reinterpret_cast<DspFilter *>(dspObjects[i]);
+    DspFilterState *state = d->getState();
+    BiquadFilter filter = {state->b, state->history,
+        d->dspBufferAtInlet[0], d->dspBufferAtOutlet[0]};
+    filters[i] = filter;
   }
-  #endif
-  
-  memcpy(d->dspBufferAtOutlet[0]+fromIndex, bufferOut+2, n*sizeof(float));
-  
-  // retain state
-  d->x2 = bufferIn[n]; d->x1 = bufferIn[n+1];
-  d->y2 = bufferOut[n]; d->y1 = bufferOut[n+1];
+  BiquadEngine::processParallel(filters, numObjects, fromIndex, toIndex);
 }
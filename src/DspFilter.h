@@ -23,8 +23,15 @@
 #ifndef _DSP_FILTER_H_
 #define _DSP_FILTER_H_
 
+#include "BiquadEngine.h"
 #include "DspObject.h"
 
+/** The taps and coefficients of a <code>DspFilter</code>, kept as the hot state of the object. */
+typedef struct DspFilterState {
+  float history[4]; // x[n-1], x[n-2], y[n-1], y[n-2], as kept by ArrayArithmetic::biquad()
+  float b[5]; // filter coefficients
+} DspFilterState;
+
 /** The superclass of lop~, hip~, bp~, and biquad~ */
 class DspFilter : public DspObject {
   
@@ -33,12 +40,15 @@ class DspFilter : public DspObject {
     ~DspFilter();
 
     void onInletConnectionUpdate(unsigned int inlet_index);
+
+    bool canPropagateSilence() { return true; }
+    bool hasTailDecayed();
   
   protected:  
     static void processFilter(DspObject *dspObject, int fromIndex, int toIndex);
-    
-    float x1, x2, y1, y2;
-    float b[5]; // filter coefficients
+    static void processFilterBatch(DspObject **dspObjects, int numObjects, int fromIndex, int toIndex);
+
+    DspFilterState *getState() { return reinterpret_cast<DspFilterState *>(hotState); }
 };
 
 #endif // _DSP_FILTER_H_
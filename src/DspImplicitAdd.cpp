@@ -27,15 +27,23 @@ message::Object *DspImplicitAdd::new_object(pd::Message *init_message, PdGraph *
   return new DspImplicitAdd(init_message, graph);
 }
 
-DspImplicitAdd::DspImplicitAdd(pd::Message *init_message, PdGraph *graph) : DspObject(0, 2, 0, 1, graph) {
+DspImplicitAdd::DspImplicitAdd(pd::Message *init_message, PdGraph *graph) : DspObject(0,
+    (init_message->is_float(0) && init_message->get_float(0) > 2.0f) ? (int) init_message->get_float(0) : 2,
+    0, 1, graph) {
+  inputBuffers = (float **) calloc(getNumDspInlets(), sizeof(float *));
   process_function = &processSignal;
 }
 
 DspImplicitAdd::~DspImplicitAdd() {
-  // nothing to do
+  free(inputBuffers);
+}
+
+void DspImplicitAdd::set_dsp_buffer_at_inlet(float *buffer, unsigned int inlet_index) {
+  DspObject::set_dsp_buffer_at_inlet(buffer, inlet_index);
+  inputBuffers[inlet_index] = buffer;
 }
 
 void DspImplicitAdd::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
   DspImplicitAdd *d = reinterpret_cast<DspImplicitAdd *>(dspObject);
-  ArrayArithmetic::add(d->dspBufferAtInlet[0], d->dspBufferAtInlet[1], d->dspBufferAtOutlet[0], 0, toIndex);
+  ArrayArithmetic::addMany(d->inputBuffers, d->getNumDspInlets(), d->dspBufferAtOutlet[0], 0, toIndex);
 }
@@ -26,8 +26,10 @@
 #include "DspObject.h"
 
 /**
- * This object is a stripped down version of DspAdd used soley for the purposes of summing two
- * DSP vectors together as a a part of the implicit add step.
+ * This object is a stripped down version of DspAdd used soley for the purposes of summing all of
+ * the DSP vectors connected to one inlet as a part of the implicit add step. The number of inputs
+ * (at least two) is given by the first element of the init message. They are summed in a single
+ * pass with <code>ArrayArithmetic::addMany()</code>.
  */
 class DspImplicitAdd : public DspObject {
   
@@ -38,9 +40,18 @@ public:
   
   static const char *get_object_label();
   std::string toString();
+
+  void set_dsp_buffer_at_inlet(float *buffer, unsigned int inlet_index);
+
+  /** <code>ArrayArithmetic::addMany()</code> reads an input which is also the output first. */
+  bool canProcessInPlace() { return true; }
+  bool canPropagateSilence() { return true; }
   
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
+
+    /** The buffers at all inlets, contiguously. */
+    float **inputBuffers;
 };
 
 inline const char *DspImplicitAdd::get_object_label() {
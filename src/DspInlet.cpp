@@ -30,11 +30,16 @@ message::Object *DspInlet::new_object(pd::Message *init_message, PdGraph *graph)
 }
 
 DspInlet::DspInlet(PdGraph *graph) : DspObject(0, 1, 0, 1, graph) {
-  // nothing to do
+  historyBuffer = NULL;
+  historyLength = 0;
+  blockBuffer = NULL;
+  parentBlockSize = block_sizeInt;
+  stepSize = block_sizeInt;
 }
 
 DspInlet::~DspInlet() {
-  // nothing to do
+  FREE_ALIGNED_BUFFER(historyBuffer);
+  FREE_ALIGNED_BUFFER(blockBuffer);
 }
 
 list<DspObject *> DspInlet::get_process_order() {
@@ -46,15 +51,33 @@ list<DspObject *> DspInlet::get_process_orderFromInlet() {
   return DspObject::get_process_order();
 }
 
+BufferPool *DspInlet::getInletBufferPool() {
+  // the incoming buffers belong to the parent graph, which may have another block size
+  return (blockBuffer == NULL) ? graph->get_buffer_pool() : graph->getParentGraph()->get_buffer_pool();
+}
+
 void DspInlet::set_dsp_buffer_at_inlet(float *buffer, unsigned int inlet_index) {
   DspObject::set_dsp_buffer_at_inlet(buffer, inlet_index);
+
+  if (blockBuffer != NULL) {
+    // The buffer is only read when the graph is processed, so it is held until the parent has
+    // resolved the buffers at all inlets (see releaseParentBuffer()). The local objects read the
+    // block buffer, which is owned by this inlet.
+    getInletBufferPool()->reserveBuffer(buffer, 1);
+    ConnectionSpan dspConnections = outgoingDspConnections[0];
+    for (ConnectionSpan::iterator it = dspConnections.begin(); it != dspConnections.end(); ++it) {
+      DspObject *dspObject = reinterpret_cast<DspObject *>((*it).first);
+      dspObject->set_dsp_buffer_at_inlet(blockBuffer, (*it).second);
+    }
+    return;
+  }
   
   // additionally reserve this buffer in order to account for outgoing connections
   graph->get_buffer_pool()->reserveBuffer(buffer, outgoingDspConnections[0].size());
   
   // when the dsp buffer updates at a given inlet, inform all receiving objects
-  for (list<Connection>::iterator it = outgoingDspConnections[0].begin();
-      it != outgoingDspConnections[0].end(); ++it) {
+  ConnectionSpan dspConnections = outgoingDspConnections[0];
+  for (ConnectionSpan::iterator it = dspConnections.begin(); it != dspConnections.end(); ++it) {
     Connection letPair = *it;
     DspObject *dspObject = reinterpret_cast<DspObject *>(letPair.first);
     dspObject->set_dsp_buffer_at_inlet(dspBufferAtInlet[0], letPair.second);
@@ -62,5 +85,44 @@ void DspInlet::set_dsp_buffer_at_inlet(float *buffer, unsigned int inlet_index)
 }
 
 float *DspInlet::get_dsp_buffer_at_outlet(int outlet_index) {
+  if (blockBuffer != NULL) return blockBuffer;
   return (dspBufferAtInlet[0] == NULL) ? graph->get_buffer_pool()->get_zero_buffer() : dspBufferAtInlet[0];
 }
+
+
+#pragma mark - Reblocking
+
+void DspInlet::setReblocking(bool isReblocked, int parentBlockSize, int stepSize) {
+  FREE_ALIGNED_BUFFER(historyBuffer);
+  FREE_ALIGNED_BUFFER(blockBuffer);
+  historyBuffer = NULL;
+  blockBuffer = NULL;
+  historyLength = 0;
+  this->parentBlockSize = parentBlockSize;
+  this->stepSize = stepSize;
+  if (!isReblocked) return;
+
+  // the earliest block ends one step into the parent block and begins block_sizeInt samples earlier
+  historyLength = block_sizeInt + parentBlockSize - stepSize;
+  historyBuffer = ALLOC_ALIGNED_BUFFER(historyLength * sizeof(float));
+  memset(historyBuffer, 0, historyLength * sizeof(float));
+  blockBuffer = ALLOC_ALIGNED_BUFFER(block_sizeInt * sizeof(float));
+  memset(blockBuffer, 0, block_sizeInt * sizeof(float));
+}
+
+void DspInlet::receiveParentBlock() {
+  float *parentBuffer = (dspBufferAtInlet[0] == NULL)
+      ? getInletBufferPool()->get_zero_buffer() : dspBufferAtInlet[0];
+  int numHistorySamples = historyLength - parentBlockSize;
+  memmove(historyBuffer, historyBuffer + parentBlockSize, numHistorySamples * sizeof(float));
+  memcpy(historyBuffer + numHistorySamples, parentBuffer, parentBlockSize * sizeof(float));
+}
+
+void DspInlet::prepareBlock(int stepIndex) {
+  int endIndex = historyLength - parentBlockSize + (stepIndex+1)*stepSize;
+  memcpy(blockBuffer, historyBuffer + endIndex - block_sizeInt, block_sizeInt * sizeof(float));
+}
+
+void DspInlet::releaseParentBuffer() {
+  getInletBufferPool()->releaseBuffer(dspBufferAtInlet[0]);
+}
@@ -51,7 +51,49 @@ class DspInlet : public DspObject {
   
     void set_dsp_buffer_at_inlet(float *buffer, unsigned int inlet_index);
     bool canSetBufferAtOutlet(unsigned int outlet_index);
+
+    /**
+     * Sets the buffer which is passed through without informing the connected objects, which
+     * already read it. Used by the <code>DspPlan</code> after it has moved the signal to another buffer.
+     */
+    void setPassThroughBuffer(float *buffer) { dspBufferAtInlet[0] = buffer; }
     float *get_dsp_buffer_at_outlet(int outlet_index);
+
+    /**
+     * Configures the inlet for a graph whose block size differs from that of its parent, or which
+     * overlaps its blocks. The graph is processed every <code>stepSize</code> samples of the
+     * parent. If the graph is not reblocked then the buffer from the parent is passed through.
+     */
+    void setReblocking(bool isReblocked, int parentBlockSize, int stepSize);
+
+    /** Appends the current block of the parent graph to the history of this inlet. */
+    void receiveParentBlock();
+
+    /**
+     * Fills the local block with the most recent <code>block_sizeInt</code> samples up to the end
+     * of the given step of the parent block.
+     */
+    void prepareBlock(int stepIndex);
+
+    /**
+     * Releases the buffer of the parent graph. Called once the parent graph has resolved the
+     * buffers at all inlets of a reblocked graph.
+     */
+    void releaseParentBuffer();
+
+  protected:
+    BufferPool *getInletBufferPool();
+
+  private:
+    /** The input of the parent graph, long enough to cover any block ending in the current one. */
+    float *historyBuffer;
+    int historyLength;
+
+    /** The block from which the objects in the graph read. NULL unless the graph is reblocked. */
+    float *blockBuffer;
+
+    int parentBlockSize;
+    int stepSize;
 };
 
 inline bool DspInlet::canSetBufferAtOutlet(unsigned int outlet_index) {
@@ -29,10 +29,7 @@ message::Object *DspLine::new_object(pd::Message *init_message, PdGraph *graph)
 }
 
 DspLine::DspLine(pd::Message *init_message, PdGraph *graph) : DspObject(2, 0, 0, 1, graph) {
-  target = 0.0f;
-  slope = 0.0f;
-  numSamplesToTarget = 0.0f;
-  lastOutputSample = 0.0f;
+  allocateHotState(sizeof(DspLineState)); // zeroed
 }
 
 DspLine::~DspLine() {
@@ -40,6 +37,7 @@ DspLine::~DspLine() {
 }
 
 void DspLine::process_message(int inlet_index, pd::Message *message) {
+  DspLineState *state = getState();
   if (inlet_index == 0) { // not sure what the right inlet is for
     switch (message->get_num_elements()) {
       case 0: {
@@ -48,21 +46,21 @@ void DspLine::process_message(int inlet_index, pd::Message *message) {
       case 1: {
         // jump to value
         if (message->is_float(0)) {
-          target = message->get_float(0);
-          lastOutputSample = target;
-          slope = 0.0f;
-          numSamplesToTarget = 0.0f;
+          state->target = message->get_float(0);
+          state->lastOutputSample = state->target;
+          state->slope = 0.0f;
+          state->numSamplesToTarget = 0.0f;
         }
         break;
       }
       default: { // at least two inputs
         // new ramp
         if (message->is_float(0) && message->is_float(1)) {
-          target = message->get_float(0);
+          state->target = message->get_float(0);
           float timeToTargetMs = message->get_float(1); // no negative time to targets!
-          numSamplesToTarget = utils::millisecondsToSamples(
+          state->numSamplesToTarget = utils::millisecondsToSamples(
               (timeToTargetMs < 1.0f) ? 1.0f : timeToTargetMs, graph->get_sample_rate());
-          slope = (target - lastOutputSample) / numSamplesToTarget;
+          state->slope = (state->target - state->lastOutputSample) / state->numSamplesToTarget;
         }
         break;
       }
@@ -71,47 +69,33 @@ void DspLine::process_message(int inlet_index, pd::Message *message) {
 }
 
 void DspLine::processDspWithIndex(int fromIndex, int toIndex) {
-  if (numSamplesToTarget <= 0.0f) { // if we have already reached the target
+  DspLineState *state = getState();
+  if (state->numSamplesToTarget <= 0.0f) { // if we have already reached the target
     int n = toIndex - fromIndex;
     if (n > 0) { // n may be zero
-      ArrayArithmetic::fill(dspBufferAtOutlet[0], target, fromIndex, toIndex);
-      lastOutputSample = target;
+      ArrayArithmetic::fill(dspBufferAtOutlet[0], state->target, fromIndex, toIndex);
+      state->lastOutputSample = state->target;
     }
   } else {
     // the number of samples to be processed this iteration
     int n = toIndex - fromIndex;
     if (n > 0) { // n may be zero
       // if there is anything to process at all (several messages may be received at once)
-      if (numSamplesToTarget < n) {
-        int targetIndexInt = fromIndex + numSamplesToTarget;
-        #if __APPLE__
-        vDSP_vramp(&lastOutputSample, &slope, dspBufferAtOutlet[0]+fromIndex, 1, targetIndexInt-fromIndex);
-        vDSP_vfill(&target, dspBufferAtOutlet[0]+targetIndexInt, 1, toIndex-targetIndexInt);
-        #else
+      if (state->numSamplesToTarget < n) {
+        int targetIndexInt = fromIndex + state->numSamplesToTarget;
         // if we will process more samples than we have remaining to the target
         // i.e., if we will arrive at the target while processing
-        dspBufferAtOutlet[0][fromIndex] = lastOutputSample;
-        for (int i = fromIndex+1; i < targetIndexInt; i++) {
-          dspBufferAtOutlet[0][i] = dspBufferAtOutlet[0][i-1] + slope;
-        }
-        for (int i = targetIndexInt; i < toIndex; i++) {
-          dspBufferAtOutlet[0][i] = target;
-        }
-        #endif
-        lastOutputSample = target;
-        numSamplesToTarget = 0;
+        ArrayArithmetic::ramp(state->lastOutputSample, state->slope, dspBufferAtOutlet[0],
+            fromIndex, targetIndexInt);
+        ArrayArithmetic::fill(dspBufferAtOutlet[0], state->target, targetIndexInt, toIndex);
+        state->lastOutputSample = state->target;
+        state->numSamplesToTarget = 0;
       } else {
         // if the target is far off
-        #if __APPLE__
-        vDSP_vramp(&lastOutputSample, &slope, dspBufferAtOutlet[0]+fromIndex, 1, n);
-        #else
-        dspBufferAtOutlet[0][fromIndex] = lastOutputSample;
-        for (int i = fromIndex+1; i < toIndex; i++) {
-          dspBufferAtOutlet[0][i] = dspBufferAtOutlet[0][i-1] + slope;
-        }
-        #endif
-        lastOutputSample = dspBufferAtOutlet[0][toIndex-1] + slope;
-        numSamplesToTarget -= n;
+        ArrayArithmetic::ramp(state->lastOutputSample, state->slope, dspBufferAtOutlet[0],
+            fromIndex, toIndex);
+        state->lastOutputSample = dspBufferAtOutlet[0][toIndex-1] + state->slope;
+        state->numSamplesToTarget -= n;
       }
     }
   }
@@ -25,6 +25,14 @@
 
 #include "DspObject.h"
 
+/** The ramp of a <code>DspLine</code>, kept as the hot state of the object. */
+typedef struct DspLineState {
+  float target;
+  float slope;
+  float numSamplesToTarget;
+  float lastOutputSample;
+} DspLineState;
+
 /** [line~] */
 class DspLine : public DspObject {
   
@@ -35,15 +43,17 @@ class DspLine : public DspObject {
   
     static const char *get_object_label();
     std::string toString();
+
+    bool canPropagateSilence() { return true; }
+    bool isSilentBlock(unsigned int silentInletMask) {
+      return (getState()->numSamplesToTarget <= 0.0f) && (getState()->target == 0.0f);
+    }
   
   private:
     void process_message(int inlet_index, PdMessage *message);
     void processDspWithIndex(int fromIndex, int toIndex);
-  
-    float target;
-    float slope;
-    float numSamplesToTarget;
-    float lastOutputSample;
+
+    DspLineState *getState() { return reinterpret_cast<DspLineState *>(hotState); }
 };
 
 inline const char *DspLine::get_object_label() {
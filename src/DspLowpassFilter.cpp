@@ -42,6 +42,7 @@ void DspLowpassFilter::calcFiltCoeff(float fc) {
 
   float wc = 2.0f*M_PI*fc;
   float alpha = wc / (wc + graph->get_sample_rate());
+  float *b = getState()->b;
   b[0] = alpha;
   b[1] = 0.0f;
   b[2] = 0.0f;
@@ -59,7 +60,7 @@ void DspLowpassFilter::process_message(int inlet_index, pd::Message *message) {
         }
         case SYMBOL: {
           if (message->is_symbol_str(0, "clear")) {
-            x1 = x2 = dspBufferAtOutlet[0][0] = dspBufferAtOutlet[0][1] = 0.0f;
+            getState()->history[0] = getState()->history[1] = dspBufferAtOutlet[0][0] = dspBufferAtOutlet[0][1] = 0.0f;
           }
           break;
         }
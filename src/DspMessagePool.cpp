@@ -0,0 +1,59 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include "DspMessagePool.h"
+#include "DspObject.h"
+
+DspMessagePool::DspMessagePool(unsigned int numSlots) {
+  this->numSlots = numSlots;
+  slots = (DspMessageSlot *) calloc(numSlots, sizeof(DspMessageSlot));
+  freeSlots = NULL;
+  for (int i = numSlots-1; i >= 0; i--) {
+    slots[i].next = freeSlots;
+    freeSlots = &slots[i];
+  }
+  numFreeSlots = numSlots;
+  lock = 0;
+}
+
+DspMessagePool::~DspMessagePool() {
+  free(slots);
+}
+
+DspMessageSlot *DspMessagePool::getSlot() {
+  while (__sync_lock_test_and_set(&lock, 1));
+  DspMessageSlot *slot = freeSlots;
+  if (slot != NULL) {
+    freeSlots = slot->next;
+    numFreeSlots--;
+  }
+  __sync_lock_release(&lock);
+  if (slot != NULL) slot->next = NULL;
+  return slot;
+}
+
+void DspMessagePool::releaseSlot(DspMessageSlot *slot) {
+  while (__sync_lock_test_and_set(&lock, 1));
+  slot->next = freeSlots;
+  freeSlots = slot;
+  numFreeSlots++;
+  __sync_lock_release(&lock);
+}
@@ -0,0 +1,64 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _DSP_MESSAGE_POOL_H_
+#define _DSP_MESSAGE_POOL_H_
+
+struct DspMessageSlot;
+
+/** The number of message slots which a root graph preallocates for all of its objects. */
+#define DSP_MESSAGE_POOL_CAPACITY 1024
+
+/**
+ * A <code>DspMessagePool</code> holds the message slots of a root graph and all of its subgraphs,
+ * into which a <code>DspObject</code> spills messages once its own ring is full. The slots are
+ * allocated along with the pool, such that dense automation (e.g. hundreds of messages to one
+ * object in a block) is queued without touching the heap. Slots may be taken and returned from
+ * any thread which processes the graph.
+ */
+class DspMessagePool {
+
+  public:
+    DspMessagePool(unsigned int numSlots);
+    ~DspMessagePool();
+
+    /** Returns a free slot, or <code>NULL</code> if all slots are in use. */
+    DspMessageSlot *getSlot();
+
+    /** Returns a slot taken with <code>getSlot()</code> to the pool. */
+    void releaseSlot(DspMessageSlot *slot);
+
+    unsigned int getNumSlots() { return numSlots; }
+    unsigned int getNumFreeSlots() { return numFreeSlots; }
+
+  private:
+    DspMessageSlot *slots;
+
+    /** The free slots, linked through their <code>next</code> pointers. */
+    DspMessageSlot *freeSlots;
+
+    unsigned int numSlots;
+    unsigned int numFreeSlots;
+
+    /** A spin lock around the free list. It is only held for a few instructions. */
+    volatile int lock;
+};
+
+#endif // _DSP_MESSAGE_POOL_H_
@@ -32,7 +32,7 @@ message::Object *DspMultiply::new_object(pd::Message *init_message, PdGraph *gra
 DspMultiply::DspMultiply(pd::Message *init_message, PdGraph *graph) : DspObject(2, 2, 0, 1, graph) {
   constant = init_message->is_float(0) ? init_message->get_float(0) : 0.0f;
   inputConstant = 0.0f;
-  process_functionNoMessage = &processScalar;
+  updateProcessFunction();
 }
 
 DspMultiply::~DspMultiply() {
@@ -47,12 +47,31 @@ string DspMultiply::toString() {
 }
 
 void DspMultiply::onInletConnectionUpdate(unsigned int inlet_index) {
+  updateProcessFunction();
+}
+
+void DspMultiply::onBlockSizeUpdate(int block_size) {
+  DspObject::onBlockSizeUpdate(block_size);
+  updateProcessFunction();
+}
+
+void DspMultiply::updateProcessFunction() {
+  // because this can only be called at block boundaries, it is guaranteed that no messages will
+  // be in the message queue.
+  if (incomingDspConnections[0].size() > 0 && incomingDspConnections[1].size() > 0) {
+    process_function = DSP_SELECT_BLOCK_FUNCTION(processSignalBlock, block_sizeInt, processSignal);
+  } else {
+    process_function = DSP_SELECT_BLOCK_FUNCTION(processScalarBlock, block_sizeInt, processScalar);
+  }
+  process_functionNoMessage = process_function;
+}
+
+bool DspMultiply::isSilentBlock(unsigned int silentInletMask) {
+  // the product is silent if either factor is
   if (incomingDspConnections[0].size() > 0 && incomingDspConnections[1].size() > 0) {
-    process_function = &processSignal;
+    return (silentInletMask & 0x3) != 0;
   } else {
-    // because onInletConnectionUpdate can only be called at block boundaries, it is guaranteed
-    // that no messages will be in the message queue.
-    process_function = &processScalar;
+    return (silentInletMask & 0x1) || (constant == 0.0f);
   }
 }
 
@@ -75,3 +94,23 @@ void DspMultiply::processScalar(DspObject *dspObject, int fromIndex, int toIndex
   ArrayArithmetic::multiply(d->dspBufferAtInlet[0] , d->constant,
       d->dspBufferAtOutlet[0], fromIndex, toIndex);
 }
+
+template <int N>
+void DspMultiply::processSignalBlock(DspObject *dspObject, int fromIndex, int toIndex) {
+  if (fromIndex == 0 && toIndex == N) {
+    DspMultiply *d = reinterpret_cast<DspMultiply *>(dspObject);
+    ArrayArithmetic::multiplyBlock<N>(d->dspBufferAtInlet[0], d->dspBufferAtInlet[1], d->dspBufferAtOutlet[0]);
+  } else {
+    processSignal(dspObject, fromIndex, toIndex);
+  }
+}
+
+template <int N>
+void DspMultiply::processScalarBlock(DspObject *dspObject, int fromIndex, int toIndex) {
+  if (fromIndex == 0 && toIndex == N) {
+    DspMultiply *d = reinterpret_cast<DspMultiply *>(dspObject);
+    ArrayArithmetic::multiplyBlock<N>(d->dspBufferAtInlet[0], d->constant, d->dspBufferAtOutlet[0]);
+  } else {
+    processScalar(dspObject, fromIndex, toIndex);
+  }
+}
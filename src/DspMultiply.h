@@ -34,14 +34,21 @@ class DspMultiply : public DspObject {
   
     static const char *get_object_label();
     std::string toString();
-  
+
+    bool canProcessInPlace() { return true; }
+    bool canPropagateSilence() { return true; }
+    bool isSilentBlock(unsigned int silentInletMask);
 
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
     static void processScalar(DspObject *dspObject, int fromIndex, int toIndex);
+    template <int N> static void processSignalBlock(DspObject *dspObject, int fromIndex, int toIndex);
+    template <int N> static void processScalarBlock(DspObject *dspObject, int fromIndex, int toIndex);
+    void updateProcessFunction();
     void process_message(int inlet_index, PdMessage *message);
   
     void onInletConnectionUpdate(unsigned int inlet_index);
+    void onBlockSizeUpdate(int block_size);
     
     float inputConstant;
     float constant;
@@ -23,8 +23,11 @@
 #include "ArrayArithmetic.h"
 #include "BufferPool.h"
 #include "DspImplicitAdd.h"
+#include "DspMessagePool.h"
 #include "DspObject.h"
+#include "ObjectArena.h"
 #include "PdGraph.h"
+#include <new>
 
 
 #pragma mark - Constructor/Destructor
@@ -39,16 +42,50 @@ DspObject::DspObject(int numMessageInlets, int numDspInlets, int numMessageOutle
   init(numDspInlets, numDspOutlets, block_size);
 }
 
+void *DspObject::operator new(size_t numBytes) {
+  // each object is preceded by the arena which it came from, keeping the alignment of the object
+  ObjectArena *arena = ObjectArena::getCurrentArena();
+  void *block = NULL;
+  if (arena != NULL) {
+    block = arena->allocate(numBytes + OBJECT_ARENA_ALIGNMENT);
+  } else if (posix_memalign(&block, OBJECT_ARENA_ALIGNMENT, numBytes + OBJECT_ARENA_ALIGNMENT) != 0) {
+    block = NULL;
+  }
+  if (block == NULL) throw std::bad_alloc();
+  *((ObjectArena **) block) = arena;
+  return (char *) block + OBJECT_ARENA_ALIGNMENT;
+}
+
+void DspObject::operator delete(void *object, size_t numBytes) {
+  if (object == NULL) return;
+  char *block = (char *) object - OBJECT_ARENA_ALIGNMENT;
+  ObjectArena *arena = *((ObjectArena **) block);
+  if (arena != NULL) {
+    arena->release(block, numBytes + OBJECT_ARENA_ALIGNMENT);
+  } else {
+    free(block);
+  }
+}
+
 void DspObject::init(int numDspInlets, int numDspOutlets, int block_size) {
   block_sizeInt = block_size;
+  hotState = NULL;
+  hotStateSize = 0;
   process_function = &process_functionDefaultNoMessage;
   process_functionNoMessage = &process_functionDefaultNoMessage;
+  process_functionBatch = NULL;
   
-  // initialise the incoming dsp connections list
-  incomingDspConnections = vector<list<Connection> >(numDspInlets);
+  // the message queue slots are allocated along with the object, so that queueing messages while
+  // the graph is running does not need to allocate
+  memset(messageQueue, 0, sizeof(messageQueue));
+  messageQueueHead = 0;
+  numQueuedMessages = 0;
+  spilledMessages = NULL;
+  lastSpilledMessage = NULL;
+  numMessageQueueOverflows = 0;
   
-  // initialise the outgoing dsp connections list
-  outgoingDspConnections = vector<list<Connection> >(numDspOutlets);
+  incomingDspConnections = ConnectionTable(numDspInlets);
+  outgoingDspConnections = ConnectionTable(numDspOutlets);
 
   memset(dspBufferAtInlet, 0, sizeof(float *) * 3);
   if (numDspInlets > 2) dspBufferAtInlet[2] = (float *) calloc(numDspInlets-2, sizeof(float *));
@@ -65,6 +102,12 @@ DspObject::~DspObject() {
   // inlet and outlet buffers are managed by the BufferPool
   if (getNumDspInlets() > 2) free(dspBufferAtInlet[2]);
   if (getNumDspOutlets() > 2) free(dspBufferAtOutlet[2]);
+
+  if (hotState != NULL) graph->get_object_arena()->releaseHotState(this);
+}
+
+void DspObject::allocateHotState(size_t numBytes) {
+  graph->get_object_arena()->allocateHotState(this, numBytes);
 }
 
 
@@ -74,6 +117,29 @@ connection::Type DspObject::get_connection_type(int outlet_index) {
   return DSP;
 }
 
+bool DspObject::isParallelSafe() {
+  // objects with message outlets may schedule messages while processing audio
+  for (int i = 0; i < getNumOutlets(); i++) {
+    if (get_connection_type(i) == MESSAGE) return false;
+  }
+  return true;
+}
+
+void DspObject::onBlockSizeUpdate(int block_size) {
+  block_sizeInt = block_size;
+}
+
+bool DspObject::isSilentBlock(unsigned int silentInletMask) {
+  unsigned int numDspInlets = getNumDspInlets();
+  if (numDspInlets > 32) return false; // the mask cannot describe all inlets
+  unsigned int allInletsMask = (numDspInlets == 32) ? 0xFFFFFFFF : ((1u << numDspInlets) - 1);
+  return ((silentInletMask & allInletsMask) == allInletsMask) && hasTailDecayed();
+}
+
+BufferPool *DspObject::getInletBufferPool() {
+  return graph->get_buffer_pool();
+}
+
 float *DspObject::get_dsp_buffer_at_inlet(int inlet_index) {
   return (inlet_index < 2)
       ? dspBufferAtInlet[inlet_index] : ((float **) dspBufferAtInlet[2])[inlet_index-2];
@@ -85,27 +151,17 @@ float *DspObject::get_dsp_buffer_at_outlet(int outlet_index) {
 }
 
 list<Connection> DspObject::get_incoming_connections(unsigned int inlet_index) {
-  list<Connection> messageConnectionList = message::Object::get_incoming_connections(inlet_index);
-  list<Connection> dspConnectionList = incomingDspConnections.empty()
-      ? list<Connection>() : incomingDspConnections[inlet_index];
-  messageConnectionList.insert(messageConnectionList.end(), dspConnectionList.begin(), dspConnectionList.end());
-  return messageConnectionList;
-}
-
-list<Connection> DspObject::getIncomingDspConnections(unsigned int inlet_index) {
-  return (inlet_index < incomingDspConnections.size()) ? incomingDspConnections[inlet_index] : list<Connection>();
+  list<Connection> connections = message::Object::get_incoming_connections(inlet_index);
+  ConnectionSpan dspConnections = incomingDspConnections[inlet_index];
+  connections.insert(connections.end(), dspConnections.begin(), dspConnections.end());
+  return connections;
 }
 
 list<Connection> DspObject::get_outgoing_connections(unsigned int outlet_index) {
-  list<Connection> messageConnectionList = message::Object::get_outgoing_connections(outlet_index);
-  list<Connection> dspConnectionList = outgoingDspConnections.empty()
-      ? list<Connection>() : outgoingDspConnections[outlet_index];
-  messageConnectionList.insert(messageConnectionList.end(), dspConnectionList.begin(), dspConnectionList.end());
-  return messageConnectionList;
-}
-
-list<Connection> DspObject::getOutgoingDspConnections(unsigned int outlet_index) {
-  return outgoingDspConnections[outlet_index];
+  list<Connection> connections = message::Object::get_outgoing_connections(outlet_index);
+  ConnectionSpan dspConnections = outgoingDspConnections[outlet_index];
+  connections.insert(connections.end(), dspConnections.begin(), dspConnections.end());
+  return connections;
 }
 
 
@@ -115,9 +171,7 @@ void DspObject::add_connection_from_object_to_inlet(message::Object *message_obj
   message::Object::add_connection_from_object_to_inlet(message_obj, outlet_index, inlet_index);
   
   if (message_obj->get_connection_type(outlet_index) == DSP) {
-    list<Connection> *connections = &incomingDspConnections[inlet_index];
-    Connection obj_let_pair = Connection::new(message_obj, outlet_index);
-    connections->push_back(obj_let_pair);
+    incomingDspConnections.add(inlet_index, Connection::new(message_obj, outlet_index));
   }
   
   onInletConnectionUpdate(inlet_index);
@@ -125,9 +179,7 @@ void DspObject::add_connection_from_object_to_inlet(message::Object *message_obj
 
 void DspObject::remove_connection_from_object_to_inlet(message::Object *message_obj, int outlet_index, int inlet_index) {
   if (message_obj->get_connection_type(outlet_index) == DSP) {
-    list<Connection> *connections = &incomingDspConnections[inlet_index];
-    Connection obj_let_pair = Connection::new(message_obj, outlet_index);
-    connections->remove(obj_let_pair); // NOTE(mhroth): does this work?
+    incomingDspConnections.remove(inlet_index, Connection::new(message_obj, outlet_index));
   } else {
     message::Object::remove_connection_from_object_to_inlet(message_obj, outlet_index, inlet_index);
   }
@@ -144,9 +196,7 @@ void DspObject::add_connection_to_object_from_outlet(message::Object *message_ob
   
   // TODO(mhroth): it is assumed here that the input connection type of the destination object is DSP. Correct?
   if (get_connection_type(outlet_index) == DSP) {
-    list<Connection> *connections = &outgoingDspConnections[outlet_index];
-    Connection obj_let_pair = Connection::new(message_obj, inlet_index);
-    connections->push_back(obj_let_pair);
+    outgoingDspConnections.add(outlet_index, Connection::new(message_obj, inlet_index));
   }
 }
 
@@ -154,9 +204,7 @@ void DspObject::remove_connection_to_object_from_outlet(message::Object *message
   if (get_connection_type(outlet_index) == MESSAGE) {
     message::Object::remove_connection_to_object_from_outlet(message_obj, inlet_index, outlet_index);
   } else {
-    list<Connection> *outgoing_connections = &outgoingDspConnections[outlet_index];
-    Connection obj_let_pair = Connection::new(message_obj, inlet_index);
-    outgoing_connections->remove(obj_let_pair);
+    outgoingDspConnections.remove(outlet_index, Connection::new(message_obj, inlet_index));
   }
 }
 
@@ -174,21 +222,91 @@ void DspObject::setDspBufferAtOutlet(float *buffer, unsigned int outlet_index) {
 #pragma mark -
 
 void DspObject::clearMessageQueue() {
-  while (!messageQueue.empty()) {
-    MessageConnection messageConnection = messageQueue.front();
+  while (numQueuedMessages > 0) {
+    DspMessageSlot *slot = &messageQueue[messageQueueHead];
+    if (slot->isOnHeap) slot->message->free_message();
+    messageQueueHead = (messageQueueHead + 1) % DSP_MESSAGE_QUEUE_CAPACITY;
+    numQueuedMessages--;
+  }
+  while (spilledMessages != NULL) {
+    DspMessageSlot *slot = spilledMessages;
+    if (slot->isOnHeap) slot->message->free_message();
+    spilledMessages = slot->next;
+    graph->get_message_pool()->releaseSlot(slot);
+  }
+  lastSpilledMessage = NULL;
+  while (!messageOverflowQueue.empty()) {
+    MessageConnection messageConnection = messageOverflowQueue.front();
     pd::Message *message = messageConnection.first;
     message->free_message();
-    messageQueue.pop();
+    messageOverflowQueue.pop();
   }
 }
 
+bool DspObject::copyMessageToSlot(pd::Message *message, DspMessageSlot *slot) {
+  int numElements = message->get_num_elements();
+  if (numElements > DSP_MESSAGE_SLOT_NUM_ELEMENTS) return false;
+  
+  // symbols are owned by the sender, so they must be copied along with the message
+  int numSymbolBytes = 0;
+  for (int i = 0; i < numElements; i++) {
+    if (message->is_symbol(i)) numSymbolBytes += strlen(message->get_symbol(i)) + 1;
+  }
+  if (numSymbolBytes > DSP_MESSAGE_SLOT_SYMBOL_BYTES) return false;
+  
+  pd::Message *slotMessage = (pd::Message *) slot->storage;
+  slotMessage->from_timestamp(message->get_timestamp(), numElements);
+  memcpy(slotMessage->get_element(0), message->get_element(0), numElements*sizeof(pd::message::Atom));
+  char *symbol = slot->symbols;
+  for (int i = 0; i < numElements; i++) {
+    if (message->is_symbol(i)) {
+      size_t numBytes = strlen(message->get_symbol(i)) + 1;
+      memcpy(symbol, message->get_symbol(i), numBytes);
+      slotMessage->set_symbol(i, symbol);
+      symbol += numBytes;
+    }
+  }
+  slot->message = slotMessage;
+  slot->isOnHeap = false;
+  return true;
+}
+
 void DspObject::receive_message(int inlet_index, pd::Message *message) {
   // Queue the message to be processed during the DSP round only if the graph is switched on.
   // Otherwise messages would begin to pile up because the graph is not processed.
   if (graph->isSwitchedOn()) {
-    // Copy the message to the heap so that it is available to process later.
-    // The message is released once it is consumed in processDsp().
-    messageQueue.push(Connection::new(message->clone_on_heap(), inlet_index));
+    // Copy the message into the next free slot so that it is available to process later. The
+    // ring is used first, then slots from the pool of the root graph. Once anything has spilled to
+    // a later stage, later messages must follow it there in order to preserve their order of
+    // arrival.
+    DspMessageSlot *slot = NULL;
+    if (messageOverflowQueue.empty()) {
+      if (numQueuedMessages < DSP_MESSAGE_QUEUE_CAPACITY && spilledMessages == NULL) {
+        slot = &messageQueue[(messageQueueHead + numQueuedMessages) % DSP_MESSAGE_QUEUE_CAPACITY];
+        numQueuedMessages++;
+      } else {
+        slot = graph->get_message_pool()->getSlot();
+        if (slot != NULL) {
+          if (spilledMessages == NULL) spilledMessages = slot;
+          else lastSpilledMessage->next = slot;
+          lastSpilledMessage = slot;
+        }
+      }
+    }
+    if (slot != NULL) {
+      if (!copyMessageToSlot(message, slot)) {
+        // the message is too large for the slot
+        slot->message = message->clone_on_heap();
+        slot->isOnHeap = true;
+        numMessageQueueOverflows++;
+      }
+      slot->inlet_index = inlet_index;
+    } else {
+      // The pool is exhausted too. Rather than dropping the message, spill it to the heap. This is
+      // not real-time safe, which is what the overflow counter is there to reveal.
+      messageOverflowQueue.push(MessageConnection(message->clone_on_heap(), inlet_index));
+      numMessageQueueOverflows++;
+    }
     
     // only process the message if the process function is set to the default no-message function.
     // If it is set to anything else, then it is assumed that messages should not be processed.
@@ -206,19 +324,50 @@ void DspObject::process_functionDefaultNoMessage(DspObject *dspObject, int fromI
 void DspObject::process_functionMessage(DspObject *dspObject, int fromIndex, int toIndex) {
   double blockIndexOfLastMessage = 0.0; // reset the block index of the last received message
   do { // there is at least one message
-    MessageConnection messageConnection = dspObject->messageQueue.front();
-    pd::Message *message = messageConnection.first;
-    unsigned int inlet_index = messageConnection.second;
+    // the ring is drained first, then the slots from the pool and then the overflow queue, as
+    // each of them only receives messages once the previous is full
+    DspMessageSlot *slot = NULL;
+    bool isSpilled = false;
+    pd::Message *message = NULL;
+    unsigned int inlet_index = 0;
+    if (dspObject->numQueuedMessages > 0) {
+      slot = &dspObject->messageQueue[dspObject->messageQueueHead];
+      message = slot->message;
+      inlet_index = slot->inlet_index;
+    } else if (dspObject->spilledMessages != NULL) {
+      slot = dspObject->spilledMessages;
+      isSpilled = true;
+      message = slot->message;
+      inlet_index = slot->inlet_index;
+    } else {
+      MessageConnection messageConnection = dspObject->messageOverflowQueue.front();
+      message = messageConnection.first;
+      inlet_index = messageConnection.second;
+    }
     
     double blockIndexOfCurrentMessage = dspObject->graph->getBlockIndex(message);
     dspObject->process_functionNoMessage(dspObject,
         ceil(blockIndexOfLastMessage), ceil(blockIndexOfCurrentMessage));
     dspObject->process_message(inlet_index, message);
-    message->free_message(); // free the message from the head, the message has been consumed.
-    dspObject->messageQueue.pop();
+    
+    // release the message from the head, the message has been consumed. The slot is only released
+    // afterwards such that messages sent to this object while processing do not overwrite it.
+    if (isSpilled) {
+      if (slot->isOnHeap) message->free_message();
+      dspObject->spilledMessages = slot->next;
+      if (dspObject->spilledMessages == NULL) dspObject->lastSpilledMessage = NULL;
+      dspObject->graph->get_message_pool()->releaseSlot(slot);
+    } else if (slot != NULL) {
+      if (slot->isOnHeap) message->free_message();
+      dspObject->messageQueueHead = (dspObject->messageQueueHead + 1) % DSP_MESSAGE_QUEUE_CAPACITY;
+      dspObject->numQueuedMessages--;
+    } else {
+      message->free_message();
+      dspObject->messageOverflowQueue.pop();
+    }
     
     blockIndexOfLastMessage = blockIndexOfCurrentMessage;
-  } while (!dspObject->messageQueue.empty());
+  } while (dspObject->hasPendingMessages());
   dspObject->process_functionNoMessage(dspObject, ceil(blockIndexOfLastMessage), toIndex);
   
   // because messages are received much less often than on a per-block basis, once messages are
@@ -269,9 +418,8 @@ list<DspObject *> DspObject::get_process_order() {
       }
     }
     
-    BufferPool *buffer_pool = graph->get_buffer_pool();
+    BufferPool *buffer_pool = getInletBufferPool();
     pd::Message *dspAddInitMessage = PD_MESSAGE_ON_STACK(1);
-    dspAddInitMessage->from_timestamp_and_float(0, 0.0f);
     for (int i = 0; i < incomingDspConnections.size(); i++) {
       switch (incomingDspConnections[i].size()) {
         case 0: {
@@ -297,63 +445,63 @@ list<DspObject *> DspObject::get_process_order() {
         default: { // > 1
           /*
            * [obj~] [obj~] [obj~]...
-           *   \     /      /
-           *    \   /      /
-           *    [+~~]     /
-           *     \       /
-           *      \     /
-           *       \   /
+           *   \      |      /
+           *    \     |     /
+           *     \    |    /
            *       [+~~]
-           *        \
-           *         etc...
+           *         |
+           *
+           * All signals are summed by a single implicit add, in one pass.
            */
-          list<Connection>::iterator it = incomingDspConnections[i].begin();
-          Connection leftOlPair = *it++;
-          list<DspObject *> parentProcessList = leftOlPair.first->get_process_order();
-          processList.splice(processList.end(), parentProcessList);
-          
-          while (it != incomingDspConnections[i].end()) {
-            Connection rightOlPair = *it++;
-            list<DspObject *> parentProcessList = rightOlPair.first->get_process_order();
+          dspAddInitMessage->from_timestamp_and_float(0, (float) incomingDspConnections[i].size());
+          DspImplicitAdd *dspAdd = new DspImplicitAdd(dspAddInitMessage, get_graph());
+          ConnectionSpan connections = incomingDspConnections[i];
+          int j = 0;
+          for (ConnectionSpan::iterator it = connections.begin(); it != connections.end(); ++it, ++j) {
+            list<DspObject *> parentProcessList = (*it).first->get_process_order();
             processList.splice(processList.end(), parentProcessList);
-            
-            DspImplicitAdd *dspAdd = new DspImplicitAdd(dspAddInitMessage, get_graph());
-            float *buffer = reinterpret_cast<DspObject *>(leftOlPair.first)->get_dsp_buffer_at_outlet(leftOlPair.second);
-            dspAdd->set_dsp_buffer_at_inlet(buffer, 0);
-            buffer_pool->releaseBuffer(buffer);
-            
-            buffer = reinterpret_cast<DspObject *>(rightOlPair.first)->get_dsp_buffer_at_outlet(rightOlPair.second);
-            dspAdd->set_dsp_buffer_at_inlet(buffer, 1);
-            buffer_pool->releaseBuffer(buffer);
-            
-            // assign the output buffer of the +~~
-            dspAdd->setDspBufferAtOutlet(buffer_pool->getBuffer(1), 0);
-            
-            processList.push_back(dspAdd);
-            leftOlPair = Connection::new(dspAdd, 0);
+            float *buffer = reinterpret_cast<DspObject *>((*it).first)->get_dsp_buffer_at_outlet((*it).second);
+            dspAdd->set_dsp_buffer_at_inlet(buffer, j);
           }
           
-          float *buffer = reinterpret_cast<DspObject *>(leftOlPair.first)->get_dsp_buffer_at_outlet(leftOlPair.second);
-          set_dsp_buffer_at_inlet(buffer, i);
+          // the sources are only released once all of them have been ordered, as none of them may
+          // be overwritten before the +~~ is processed. The first is reused by the output if possible.
+          for (j = dspAdd->getNumDspInlets()-1; j >= 0; j--) {
+            buffer_pool->releaseBuffer(dspAdd->get_dsp_buffer_at_inlet(j));
+          }
+          dspAdd->setDspBufferAtOutlet(buffer_pool->getBuffer(1), 0);
+          processList.push_back(dspAdd);
+          
+          set_dsp_buffer_at_inlet(dspAdd->get_dsp_buffer_at_outlet(0), i);
           // inlet buffer is released once all inlet buffers have been resolved
           break;
         }
       }
     }
     
-    // release the inlet buffers only after everything has been set up
-    for (int i = 0; i < getNumDspInlets(); i++) {
-      float *buffer = get_dsp_buffer_at_inlet(i);
-      buffer_pool->releaseBuffer(buffer);
+    // Release the inlet buffers only after everything has been set up. Buffers are reused last in,
+    // first out, so if this object is the last reader of its first inlet's buffer, that buffer is
+    // written in place at the first outlet.
+    bool isInPlace = canProcessInPlace();
+    if (isInPlace) {
+      for (int i = getNumDspInlets()-1; i >= 0; i--) {
+        buffer_pool->releaseBuffer(get_dsp_buffer_at_inlet(i));
+      }
     }
     
     // set the outlet buffers
     for (int i = 0; i < getNumDspOutlets(); i++) {
       if (canSetBufferAtOutlet(i)) {
-        float *buffer = buffer_pool->getBuffer(outgoingDspConnections[i].size());
+        float *buffer = graph->get_buffer_pool()->getBuffer(outgoingDspConnections[i].size());
         setDspBufferAtOutlet(buffer, i);
       }
     }
+
+    if (!isInPlace) {
+      for (int i = 0; i < getNumDspInlets(); i++) {
+        buffer_pool->releaseBuffer(get_dsp_buffer_at_inlet(i));
+      }
+    }
     
     // NOTE(mhroth): even if an object does not process audio, its buffer still needs to be connected.
     // They may be passed on to other objects, such as s~/r~ pairs
@@ -24,21 +24,76 @@
 #define _DSP_OBJECT_H_
 
 #include <queue>
+#include <stdlib.h>
 #include "ArrayArithmetic.h"
+#include "BufferArena.h"
+#include "ConnectionTable.h"
 #include "MessageObject.h"
+#include "ObjectArena.h"
 
+class BufferPool;
+
+// Buffers which are not taken from the graph's BufferArena (e.g. lookup tables and reblocking
+// buffers) are still aligned to a cache line.
 #if __SSE__
-// allocate memory aligned to 16-bytes memory boundary
-#define ALLOC_ALIGNED_BUFFER(_numBytes) (float *) _mm_malloc(_numBytes, 16)
+#define ALLOC_ALIGNED_BUFFER(_numBytes) (float *) _mm_malloc(_numBytes, BUFFER_ARENA_ALIGNMENT)
 #define FREE_ALIGNED_BUFFER(_buffer) _mm_free(_buffer)
 #else
-// NOTE(mhroth): valloc seems to work well, but is deprecated!
-#define ALLOC_ALIGNED_BUFFER(_numBytes) (float *) valloc(_numBytes)
+static inline float *allocAlignedBuffer(size_t numBytes) {
+  void *buffer = NULL;
+  return (posix_memalign(&buffer, BUFFER_ARENA_ALIGNMENT, numBytes) == 0) ? (float *) buffer : NULL;
+}
+#define ALLOC_ALIGNED_BUFFER(_numBytes) allocAlignedBuffer(_numBytes)
 #define FREE_ALIGNED_BUFFER(_buffer) free(_buffer)
 #endif
 
+/** Samples below this magnitude are treated as silence when deciding if a tail has decayed. */
+#define DSP_SILENCE_THRESHOLD 1.0e-9f
+
+/**
+ * Evaluates to the instantiation of the process function template <code>_function</code> for the
+ * given block size if one exists (for powers of two from 16 to 512), otherwise to
+ * <code>_fallback</code>. Specialised process functions must still accept a block which has been
+ * split by messages, usually by deferring to the fallback.
+ */
+#define DSP_SELECT_BLOCK_FUNCTION(_function, _block_size, _fallback) \
+    (((_block_size) == 64) ? &_function<64> : \
+     ((_block_size) == 16) ? &_function<16> : \
+     ((_block_size) == 32) ? &_function<32> : \
+     ((_block_size) == 128) ? &_function<128> : \
+     ((_block_size) == 256) ? &_function<256> : \
+     ((_block_size) == 512) ? &_function<512> : &_fallback)
+
 typedef std::pair<PdMessage *, unsigned int> MessageConnection;
 
+/**
+ * The number of messages which can be queued in the ring of a <code>DspObject</code>. Further
+ * messages spill into the <code>DspMessagePool</code> of its root graph.
+ */
+#define DSP_MESSAGE_QUEUE_CAPACITY 8
+
+/** The largest message (in elements) which is stored inline in the message queue. */
+#define DSP_MESSAGE_SLOT_NUM_ELEMENTS 4
+
+/** The number of bytes reserved in each queue slot for copies of symbol elements. */
+#define DSP_MESSAGE_SLOT_SYMBOL_BYTES 64
+
+/**
+ * A preallocated entry in the message queue of a <code>DspObject</code>, either in its ring or
+ * taken from the <code>DspMessagePool</code>. Small messages are copied into <code>storage</code>
+ * (with their symbols in <code>symbols</code>) such that queueing them does not touch the heap.
+ * Larger messages are spilled to the heap and <code>isOnHeap</code> is set.
+ */
+typedef struct DspMessageSlot {
+  PdMessage *message;
+  unsigned int inlet_index;
+  bool isOnHeap;
+  struct DspMessageSlot *next; // the next slot taken from the pool, or in its free list
+  double storage[(sizeof(PdMessage) + (DSP_MESSAGE_SLOT_NUM_ELEMENTS-1) * sizeof(MessageAtom) +
+      sizeof(double) - 1) / sizeof(double)];
+  char symbols[DSP_MESSAGE_SLOT_SYMBOL_BYTES];
+} DspMessageSlot;
+
 /**
  * A <code>DspObject</code> is the abstract superclass of any object which processes audio.
  * <code>DspObject</code> is a subclass of <code>MessageObject</code>, such that all of the former
@@ -61,6 +116,14 @@ class DspObject : public MessageObject {
 
     virtual ~DspObject();
 
+    /**
+     * Objects which are created while an <code>ObjectArena</code> is current on the calling thread
+     * (i.e. by the <code>ObjectFactoryMap</code>) are allocated from that arena. All others are
+     * allocated from the heap.
+     */
+    static void *operator new(size_t numBytes);
+    static void operator delete(void *object, size_t numBytes);
+
     virtual void receive_message(int inlet_index, PdMessage *message);
 
     /* Override MessageObject::shouldDistributeMessageToInlets() */
@@ -69,6 +132,13 @@ class DspObject : public MessageObject {
     /** Process audio buffers in this block. */
     void (*processFunction)(DspObject *dspObject, int fromIndex, int toIndex);
 
+    /**
+     * Processes several objects of the same kind at once, in place of their
+     * <code>processFunctionNoMessage</code>. It is only called for objects without pending messages,
+     * and is <code>NULL</code> for objects which cannot be processed this way.
+     */
+    void (*processFunctionBatch)(DspObject **dspObjects, int numObjects, int fromIndex, int toIndex);
+
     /** Returns the connection type of the given outlet. */
     virtual connection::Type get_connection_type(int outlet_index);
 
@@ -82,6 +152,62 @@ class DspObject : public MessageObject {
     /** Return true if a buffer from the Buffer Pool should set set at the given outlet. False otherwise. */
     virtual bool canSetBufferAtOutlet(unsigned int outlet_index) { return true; }
 
+    /**
+     * Return true if the buffer at an outlet may be the same as the buffer at an inlet, i.e. if each
+     * output sample is only written once the input samples at that index and before have been read.
+     * An inlet buffer which is last read by this object is then reused at its outlet. False by
+     * default. Objects which only apply the elementwise <code>ArrayArithmetic</code> functions
+     * (e.g. +~, *~, clip~) override this, as those are all safe to use in place.
+     */
+    virtual bool canProcessInPlace() { return false; }
+
+    /**
+     * Returns true if this object may be processed concurrently with any other object on which it
+     * has no buffer dependency. Objects which touch global state (e.g. send~, throw~, delwrite~,
+     * dac~) or which send messages while processing audio must return false.
+     */
+    virtual bool isParallelSafe();
+
+    /**
+     * Called when the block size of the graph changes (e.g. because of [block~]). Objects which
+     * allocate buffers according to the block size must reallocate them. The graph is never
+     * attached when this happens.
+     */
+    virtual void onBlockSizeUpdate(int block_size);
+
+    /**
+     * Returns <code>true</code> if the object may produce silence in some blocks, such that it
+     * need not be processed. <code>isSilentBlock()</code> is then checked before each block.
+     */
+    virtual bool canPropagateSilence() { return false; }
+
+    /**
+     * Called before each block in which the object has no pending messages. Bit <i>i</i> of
+     * <code>silentInletMask</code> is set if dsp inlet <i>i</i> is known to be silent. Returns
+     * <code>true</code> if all outlets are silent in this block, in which case the object is not
+     * processed. By default an object is silent if all of its dsp inlets are silent and its tail has
+     * decayed.
+     */
+    virtual bool isSilentBlock(unsigned int silentInletMask);
+
+    /**
+     * Returns <code>true</code> once any internal state (e.g. of a filter or a delay line) has
+     * decayed to silence. Only called while the inlets are silent. The state may be reset here.
+     */
+    virtual bool hasTailDecayed() { return true; }
+
+    /** Returns <code>true</code> if there are messages to be processed in the coming block. */
+    bool hasPendingMessages() {
+      return (numQueuedMessages > 0) || (spilledMessages != NULL) || !messageOverflowQueue.empty();
+    }
+
+    /**
+     * Returns the number of messages which could not be queued in the preallocated slots and were
+     * instead copied to the heap, either because neither the ring nor the pool of the root graph
+     * had a free slot, or because the message was too large.
+     */
+    unsigned int getNumMessageQueueOverflows() { return numMessageQueueOverflows; }
+
     virtual void addConnectionFromObjectToInlet(MessageObject *messageObject, int outlet_index, int inlet_index);
     virtual void addConnectionToObjectFromOutlet(MessageObject *messageObject, int inlet_index, int outlet_index);
     virtual void removeConnectionFromObjectToInlet(MessageObject *messageObject, int outlet_index, int inlet_index);
@@ -108,8 +234,10 @@ class DspObject : public MessageObject {
      */
     virtual list<ObjectConnection> getIncomingConnections(unsigned int inlet_index);
 
-    /** Returns only incoming dsp connections to the given inlet. */
-    virtual list<ObjectConnection> getIncomingDspConnections(unsigned int inlet_index);
+    /** Returns only incoming dsp connections to the given inlet, without copying them. */
+    ConnectionSpan getIncomingDspConnections(unsigned int inlet_index) {
+      return incomingDspConnections[inlet_index];
+    }
 
     /**
      * Returns <i>all</i> outgoing connections from the given outlet. This includes both message and
@@ -117,8 +245,10 @@ class DspObject : public MessageObject {
      */
     virtual list<ObjectConnection> getOutgoingConnections(unsigned int outlet_index);
 
-    /** Returns only outgoing dsp connections from the given outlet. */
-    virtual list<ObjectConnection> getOutgoingDspConnections(unsigned int outlet_index);
+    /** Returns only outgoing dsp connections from the given outlet, without copying them. */
+    ConnectionSpan getOutgoingDspConnections(unsigned int outlet_index) {
+      return outgoingDspConnections[outlet_index];
+    }
 
     static const char *get_object_label() { return "obj~"; }
 
@@ -137,15 +267,49 @@ class DspObject : public MessageObject {
      */
     virtual void onInletConnectionUpdate(unsigned int inlet_index);
 
+    /**
+     * Returns the pool which owns the buffers arriving at the inlets of this object. By default
+     * this is the pool of the object's graph. <code>DspInlet</code> is fed from its parent graph.
+     */
+    virtual BufferPool *getInletBufferPool();
+
     /** Immediately deletes all messages in the message queue without executing them. */
     void clearMessageQueue();
 
+    /**
+     * Allocates zeroed hot state of the given size from the arena of the graph, replacing any
+     * previous state. See <code>hotState</code>.
+     */
+    void allocateHotState(size_t numBytes);
+
     // both float and int versions of the blocksize are stored as different internal mechanisms
     // require different number formats
     int block_sizeInt;
 
-    /** The local message queue. Messages that are pending for the next block. */
-    queue<MessageConnection> messageQueue;
+    /**
+     * The local message queue. Messages that are pending for the next block. It is a ring of
+     * <code>DSP_MESSAGE_QUEUE_CAPACITY</code> slots starting at <code>messageQueueHead</code>.
+     */
+    DspMessageSlot messageQueue[DSP_MESSAGE_QUEUE_CAPACITY];
+    unsigned int messageQueueHead;
+    unsigned int numQueuedMessages;
+
+    /**
+     * Messages which arrive while the ring is full, in slots taken from the pool of the root graph.
+     * They are always later than those in the ring, and are delivered once the ring has been
+     * drained.
+     */
+    DspMessageSlot *spilledMessages;
+    DspMessageSlot *lastSpilledMessage;
+
+    /**
+     * Messages which arrive while the pool is also exhausted. They are always later than all
+     * others, and are delivered last.
+     */
+    queue<MessageConnection> messageOverflowQueue;
+
+    /** Counts the messages which had to be copied to the heap. */
+    unsigned int numMessageQueueOverflows;
 
     /* An array of pointers to resolved dsp buffers at each inlet. */
     float *dspBufferAtInlet[3];
@@ -153,18 +317,35 @@ class DspObject : public MessageObject {
     /* An array of pointers to resolved dsp buffers at each outlet. */
     float *dspBufferAtOutlet[3];
 
-    /** List of all dsp objects connecting to this object at each inlet. */
-    vector<list<ObjectConnection> > incomingDspConnections;
+    /** All dsp objects connecting to this object, by inlet. */
+    ConnectionTable incomingDspConnections;
 
-    /** List of all dsp objects to which this object connects at each outlet. */
-    vector<list<ObjectConnection> > outgoingDspConnections;
+    /** All dsp objects to which this object connects, by outlet. */
+    ConnectionTable outgoingDspConnections;
 
     /** The process function to use when acting on a message. */
     void (*processFunctionNoMessage)(DspObject *dspObject, int fromIndex, int toIndex);
 
+    /**
+     * The state which is read and written in every block, if the object keeps it here. It is moved
+     * whenever the process order changes (see <code>ObjectArena::compactHotState()</code>), so it
+     * must always be reached through this pointer and never be held on to across blocks.
+     */
+    void *hotState;
+
   private:
+    friend class ObjectArena;
+
+    size_t hotStateSize;
+
     /** This function encapsulates the common code between the two constructors. */
     void init(int numDspInlets, int numDspOutlets, int block_size);
+
+    /**
+     * Copies the message into the given slot. Returns <code>false</code> if the message does not
+     * fit, in which case the slot is left unchanged.
+     */
+    static bool copyMessageToSlot(PdMessage *message, DspMessageSlot *slot);
 };
 
 #endif // _DSP_OBJECT_H_
@@ -20,48 +20,195 @@
  *
  */
 
+#if __AVX2__
+#include <immintrin.h>
+#endif
 #include "DspOsc.h"
 #include "PdGraph.h"
 
-// initialise the static class variables
-float *DspOsc::cos_table = NULL;
-int DspOsc::refCount = 0;
+// the phase is shifted down by 8 bits before it is converted, so that it is exact as a float
+#define OSC_PHASE_TO_CYCLES 0.000000059604644775f // == 2^-24
+#define OSC_CYCLES_TO_HALF_PHASE 2147483648.0f // == 2^31
+
+// the Taylor series of sin(u) for |u| <= pi/2, which is accurate to about 6e-8
+#define OSC_SIN_3 (-1.0f/6.0f)
+#define OSC_SIN_5 (1.0f/120.0f)
+#define OSC_SIN_7 (-1.0f/5040.0f)
+#define OSC_SIN_9 (1.0f/362880.0f)
+#define OSC_SIN_11 (-1.0f/39916800.0f)
+
+/*
+ * cos(2*pi*p) == sin(2*pi*t) where t = |p - 1/2| - 1/4, which lies within [-1/4, 1/4]. All of the
+ * versions below evaluate exactly the same operations, such that they agree to the bit.
+ */
+static inline float cosineOfPhase(uint32_t phase) {
+  float p = ((float) (int32_t) (phase >> 8)) * OSC_PHASE_TO_CYCLES;
+  float u = (fabsf(p - 0.5f) - 0.25f) * ((float) (2.0 * M_PI));
+  float u2 = u * u;
+  return u * (((((((((OSC_SIN_11 * u2) + OSC_SIN_9) * u2) + OSC_SIN_7) * u2) + OSC_SIN_5) * u2
+      + OSC_SIN_3) * u2) + 1.0f);
+}
+
+/** The increment at a frequency set by message, exact to the resolution of the phase. */
+static inline uint32_t exactIncrementOfFrequency(double frequency, double sampleRate) {
+  double cycles = frequency / sampleRate;
+  return (uint32_t) (int64_t) floor((cycles - floor(cycles)) * 4294967296.0 + 0.5);
+}
+
+/*
+ * Only the fraction of a cycle per sample matters. The fraction left after truncation lies within
+ * (-1, 1), and so is scaled to half of the phase range and doubled as an integer.
+ */
+static inline uint32_t incrementOfFrequency(float frequency, float cyclesPerHz) {
+  float cycles = frequency * cyclesPerHz;
+  cycles = cycles - ((float) (int32_t) cycles);
+  return ((uint32_t) (int32_t) (cycles * OSC_CYCLES_TO_HALF_PHASE)) << 1;
+}
+
+#if __AVX2__
+static inline __m256 cosineOfPhases(__m256i phases) {
+  __m256 p = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(phases, 8)),
+      _mm256_set1_ps(OSC_PHASE_TO_CYCLES));
+  __m256 u = _mm256_mul_ps(_mm256_sub_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f),
+      _mm256_sub_ps(p, _mm256_set1_ps(0.5f))), _mm256_set1_ps(0.25f)),
+      _mm256_set1_ps((float) (2.0 * M_PI)));
+  __m256 u2 = _mm256_mul_ps(u, u);
+  __m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(OSC_SIN_11), u2),
+      _mm256_set1_ps(OSC_SIN_9));
+  s = _mm256_add_ps(_mm256_mul_ps(s, u2), _mm256_set1_ps(OSC_SIN_7));
+  s = _mm256_add_ps(_mm256_mul_ps(s, u2), _mm256_set1_ps(OSC_SIN_5));
+  s = _mm256_add_ps(_mm256_mul_ps(s, u2), _mm256_set1_ps(OSC_SIN_3));
+  s = _mm256_add_ps(_mm256_mul_ps(s, u2), _mm256_set1_ps(1.0f));
+  return _mm256_mul_ps(u, s);
+}
+
+static inline __m256i incrementsOfFrequencies(__m256 frequencies, __m256 cyclesPerHz) {
+  __m256 cycles = _mm256_mul_ps(frequencies, cyclesPerHz);
+  cycles = _mm256_sub_ps(cycles, _mm256_cvtepi32_ps(_mm256_cvttps_epi32(cycles)));
+  return _mm256_slli_epi32(_mm256_cvttps_epi32(
+      _mm256_mul_ps(cycles, _mm256_set1_ps(OSC_CYCLES_TO_HALF_PHASE))), 1);
+}
+#elif __SSE2__
+static inline __m128 cosineOfPhases(__m128i phases) {
+  __m128 p = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(phases, 8)),
+      _mm_set1_ps(OSC_PHASE_TO_CYCLES));
+  __m128 u = _mm_mul_ps(_mm_sub_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f),
+      _mm_sub_ps(p, _mm_set1_ps(0.5f))), _mm_set1_ps(0.25f)),
+      _mm_set1_ps((float) (2.0 * M_PI)));
+  __m128 u2 = _mm_mul_ps(u, u);
+  __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(OSC_SIN_11), u2), _mm_set1_ps(OSC_SIN_9));
+  s = _mm_add_ps(_mm_mul_ps(s, u2), _mm_set1_ps(OSC_SIN_7));
+  s = _mm_add_ps(_mm_mul_ps(s, u2), _mm_set1_ps(OSC_SIN_5));
+  s = _mm_add_ps(_mm_mul_ps(s, u2), _mm_set1_ps(OSC_SIN_3));
+  s = _mm_add_ps(_mm_mul_ps(s, u2), _mm_set1_ps(1.0f));
+  return _mm_mul_ps(u, s);
+}
+
+static inline __m128i incrementsOfFrequencies(__m128 frequencies, __m128 cyclesPerHz) {
+  __m128 cycles = _mm_mul_ps(frequencies, cyclesPerHz);
+  cycles = _mm_sub_ps(cycles, _mm_cvtepi32_ps(_mm_cvttps_epi32(cycles)));
+  return _mm_slli_epi32(_mm_cvttps_epi32(
+      _mm_mul_ps(cycles, _mm_set1_ps(OSC_CYCLES_TO_HALF_PHASE))), 1);
+}
+#elif __ARM_NEON__
+static inline float32x4_t cosineOfPhases(uint32x4_t phases) {
+  float32x4_t p = vmulq_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(vshrq_n_u32(phases, 8))),
+      vdupq_n_f32(OSC_PHASE_TO_CYCLES));
+  float32x4_t u = vmulq_f32(vsubq_f32(vabsq_f32(vsubq_f32(p, vdupq_n_f32(0.5f))),
+      vdupq_n_f32(0.25f)), vdupq_n_f32((float) (2.0 * M_PI)));
+  float32x4_t u2 = vmulq_f32(u, u);
+  float32x4_t s = vaddq_f32(vmulq_f32(vdupq_n_f32(OSC_SIN_11), u2), vdupq_n_f32(OSC_SIN_9));
+  s = vaddq_f32(vmulq_f32(s, u2), vdupq_n_f32(OSC_SIN_7));
+  s = vaddq_f32(vmulq_f32(s, u2), vdupq_n_f32(OSC_SIN_5));
+  s = vaddq_f32(vmulq_f32(s, u2), vdupq_n_f32(OSC_SIN_3));
+  s = vaddq_f32(vmulq_f32(s, u2), vdupq_n_f32(1.0f));
+  return vmulq_f32(u, s);
+}
+
+static inline uint32x4_t incrementsOfFrequencies(float32x4_t frequencies, float32x4_t cyclesPerHz) {
+  float32x4_t cycles = vmulq_f32(frequencies, cyclesPerHz);
+  cycles = vsubq_f32(cycles, vcvtq_f32_s32(vcvtq_s32_f32(cycles)));
+  return vshlq_n_u32(vreinterpretq_u32_s32(vcvtq_s32_f32(
+      vmulq_f32(cycles, vdupq_n_f32(OSC_CYCLES_TO_HALF_PHASE)))), 1);
+}
+#endif
+
+/** Writes the cosine of the phase at a constant increment, and advances the phase. */
+static inline void processConstant(DspOscState *state, float *output, int fromIndex, int toIndex) {
+  uint32_t phase = state->phase;
+  const uint32_t inc = state->increment;
+  int i = fromIndex;
+  #if __AVX2__
+  if (toIndex - i >= 8) {
+    __m256i phases = _mm256_setr_epi32(phase, phase+inc, phase+2*inc, phase+3*inc,
+        phase+4*inc, phase+5*inc, phase+6*inc, phase+7*inc);
+    const __m256i step = _mm256_set1_epi32(8*inc);
+    for (; i+8 <= toIndex; i += 8) {
+      _mm256_storeu_ps(output+i, cosineOfPhases(phases));
+      phases = _mm256_add_epi32(phases, step);
+    }
+    phase += ((uint32_t) (i - fromIndex)) * inc;
+  }
+  #elif __SSE2__
+  if (toIndex - i >= 4) {
+    __m128i phases = _mm_setr_epi32(phase, phase+inc, phase+2*inc, phase+3*inc);
+    const __m128i step = _mm_set1_epi32(4*inc);
+    for (; i+4 <= toIndex; i += 4) {
+      _mm_storeu_ps(output+i, cosineOfPhases(phases));
+      phases = _mm_add_epi32(phases, step);
+    }
+    phase += ((uint32_t) (i - fromIndex)) * inc;
+  }
+  #elif __ARM_NEON__
+  if (toIndex - i >= 4) {
+    const uint32_t lanes[4] = {phase, phase+inc, phase+2*inc, phase+3*inc};
+    uint32x4_t phases = vld1q_u32(lanes);
+    const uint32x4_t step = vdupq_n_u32(4*inc);
+    for (; i+4 <= toIndex; i += 4) {
+      vst1q_f32((float32_t *) (output+i), cosineOfPhases(phases));
+      phases = vaddq_u32(phases, step);
+    }
+    phase += ((uint32_t) (i - fromIndex)) * inc;
+  }
+  #endif
+  for (; i < toIndex; i++) {
+    output[i] = cosineOfPhase(phase);
+    phase += inc;
+  }
+  state->phase = phase;
+}
 
 message::Object *DspOsc::new_object(pd::Message *init_message, PdGraph *graph) {
   return new DspOsc(init_message, graph);
 }
 
 DspOsc::DspOsc(pd::Message *init_message, PdGraph *graph) : DspObject(2, 2, 0, 1, graph) {
+  allocateHotState(sizeof(DspOscState)); // zeroed
   frequency = init_message->is_float(0) ? init_message->get_float(0) : 0.0f;
-  sampleStep = frequency * 65536.0f / graph->get_sample_rate();
-  #if __SSE3__
-  short step = (short) roundf(sampleStep);
-  inc = _mm_set_epi16(8*step, 8*step, 8*step, 8*step, 8*step, 8*step, 8*step, 8*step);
-  indicies = _mm_set_epi16(7*step, 6*step, 5*step, 4*step, 3*step, 2*step, step, 0);
-  #endif
-  
-  phase = 0.0f;
-  refCount++;
-  if (cos_table == NULL) {
-    cos_table = ALLOC_ALIGNED_BUFFER(65536 * sizeof(float));
-    for (int i = 0; i < 65536; i++) {
-      cos_table[i] = cosf(2.0f * M_PI * ((float) i) / 65536.0f);
-    }
-  }
-  
-  process_function = &processScalar;
-  process_functionNoMessage = &processScalar;
+  getState()->increment = exactIncrementOfFrequency(frequency, graph->get_sample_rate());
+  updateProcessFunction();
 }
 
 DspOsc::~DspOsc() {
-  if (--refCount == 0) {
-    FREE_ALIGNED_BUFFER(cos_table);
-    cos_table = NULL;
-  }
+  // nothing to do
 }
 
 void DspOsc::onInletConnectionUpdate(unsigned int inlet_index) {
-  // TODO(mhroth): support this with processSignal
+  updateProcessFunction();
+}
+
+void DspOsc::onBlockSizeUpdate(int block_size) {
+  DspObject::onBlockSizeUpdate(block_size);
+  updateProcessFunction();
+}
+
+void DspOsc::updateProcessFunction() {
+  if (incomingDspConnections[0].empty()) {
+    process_function = DSP_SELECT_BLOCK_FUNCTION(processScalarBlock, block_sizeInt, processScalar);
+  } else {
+    process_function = &processSignal;
+  }
+  process_functionNoMessage = process_function;
 }
 
 string DspOsc::toString() {
@@ -74,103 +221,88 @@ void DspOsc::process_message(int inlet_index, pd::Message *message) {
   switch (inlet_index) {
     case 0: { // update the frequency
       if (message->is_float(0)) {
-        frequency = fabsf(message->get_float(0));
-        sampleStep = frequency * 65536.0f / graph->get_sample_rate();
-        
-        #if __SSE3__
-        short step = (short) roundf(sampleStep);
-        inc = _mm_set_epi16(8*step, 8*step, 8*step, 8*step, 8*step, 8*step, 8*step, 8*step);
-        unsigned short currentIndex = _mm_extract_epi16(indicies,0);
-        indicies = _mm_set_epi16(7*step+currentIndex, 6*step+currentIndex, 5*step+currentIndex,
-            4*step+currentIndex, 3*step+currentIndex, 2*step+currentIndex, step+currentIndex, currentIndex);
-        #endif
+        frequency = message->get_float(0);
+        getState()->increment = exactIncrementOfFrequency(frequency, graph->get_sample_rate());
       }
       break;
     }
-    case 1: { // update the phase
-      // TODO(mhroth)
+    case 1: { // update the phase, in cycles
+      if (message->is_float(0)) {
+        double cycles = message->get_float(0);
+        getState()->phase = (uint32_t) (int64_t) ((cycles - floor(cycles)) * 4294967296.0);
+      }
       break;
     }
     default: break;
   }
 }
 
-void DspOsc::processScalar(DspObject *dspObject, int fromIndex, int toIndex) {
+void DspOsc::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
   DspOsc *d = reinterpret_cast<DspOsc *>(dspObject);
-  #if __SSE3__
-  /*
-   * Creates an array of unsigned short indicies (since the length of the cosine lookup table is
-   * of length 2^16. These indicies are incremented by a step size based on the desired frequency.
-   * As the indicies overflow during addition, they loop back around to zero.
-   */
-  float *output = d->dspBufferAtOutlet[0]+fromIndex;
-  __m128i inc = d->inc;
-  __m128i indicies = d->indicies;
-  int n = toIndex - fromIndex;
-  
-  unsigned short currentIndex = _mm_extract_epi16(indicies,0);
-  short step = _mm_extract_epi16(inc,0)/8;
-  
-  switch (fromIndex & 0x7) {
-    case 0: default: break;
-    case 1: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n; // allow fallthrough
-    case 2: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n;
-    case 3: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n;
-    case 4: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n;
-    case 5: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n;
-    case 6: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n;
-    case 7: {
-      *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n;
-      
-      d->indicies = _mm_set_epi16(7*step+currentIndex, 6*step+currentIndex, 5*step+currentIndex,
-          4*step+currentIndex, 3*step+currentIndex, 2*step+currentIndex, step+currentIndex, currentIndex);
-    }
+  DspOscState *state = d->getState();
+  float *input = d->dspBufferAtInlet[0];
+  float *output = d->dspBufferAtOutlet[0];
+  const float cyclesPerHz = 1.0f / d->graph->get_sample_rate();
+  uint32_t phase = state->phase;
+  int i = fromIndex;
+  // each sample is at the phase before its own increment is added, as in Pd
+  #if __AVX2__
+  const __m256 cyclesPerHzVector = _mm256_set1_ps(cyclesPerHz);
+  const __m256i highLane = _mm256_setr_epi32(0, 0, 0, 0, -1, -1, -1, -1);
+  for (; i+8 <= toIndex; i += 8) {
+    __m256i inc = incrementsOfFrequencies(_mm256_loadu_ps(input+i), cyclesPerHzVector);
+    // the running sum of the increments, within each half and then across them
+    __m256i sum = _mm256_add_epi32(inc, _mm256_slli_si256(inc, 4));
+    sum = _mm256_add_epi32(sum, _mm256_slli_si256(sum, 8));
+    sum = _mm256_add_epi32(sum, _mm256_and_si256(highLane,
+        _mm256_permutevar8x32_epi32(sum, _mm256_set1_epi32(3))));
+    __m256i phases = _mm256_add_epi32(_mm256_set1_epi32(phase), _mm256_sub_epi32(sum, inc));
+    _mm256_storeu_ps(output+i, cosineOfPhases(phases));
+    phase += (uint32_t) _mm256_extract_epi32(sum, 7);
   }
-  
-  int n4 = n & 0xFFFFFFF8; // we can process 8 indicies at a time
-  while (n4) {
-    __m128 values = _mm_set_ps(DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,3)],
-                               DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,2)],
-                               DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,1)],
-                               DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,0)]);
-    _mm_store_ps(output, values);
-    output += 4;
-    values = _mm_set_ps(DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,7)],
-                        DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,6)],
-                        DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,5)],
-                        DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,4)]);
-    _mm_store_ps(output, values);
-    indicies = _mm_add_epi16(indicies, inc);
-    output += 4;
-    n4 -= 8;
+  #elif __SSE2__
+  const __m128 cyclesPerHzVector = _mm_set1_ps(cyclesPerHz);
+  for (; i+4 <= toIndex; i += 4) {
+    __m128i inc = incrementsOfFrequencies(_mm_loadu_ps(input+i), cyclesPerHzVector);
+    __m128i sum = _mm_add_epi32(inc, _mm_slli_si128(inc, 4)); // the running sum of the increments
+    sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 8));
+    __m128i phases = _mm_add_epi32(_mm_set1_epi32(phase), _mm_sub_epi32(sum, inc));
+    _mm_storeu_ps(output+i, cosineOfPhases(phases));
+    phase += (uint32_t) _mm_cvtsi128_si32(_mm_shuffle_epi32(sum, 0xFF));
   }
-  
-  currentIndex = _mm_extract_epi16(indicies,0);
-  switch (n & 0x7) {
-    case 7: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; // allow fallthrough
-    case 6: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step;
-    case 5: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step;
-    case 4: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step;
-    case 3: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step;
-    case 2: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step;
-    case 1: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step;
-    default: {
-      // set the current index to the correct location, given that the step size is actually
-      // a real number, not an integer
-      // NOTE(mhroth): but doing this will cause clicks :-/ Osc will thus go out of phase over time
-      // Will anyone complain?
-//      d->currentIndex = currentIndex + ((short) ((d->sampleStep - floorf(d->sampleStep)) * n));
-      
-      if ((n & 0x7) == 0) {
-        d->indicies = indicies;
-      } else {
-        d->indicies = _mm_set_epi16(7*step+currentIndex, 6*step+currentIndex, 5*step+currentIndex,
-            4*step+currentIndex, 3*step+currentIndex, 2*step+currentIndex, step+currentIndex, currentIndex);        
-      }
-      break;
-    }
+  #elif __ARM_NEON__
+  const float32x4_t cyclesPerHzVector = vdupq_n_f32(cyclesPerHz);
+  const uint32x4_t zero = vdupq_n_u32(0);
+  for (; i+4 <= toIndex; i += 4) {
+    uint32x4_t inc = incrementsOfFrequencies(vld1q_f32((const float32_t *) (input+i)),
+        cyclesPerHzVector);
+    uint32x4_t sum = vaddq_u32(inc, vextq_u32(zero, inc, 3)); // the running sum of the increments
+    sum = vaddq_u32(sum, vextq_u32(zero, sum, 2));
+    uint32x4_t phases = vaddq_u32(vdupq_n_u32(phase), vsubq_u32(sum, inc));
+    vst1q_f32((float32_t *) (output+i), cosineOfPhases(phases));
+    phase += vgetq_lane_u32(sum, 3);
   }
-  #else
-  // TODO(mhroth):!!!
   #endif
+  for (; i < toIndex; i++) {
+    uint32_t inc = incrementOfFrequency(input[i], cyclesPerHz); // the output may be the input
+    output[i] = cosineOfPhase(phase);
+    phase += inc;
+  }
+  state->phase = phase;
+}
+
+void DspOsc::processScalar(DspObject *dspObject, int fromIndex, int toIndex) {
+  DspOsc *d = reinterpret_cast<DspOsc *>(dspObject);
+  processConstant(d->getState(), d->dspBufferAtOutlet[0], fromIndex, toIndex);
+}
+
+template <int N>
+void DspOsc::processScalarBlock(DspObject *dspObject, int fromIndex, int toIndex) {
+  // the whole block is processed with a constant trip count, which the compiler may unroll
+  DspOsc *d = reinterpret_cast<DspOsc *>(dspObject);
+  if (fromIndex == 0 && toIndex == N) {
+    processConstant(d->getState(), d->dspBufferAtOutlet[0], 0, N);
+  } else {
+    processConstant(d->getState(), d->dspBufferAtOutlet[0], fromIndex, toIndex);
+  }
 }
@@ -23,9 +23,23 @@
 #ifndef _DSP_OSC_H_
 #define _DSP_OSC_H_
 
+#include <stdint.h>
 #include "DspObject.h"
 
-/** [osc~], [osc~ float] */
+/**
+ * The phase of a <code>DspOsc</code>, kept as the hot state of the object. The phase is a fraction
+ * of a cycle in units of 2^-32, such that it wraps around by itself.
+ */
+typedef struct DspOscState {
+  uint32_t phase; // the phase of the next sample
+  uint32_t increment; // the phase increment per sample at the frequency set by message
+} DspOscState;
+
+/**
+ * [osc~], [osc~ float]. The cosine is evaluated with a polynomial for every sample, several
+ * samples at a time, rather than looked up in a table. The frequency may be given as a signal, and
+ * the phase is reset (in cycles) at the right inlet.
+ */
 class DspOsc : public DspObject {
   
   public:
@@ -37,22 +51,19 @@ class DspOsc : public DspObject {
     std::string toString();
   
     void onInletConnectionUpdate(unsigned int inlet_index);
+    void onBlockSizeUpdate(int block_size);
   
   private:
+    static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
     static void processScalar(DspObject *dspObject, int fromIndex, int toIndex);
+    template <int N> static void processScalarBlock(DspObject *dspObject, int fromIndex, int toIndex);
     void process_message(int inlet_index, PdMessage *message);
+
+    void updateProcessFunction();
   
-    float frequency; // frequency and phase are stored as integers because they are used
-    float sampleStep;
-    int phase;     // in for-loops to traverse the lookup table
-  
-    static float *cos_table; // the cosine lookup table
-    static int refCount; // a reference counter for cos_table. Now we know when to free it.
-  
-    #if __SSE3__
-    __m128i inc; // the amount by which to increment indicies every step
-    __m128i indicies; // the table lookup indicies
-    #endif
+    float frequency;
+
+    DspOscState *getState() { return reinterpret_cast<DspOscState *>(hotState); }
 };
 
 inline const char *DspOsc::get_object_label() {
@@ -29,28 +29,66 @@ message::Object *DspOutlet::new_object(pd::Message *init_message, PdGraph *graph
 }
 
 DspOutlet::DspOutlet(PdGraph *graph) : DspObject(0, 1, 0, 1, graph) {
-  // nothing to do
+  accumulationBuffer = NULL;
+  parentBuffer = NULL;
+  stepSize = block_sizeInt;
 }
 
 DspOutlet::~DspOutlet() {
-  // nothing to do
+  FREE_ALIGNED_BUFFER(accumulationBuffer);
+  FREE_ALIGNED_BUFFER(parentBuffer);
 }
 
 float *DspOutlet::get_dsp_buffer_at_outlet(int outlet_index) {
+  if (parentBuffer != NULL) return parentBuffer;
   return (dspBufferAtInlet[0] == NULL) ? graph->get_buffer_pool()->get_zero_buffer() : dspBufferAtInlet[0];
 }
 
 void DspOutlet::set_dsp_buffer_at_inlet(float *buffer, unsigned int inlet_index) {
   DspObject::set_dsp_buffer_at_inlet(buffer, inlet_index);
+
+  // the parent reads from the parent buffer, which does not change
+  if (parentBuffer != NULL) return;
   
   // additionally reserve buffer to account for outgoing connections
   graph->get_buffer_pool()->reserveBuffer(buffer, outgoingDspConnections[0].size());
   
   // when the dsp buffer updates at a given inlet, inform all receiving objects
-  list<Connection> dspConnections = outgoingDspConnections[0];
-  for (list<Connection>::iterator it = dspConnections.begin(); it != dspConnections.end(); ++it) {
+  ConnectionSpan dspConnections = outgoingDspConnections[0];
+  for (ConnectionSpan::iterator it = dspConnections.begin(); it != dspConnections.end(); ++it) {
     Connection letPair = *it;
     DspObject *dspObject = reinterpret_cast<DspObject *>(letPair.first);
     dspObject->set_dsp_buffer_at_inlet(dspBufferAtInlet[0], letPair.second);
   }
 }
+
+
+#pragma mark - Reblocking
+
+void DspOutlet::setReblocking(bool isReblocked, int parentBlockSize, int stepSize) {
+  FREE_ALIGNED_BUFFER(accumulationBuffer);
+  FREE_ALIGNED_BUFFER(parentBuffer);
+  accumulationBuffer = NULL;
+  parentBuffer = NULL;
+  this->stepSize = stepSize;
+  if (!isReblocked) return;
+
+  accumulationBuffer = ALLOC_ALIGNED_BUFFER(block_sizeInt * sizeof(float));
+  memset(accumulationBuffer, 0, block_sizeInt * sizeof(float));
+  parentBuffer = ALLOC_ALIGNED_BUFFER(parentBlockSize * sizeof(float));
+  memset(parentBuffer, 0, parentBlockSize * sizeof(float));
+  process_function = &processAccumulate;
+  process_functionNoMessage = &processAccumulate;
+}
+
+void DspOutlet::processAccumulate(DspObject *dspObject, int fromIndex, int toIndex) {
+  DspOutlet *d = reinterpret_cast<DspOutlet *>(dspObject);
+  ArrayArithmetic::add(d->accumulationBuffer, d->dspBufferAtInlet[0], d->accumulationBuffer, 0, toIndex);
+}
+
+void DspOutlet::emitSamples(int parentIndex) {
+  memcpy(parentBuffer + parentIndex, accumulationBuffer, stepSize * sizeof(float));
+  int numRemainingSamples = block_sizeInt - stepSize;
+  memmove(accumulationBuffer, accumulationBuffer + stepSize, numRemainingSamples * sizeof(float));
+  memset(accumulationBuffer + numRemainingSamples, 0, stepSize * sizeof(float));
+}
@@ -48,13 +48,43 @@ class DspOutlet : public DspObject {
 
     bool isLeafNode();
   
-    // [outlet~] does nothing with audio
     bool doesProcessAudio();
   
     float *get_dsp_buffer_at_outlet(int outlet_index);
   
     void set_dsp_buffer_at_inlet(float *buffer, unsigned int inlet_index);
     bool canSetBufferAtOutlet(unsigned int outlet_index);
+
+    /**
+     * Sets the buffer which is passed through without informing the connected objects, which
+     * already read it. Used by the <code>DspPlan</code> after it has moved the signal to another buffer.
+     */
+    void setPassThroughBuffer(float *buffer) { dspBufferAtInlet[0] = buffer; }
+
+    /**
+     * Configures the outlet for a graph whose block size differs from that of its parent, or which
+     * overlaps its blocks. Each local block is then added into an accumulator, from which
+     * <code>stepSize</code> samples are passed to the parent at a time. If the graph is not
+     * reblocked then the local buffer is passed through.
+     */
+    void setReblocking(bool isReblocked, int parentBlockSize, int stepSize);
+
+    /**
+     * Moves the oldest <code>stepSize</code> samples of the accumulator into the parent buffer,
+     * starting at the given index.
+     */
+    void emitSamples(int parentIndex);
+
+  private:
+    static void processAccumulate(DspObject *dspObject, int fromIndex, int toIndex);
+
+    /** The overlapped sum of all local blocks. NULL unless the graph is reblocked. */
+    float *accumulationBuffer;
+
+    /** The buffer from which the parent graph reads. */
+    float *parentBuffer;
+
+    int stepSize;
 };
 
 inline const char *DspOutlet::get_object_label() {
@@ -70,7 +100,8 @@ inline bool DspOutlet::isLeafNode() {
 }
   
 inline bool DspOutlet::doesProcessAudio() {
-  return false;
+  // the outlet only processes audio if it must accumulate the local blocks
+  return (accumulationBuffer != NULL);
 }
 
 inline std::string DspOutlet::toString() {
@@ -29,7 +29,8 @@ message::Object *DspPhasor::new_object(pd::Message *init_message, PdGraph *graph
   return new DspPhasor(init_message, graph);
 }
 
-DspPhasor::DspPhasor(pd::Message *init_message, PdGraph *graph) : DspObject(2, 2, 0, 1, graph) {  
+DspPhasor::DspPhasor(pd::Message *init_message, PdGraph *graph) : DspObject(2, 2, 0, 1, graph) {
+  allocateHotState(sizeof(DspPhasorState));
   pd::Message *message = PD_MESSAGE_ON_STACK(1);
   message->from_timestamp_and_float(0.0, init_message->is_float(0) ? init_message->get_float(0) : 0.0f);
   process_message(0, message);
@@ -60,7 +61,7 @@ void DspPhasor::process_message(int inlet_index, pd::Message *message) {
         #if __SSE3__
         float sampleStep = frequency * 65536.0f / graph->get_sample_rate();
         short s = (short) sampleStep; // signed as step size may be negative as well!
-        inc = _mm_set1_pi16(4*s);
+        getState()->inc = _mm_set1_pi16(4*s);
         #endif // __SSE3__
       }
       break;
@@ -77,9 +78,10 @@ void DspPhasor::process_message(int inlet_index, pd::Message *message) {
 void DspPhasor::processSignal(DspObject *dspObject, int fromIndex, int n4) {
   DspPhasor *d = reinterpret_cast<DspPhasor *>(dspObject);
   #if __SSE3__
+  DspPhasorState *state = d->getState();
   float *input = d->dspBufferAtInlet[0];
   float *output = d->dspBufferAtOutlet[0];
-  __m64 indicies = d->indicies;
+  __m64 indicies = state->indicies;
   static __m128 constVec = _mm_set1_ps(SHORT_TO_FLOAT_RATIO);
   static __m128 sampVec = _mm_set1_ps(65536.0f/d->graph->get_sample_rate());
 
@@ -101,7 +103,7 @@ void DspPhasor::processSignal(DspObject *dspObject, int fromIndex, int n4) {
     n4 -= 4;
   }
   
-  d->indicies = indicies;
+  state->indicies = indicies;
   
   #else
   // TODO(mhroth):!!!
@@ -112,6 +114,7 @@ void DspPhasor::processSignal(DspObject *dspObject, int fromIndex, int n4) {
 void DspPhasor::processScalar(DspObject *dspObject, int fromIndex, int toIndex) {
   DspPhasor *d = reinterpret_cast<DspPhasor *>(dspObject);
   #if __SSE3__
+  DspPhasorState *state = d->getState();
   /*
    * Creates an array of unsigned short indicies (since the length of the cosine lookup table is
    * of length 2^16. These indicies are incremented by a step size based on the desired frequency.
@@ -119,7 +122,7 @@ void DspPhasor::processScalar(DspObject *dspObject, int fromIndex, int toIndex)
    */
   int n = toIndex - fromIndex;
   float *output = d->dspBufferAtOutlet[0]+fromIndex;
-  __m64 inc = d->inc;
+  __m64 inc = state->inc;
   short s = _mm_extract_pi16(inc,0) >> 2; // == / 4 in order to recover original step size
   static __m128 constVec = _mm_set1_ps(SHORT_TO_FLOAT_RATIO);
   unsigned short idx;
@@ -128,7 +131,7 @@ void DspPhasor::processScalar(DspObject *dspObject, int fromIndex, int toIndex)
   __m64 indicies;
   switch (fromIndex & 0x3) {
     case 1: {
-      idx = _mm_extract_pi16(d->indicies,0); // get current index
+      idx = _mm_extract_pi16(state->indicies,0); // get current index
       *output++ = ((float) idx) * SHORT_TO_FLOAT_RATIO; idx += s; --n;
     }
     case 2: *output++ = ((float) idx) * SHORT_TO_FLOAT_RATIO; idx += s; --n;
@@ -137,7 +140,7 @@ void DspPhasor::processScalar(DspObject *dspObject, int fromIndex, int toIndex)
       indicies = _mm_set_pi16(idx+3*s, idx+2*s, idx+s, idx);
       break;
     }
-    default: indicies = d->indicies; break;
+    default: indicies = state->indicies; break;
   }
   
   // compute as many 4-tuples as possible
@@ -153,16 +156,16 @@ void DspPhasor::processScalar(DspObject *dspObject, int fromIndex, int toIndex)
   // finish the remaining (up to 3) samples
   switch (n & 0x3) {
     case 3: {
-      idx = _mm_extract_pi16(d->indicies,3);
+      idx = _mm_extract_pi16(state->indicies,3);
       *output++ = ((float) idx) * SHORT_TO_FLOAT_RATIO; idx += s;
     }
     case 2: *output++ = ((float) idx) * SHORT_TO_FLOAT_RATIO; idx += s;
     case 1: {
       *output++ = ((float) idx) * SHORT_TO_FLOAT_RATIO; idx += s;
-      d->indicies = _mm_set_pi16(idx+3*s, idx+2*s, idx+s, idx);
+      state->indicies = _mm_set_pi16(idx+3*s, idx+2*s, idx+s, idx);
       break;
     }
-    default: d->indicies = indicies; break;
+    default: state->indicies = indicies; break;
     // set the current index to the correct location, given that the step size is actually
     // a real number, not an integer
     // NOTE(mhroth): but doing this will cause clicks :-/ Osc will thus go out of phase over time
@@ -25,6 +25,14 @@
 
 #include "DspObject.h"
 
+/** The phase of a <code>DspPhasor</code>, kept as the hot state of the object. */
+typedef struct DspPhasorState {
+  #if __SSE3__
+  __m64 inc; // the amount by which to increment indicies every step
+  __m64 indicies; // the table lookup indicies
+  #endif
+} DspPhasorState;
+
 /** [phasor~], [phasor~ float] */
 class DspPhasor : public DspObject {
 
@@ -42,12 +50,9 @@ class DspPhasor : public DspObject {
     static void processScalar(DspObject *dspObject, int fromIndex, int toIndex);
     void process_message(int inlet_index, PdMessage *message);
   
+    DspPhasorState *getState() { return reinterpret_cast<DspPhasorState *>(hotState); }
+
     float frequency;
-  
-    #if __SSE3__
-    __m64 inc; // the amount by which to increment indicies every step
-    __m64 indicies; // the table lookup indicies
-    #endif
 };
 
 inline const char *DspPhasor::get_object_label() {
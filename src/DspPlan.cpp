@@ -0,0 +1,945 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <set>
+#include "BufferPool.h"
+#include "DspInlet.h"
+#include "DspObject.h"
+#include "DspOutlet.h"
+#include "DspPlan.h"
+#include "DspSend.h"
+#include "ObjectArena.h"
+#include "PdGraph.h"
+
+// a signal written to a pool buffer, from the record which writes it until its last reader
+typedef struct DspBufferInterval {
+  unsigned int handle;
+  unsigned int start;
+  unsigned int end;
+  float *buffer; // the newly assigned buffer
+} DspBufferInterval;
+
+// orders intervals by the record at which they end
+class DspBufferIntervalEndComparator {
+  public:
+    DspBufferIntervalEndComparator(vector<DspBufferInterval> *intervals) : intervals(intervals) {}
+    bool operator()(unsigned int a, unsigned int b) { return (*intervals)[a].end < (*intervals)[b].end; }
+  private:
+    vector<DspBufferInterval> *intervals;
+};
+
+// orders intervals by the record at which they begin
+class DspBufferIntervalStartComparator {
+  public:
+    DspBufferIntervalStartComparator(vector<DspBufferInterval> *intervals) : intervals(intervals) {}
+    bool operator()(unsigned int a, unsigned int b) { return (*intervals)[a].start < (*intervals)[b].start; }
+  private:
+    vector<DspBufferInterval> *intervals;
+};
+
+// processes several objects of the same kind at once (see DspObject::processFunctionBatch)
+typedef void (*DspBatchFunction)(DspObject **dspObjects, int numObjects, int fromIndex, int toIndex);
+
+// the signals (intervals) read and written by one record, and the records which must precede it
+typedef struct DspRecordSignals {
+  vector<unsigned int> reads;
+  vector<unsigned int> writes;
+  vector<unsigned int> predecessors;
+  bool isInPlace;
+} DspRecordSignals;
+
+/**
+ * Returns the largest number of movable signals which are live at the same time if the records
+ * are executed in the given order, counted as assignBuffers() colours them.
+ */
+static unsigned int countLiveSignals(const vector<unsigned int> &order,
+    const vector<DspRecordSignals> &records, const vector<unsigned int> &numReaders,
+    const vector<unsigned char> &isMovable) {
+  vector<unsigned int> numRemainingReaders(numReaders);
+  int numLive = 0;
+  int maxLive = 0;
+  for (unsigned int o = 0; o < order.size(); o++) {
+    const DspRecordSignals *r = &records[order[o]];
+    int numEnding = 0;
+    for (unsigned int k = 0; k < r->reads.size(); k++) {
+      if (isMovable[r->reads[k]] && --numRemainingReaders[r->reads[k]] == 0) numEnding++;
+    }
+    if (r->isInPlace) numLive -= numEnding;
+    int numUnread = 0;
+    for (unsigned int k = 0; k < r->writes.size(); k++) {
+      if (!isMovable[r->writes[k]]) continue;
+      numLive++;
+      if (numReaders[r->writes[k]] == 0) numUnread++;
+    }
+    maxLive = max(maxLive, numLive);
+    numLive -= numUnread;
+    if (!r->isInPlace) numLive -= numEnding;
+  }
+  return (unsigned int) maxLive;
+}
+
+/**
+ * Groups the records of the run [start, end) of the given order which can be processed as a
+ * batch. The records keep their order wherever they can, but a record which may join a batch is
+ * held back while anything else is ready, such that the other records of its kind can become ready
+ * too. The length of each batch is set at its first position.
+ */
+static void batchRun(vector<unsigned int> *order, vector<unsigned int> *batchLengths,
+    unsigned int start, unsigned int end, const vector<DspRecordSignals> &records,
+    const vector<DspPlanNode> &nodes) {
+  // the remaining records of each kind. A kind of which only one record remains is not held back.
+  map<DspBatchFunction, unsigned int> numRemaining;
+  for (unsigned int o = start; o < end; o++) {
+    DspBatchFunction batchFunction = nodes[(*order)[o]].dspObject->process_functionBatch;
+    if (batchFunction != NULL) numRemaining[batchFunction]++;
+  }
+  if (numRemaining.empty()) return;
+
+  // the priority of each record is its position in the order so far
+  vector<unsigned int> priorities(end-start);
+  for (unsigned int o = start; o < end; o++) priorities[(*order)[o]-start] = o;
+  vector<unsigned int> numPending(end-start, 0);
+  vector<vector<unsigned int> > runSuccessors(end-start);
+  vector<unsigned int> ready;
+  for (unsigned int m = start; m < end; m++) {
+    const vector<unsigned int> &p = records[m].predecessors;
+    for (unsigned int q = 0; q < p.size(); q++) {
+      if (p[q] >= start && p[q] != m) {
+        numPending[m-start]++;
+        runSuccessors[p[q]-start].push_back(m);
+      }
+    }
+    if (numPending[m-start] == 0) ready.push_back(m);
+  }
+
+  unsigned int o = start;
+  while (!ready.empty()) {
+    // the first record which is not held back, or else the first record
+    int best = -1;
+    int first = 0;
+    for (unsigned int c = 0; c < ready.size(); c++) {
+      if (priorities[ready[c]-start] < priorities[ready[first]-start]) first = c;
+      DspBatchFunction batchFunction = nodes[ready[c]].dspObject->process_functionBatch;
+      if ((batchFunction == NULL || numRemaining[batchFunction] < 2) &&
+          (best < 0 || priorities[ready[c]-start] < priorities[ready[best]-start])) {
+        best = c;
+      }
+    }
+    vector<unsigned int> batch(1, ready[(best < 0) ? first : best]);
+    if (best < 0) {
+      // every ready record of the same kind and range joins the first
+      const DspPlanNode *head = &nodes[batch[0]];
+      for (unsigned int c = 0; c < ready.size(); c++) {
+        const DspPlanNode *n = &nodes[ready[c]];
+        if (ready[c] != batch[0] &&
+            n->dspObject->process_functionBatch == head->dspObject->process_functionBatch &&
+            n->fromIndex == head->fromIndex && n->toIndex == head->toIndex) {
+          batch.push_back(ready[c]);
+        }
+      }
+    }
+
+    (*batchLengths)[o] = batch.size();
+    for (unsigned int k = 0; k < batch.size(); k++) {
+      unsigned int m = batch[k];
+      ready.erase(find(ready.begin(), ready.end(), m));
+      DspBatchFunction batchFunction = nodes[m].dspObject->process_functionBatch;
+      if (batchFunction != NULL) numRemaining[batchFunction]--;
+      (*order)[o++] = m;
+      for (unsigned int q = 0; q < runSuccessors[m-start].size(); q++) {
+        unsigned int successor = runSuccessors[m-start][q];
+        if (--numPending[successor-start] == 0) ready.push_back(successor);
+      }
+    }
+  }
+}
+
+DspPlan::DspPlan() {
+  nodes = vector<DspPlanNode>();
+  isReordering = false;
+  numLiveBuffersBefore = 0;
+  numLiveBuffersAfter = 0;
+}
+
+DspPlan::~DspPlan() {
+  // nothing to do, the plan does not own any of the objects that it refers to
+}
+
+void DspPlan::clear() {
+  nodes.clear();
+  nodeIndices.clear();
+  buffers.clear();
+  isBufferSilent.clear();
+  nodeBuffers.clear();
+  numPredecessors.clear();
+  successorOffsets.clear();
+  successors.clear();
+  bypassableSends.clear();
+}
+
+void DspPlan::compile(PdGraph *graph) {
+  clear();
+  appendGraph(graph);
+  restoreAliasedInlets();
+  assignBuffers(graph->get_buffer_pool());
+  indexBuffers(graph->get_buffer_pool()->get_zero_buffer());
+  computeDependencies();
+
+  // the state of the objects is laid out in the order in which the plan walks them
+  vector<DspObject *> dspObjects;
+  for (unsigned int i = 0; i < nodes.size(); i++) {
+    if (nodes[i].graph == NULL) dspObjects.push_back(nodes[i].dspObject);
+  }
+  graph->get_object_arena()->compactHotState(dspObjects);
+}
+
+void DspPlan::appendGraph(PdGraph *graph) {
+  const list<DspObject *> &dspNodeList = graph->get_dsp_node_list();
+  for (list<DspObject *>::const_iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
+    DspObject *dspObject = *it;
+    if (dspObject->get_object_type() == object::Type::PURE_DATA &&
+        !reinterpret_cast<PdGraph *>(dspObject)->is_reblocked()) {
+      // subgraphs are inlined into the plan behind a guard record, such that the switch~ state of
+      // the subgraph is still respected without calling PdGraph::processGraph()
+      PdGraph *subgraph = reinterpret_cast<PdGraph *>(dspObject);
+      unsigned int guardIndex = nodes.size();
+      DspPlanNode guard = {dspObject, subgraph, 0, subgraph->get_block_size(), 0, true, false, 0, 0, 0, false, 1};
+      nodes.push_back(guard);
+      appendGraph(subgraph);
+      nodes[guardIndex].skipIndex = nodes.size();
+    } else {
+      // reblocked subgraphs process any number of local blocks per block of their parent, and so
+      // are executed as a single record through PdGraph::processGraph()
+      DspPlanNode node = {dspObject, NULL, 0, graph->get_block_size(), 0, true, false, 0, 0, 0, false, 1};
+      nodeIndices[dspObject] = nodes.size();
+      nodes.push_back(node);
+    }
+  }
+}
+
+void DspPlan::assignBuffers(BufferPool *bufferPool) {
+  const unsigned int numHandles = bufferPool->getNumTotalBuffers();
+  const unsigned int numNodes = nodes.size();
+  numLiveBuffersBefore = 0;
+  numLiveBuffersAfter = 0;
+  if (numHandles == 0) return;
+
+  // find the live interval of every signal. The interval of each inlet and outlet of each record
+  // is listed in the order of indexBuffers(), or -1 if the buffer is not from the pool.
+  vector<DspBufferInterval> intervals;
+  vector<int> slotIntervals;
+  vector<int> currentInterval(numHandles, -1);
+  vector<unsigned char> isPinned(numHandles, 0);
+  vector<unsigned char> isUsed(numHandles, 0);
+
+  // The signal read by each send~, by the buffer of the send~ (which is read by its receive~s),
+  // and then by the buffer at the outlet of each receive~ which follows its send~. Readers of a
+  // receive~ are made to read the signal at the send~ directly, extending its interval.
+  map<float *, int> sendIntervals;
+  map<float *, int> receiveIntervals;
+  vector<DspAliasedInlet> aliasCandidates;
+  vector<int> aliasCandidateIntervals;
+
+  // The inlet~s and outlet~s of inlined subgraphs are not records, but they hold the signal which
+  // they pass on at the beginning and the end of the records of their subgraph respectively. They
+  // follow the signal when it is moved, such that they agree with the objects that they connect.
+  vector<vector<DspObject *> > passThroughsAt(numNodes+1);
+  for (unsigned int i = 0; i < numNodes; i++) {
+    if (nodes[i].graph == NULL) continue;
+    vector<DspObject *> dspOutlets;
+    nodes[i].graph->get_dsp_lets(&passThroughsAt[i], &dspOutlets);
+    vector<DspObject *> *atEnd = &passThroughsAt[nodes[i].skipIndex];
+    atEnd->insert(atEnd->end(), dspOutlets.begin(), dspOutlets.end());
+  }
+  vector<DspObject *> passThroughs;
+  vector<int> passThroughIntervals;
+
+  for (unsigned int i = 0; i <= numNodes; i++) {
+    for (unsigned int j = 0; j < passThroughsAt[i].size(); j++) {
+      DspObject *dspObject = passThroughsAt[i][j];
+      int handle = bufferPool->getHandle(dspObject->get_dsp_buffer_at_inlet(0));
+      if (handle >= 0 && currentInterval[handle] >= 0) {
+        passThroughs.push_back(dspObject);
+        passThroughIntervals.push_back(currentInterval[handle]);
+      }
+    }
+    if (i == numNodes) break;
+
+    DspPlanNode *n = &nodes[i];
+    if (n->graph != NULL) continue;
+    DspObject *dspObject = n->dspObject;
+    object::Type type = dspObject->get_object_type();
+    bool isGraph = (type == object::Type::PURE_DATA);
+
+    for (unsigned int j = 0; j < dspObject->getNumDspInlets(); j++) {
+      float *buffer = dspObject->get_dsp_buffer_at_inlet(j);
+      int handle = bufferPool->getHandle(buffer);
+      if (handle >= 0) {
+        isUsed[handle] = 1;
+        if (isGraph || currentInterval[handle] < 0) {
+          // the contents of the buffer come from outside of the plan
+          isPinned[handle] = 1;
+        } else {
+          intervals[currentInterval[handle]].end = i;
+        }
+        slotIntervals.push_back(currentInterval[handle]);
+      } else if (!isGraph && receiveIntervals.find(buffer) != receiveIntervals.end()) {
+        // subgraphs are left reading the receive~, which then keeps copying
+        int k = receiveIntervals[buffer];
+        intervals[k].end = i;
+        DspAliasedInlet alias = {dspObject, j, buffer, NULL};
+        aliasCandidates.push_back(alias);
+        aliasCandidateIntervals.push_back(k);
+        slotIntervals.push_back(k);
+      } else {
+        slotIntervals.push_back(-1);
+      }
+    }
+
+    if (type == object::Type::DSP_SEND && dspObject->getNumDspInlets() > 0 && slotIntervals.back() >= 0) {
+      sendIntervals[dspObject->get_dsp_buffer_at_outlet(0)] = slotIntervals.back();
+    } else if (type == object::Type::DSP_RECEIVE) {
+      // receive~ has no dsp inlets, its inlet buffer is set to that of its send~
+      map<float *, int>::iterator it = sendIntervals.find(dspObject->get_dsp_buffer_at_inlet(0));
+      if (it != sendIntervals.end()) receiveIntervals[dspObject->get_dsp_buffer_at_outlet(0)] = it->second;
+    }
+
+    for (unsigned int j = 0; j < dspObject->getNumDspOutlets(); j++) {
+      int handle = bufferPool->getHandle(dspObject->get_dsp_buffer_at_outlet(j));
+      if (handle >= 0) {
+        isUsed[handle] = 1;
+        if (isGraph || !dspObject->canSetBufferAtOutlet(j)) isPinned[handle] = 1;
+        DspBufferInterval interval = {(unsigned int) handle, i, i, NULL};
+        currentInterval[handle] = intervals.size();
+        intervals.push_back(interval);
+      }
+      slotIntervals.push_back((handle < 0) ? -1 : currentInterval[handle]);
+    }
+  }
+
+  reorderForLocality(&intervals, &slotIntervals, isPinned);
+
+  // all buffers which are used only by movable signals are available to the colouring
+  vector<float *> availableBuffers;
+  for (int h = numHandles-1; h >= 0; h--) {
+    if (isUsed[h] && !isPinned[h]) availableBuffers.push_back(bufferPool->getBufferWithHandle(h));
+  }
+
+  vector<unsigned int> endOrder;
+  for (unsigned int k = 0; k < intervals.size(); k++) {
+    if (!isPinned[intervals[k].handle]) endOrder.push_back(k);
+  }
+  stable_sort(endOrder.begin(), endOrder.end(), DspBufferIntervalEndComparator(&intervals));
+  vector<unsigned int> startOrder(intervals.size());
+  for (unsigned int k = 0; k < intervals.size(); k++) startOrder[k] = k;
+  stable_sort(startOrder.begin(), startOrder.end(), DspBufferIntervalStartComparator(&intervals));
+
+  // Intervals are coloured in the order of the record at which they start. The buffers of signals which
+  // are last read by a record may be written by that same record if it can process in place, as
+  // with the greedy assignment. Otherwise they only become available after its outlets are assigned.
+  unsigned int e = 0;
+  unsigned int k = 0;
+  vector<float *> endingBuffers;
+  for (unsigned int i = 0; i < numNodes; i++) {
+    bool isInPlace = (nodes[i].graph == NULL) && nodes[i].dspObject->canProcessInPlace();
+    endingBuffers.clear();
+    while (e < endOrder.size() && intervals[endOrder[e]].end <= i) {
+      DspBufferInterval *interval = &intervals[endOrder[e++]];
+      if (interval->start < i) {
+        if (isInPlace || interval->end < i) {
+          availableBuffers.push_back(interval->buffer);
+        } else {
+          endingBuffers.push_back(interval->buffer);
+        }
+      }
+    }
+    unsigned int firstStarting = k;
+    for (; k < startOrder.size() && intervals[startOrder[k]].start == i; k++) {
+      DspBufferInterval *interval = &intervals[startOrder[k]];
+      if (isPinned[interval->handle]) continue;
+      if (availableBuffers.empty()) {
+        // the existing assignment is a colouring, so this is only reached if the plan was
+        // reordered into an order which needs more buffers at once
+        interval->buffer = bufferPool->getNewBuffer();
+      } else {
+        interval->buffer = availableBuffers.back();
+        availableBuffers.pop_back();
+      }
+    }
+    availableBuffers.insert(availableBuffers.end(), endingBuffers.begin(), endingBuffers.end());
+
+    // signals which are never read are only live while they are written
+    for (unsigned int m = firstStarting; m < k; m++) {
+      DspBufferInterval *interval = &intervals[startOrder[m]];
+      if (!isPinned[interval->handle] && interval->end == i) {
+        availableBuffers.push_back(interval->buffer);
+      }
+    }
+  }
+
+  // apply the new assignment
+  unsigned int slot = 0;
+  for (unsigned int i = 0; i < numNodes; i++) {
+    DspPlanNode *n = &nodes[i];
+    if (n->graph != NULL) continue;
+    DspObject *dspObject = n->dspObject;
+    for (unsigned int j = 0; j < dspObject->getNumDspInlets(); j++, slot++) {
+      int k = slotIntervals[slot];
+      if (k >= 0 && !isPinned[intervals[k].handle]) {
+        dspObject->set_dsp_buffer_at_inlet(intervals[k].buffer, j);
+      }
+    }
+    for (unsigned int j = 0; j < dspObject->getNumDspOutlets(); j++, slot++) {
+      int k = slotIntervals[slot];
+      if (k >= 0 && !isPinned[intervals[k].handle]) {
+        dspObject->setDspBufferAtOutlet(intervals[k].buffer, j);
+      }
+    }
+  }
+
+  for (unsigned int p = 0; p < passThroughs.size(); p++) {
+    DspBufferInterval *interval = &intervals[passThroughIntervals[p]];
+    if (isPinned[interval->handle]) continue;
+    if (passThroughs[p]->get_object_type() == object::Type::DSP_INLET) {
+      reinterpret_cast<DspInlet *>(passThroughs[p])->setPassThroughBuffer(interval->buffer);
+    } else {
+      reinterpret_cast<DspOutlet *>(passThroughs[p])->setPassThroughBuffer(interval->buffer);
+    }
+  }
+
+  // readers of a receive~ whose send~ signal is pinned are left where they are
+  for (unsigned int a = 0; a < aliasCandidates.size(); a++) {
+    DspBufferInterval *interval = &intervals[aliasCandidateIntervals[a]];
+    if (isPinned[interval->handle]) continue;
+    aliasCandidates[a].sendBuffer = interval->buffer;
+    aliasedInlets.push_back(aliasCandidates[a]);
+  }
+}
+
+void DspPlan::reorderForLocality(vector<DspBufferInterval> *intervals, vector<int> *slotIntervals,
+    const vector<unsigned char> &isPinned) {
+  const unsigned int numNodes = nodes.size();
+  const unsigned int numIntervals = intervals->size();
+
+  // Find the signals read and written by each record, and the records which it must follow. A
+  // record follows the writers of the signals that it reads. Buffers which are not reassigned by
+  // the colouring (pinned or not from the pool) also keep the order of their reads and writes.
+  vector<DspRecordSignals> records(numNodes);
+  vector<unsigned int> slotOffsets(numNodes+1, 0);
+  vector<unsigned int> numReaders(numIntervals, 0);
+  vector<unsigned char> isMovable(numIntervals, 0);
+  for (unsigned int k = 0; k < numIntervals; k++) isMovable[k] = !isPinned[(*intervals)[k].handle];
+  map<float *, unsigned int> lastWriters;
+  map<float *, vector<unsigned int> > readersSinceWrite;
+  unsigned int slot = 0;
+  for (unsigned int i = 0; i < numNodes; i++) {
+    slotOffsets[i] = slot;
+    if (nodes[i].graph != NULL) continue;
+    DspObject *dspObject = nodes[i].dspObject;
+    DspRecordSignals *r = &records[i];
+    r->isInPlace = dspObject->canProcessInPlace();
+    for (unsigned int j = 0; j < dspObject->getNumDspInlets(); j++, slot++) {
+      int k = (*slotIntervals)[slot];
+      if (k >= 0 && find(r->reads.begin(), r->reads.end(), (unsigned int) k) == r->reads.end()) {
+        r->reads.push_back(k);
+        r->predecessors.push_back((*intervals)[k].start);
+        numReaders[k]++;
+      }
+      if (k < 0 || !isMovable[k]) {
+        float *buffer = dspObject->get_dsp_buffer_at_inlet(j);
+        map<float *, unsigned int>::iterator it = lastWriters.find(buffer);
+        if (it != lastWriters.end()) r->predecessors.push_back(it->second);
+        readersSinceWrite[buffer].push_back(i);
+      }
+    }
+    for (unsigned int j = 0; j < dspObject->getNumDspOutlets(); j++, slot++) {
+      int k = (*slotIntervals)[slot];
+      if (k >= 0) r->writes.push_back(k);
+      float *buffer = dspObject->get_dsp_buffer_at_outlet(j);
+      if ((k < 0 || !isMovable[k]) && buffer != NULL) {
+        map<float *, unsigned int>::iterator it = lastWriters.find(buffer);
+        if (it != lastWriters.end()) r->predecessors.push_back(it->second);
+        vector<unsigned int> *readers = &readersSinceWrite[buffer];
+        r->predecessors.insert(r->predecessors.end(), readers->begin(), readers->end());
+        readers->clear();
+        lastWriters[buffer] = i;
+      }
+    }
+  }
+  slotOffsets[numNodes] = slot;
+
+  vector<unsigned int> order(numNodes);
+  for (unsigned int i = 0; i < numNodes; i++) order[i] = i;
+  numLiveBuffersBefore = countLiveSignals(order, records, numReaders, isMovable);
+  numLiveBuffersAfter = numLiveBuffersBefore;
+  if (!isReordering) return;
+
+  // Records only move within runs of parallel safe records, between guards, barriers and the ends
+  // of subgraphs. Each run is list scheduled: of the records whose predecessors have all been
+  // placed, the next is the one which ends the most signals less the signals that it begins. Ties
+  // go to the record which reads the most recently written signal, while it is still in the cache,
+  // and then to the original order.
+  vector<unsigned int> numRemainingReaders(numReaders);
+  vector<int> positions(numNodes, -1);
+  vector<unsigned char> isScopeEnd(numNodes+1, 0);
+  for (unsigned int g = 0; g < numNodes; g++) {
+    if (nodes[g].graph != NULL) isScopeEnd[nodes[g].skipIndex] = 1;
+  }
+  vector<unsigned int> runStarts;
+  order.clear();
+  unsigned int i = 0;
+  while (i < numNodes) {
+    unsigned int end = i;
+    while (end < numNodes && (end == i || !isScopeEnd[end]) && nodes[end].graph == NULL &&
+        nodes[end].dspObject->isParallelSafe() &&
+        nodes[end].dspObject->get_object_type() != object::Type::PURE_DATA) {
+      end++;
+    }
+    if (end == i) end = i+1; // a guard or a barrier stays where it is
+    runStarts.push_back(i);
+
+    vector<unsigned int> numPending(end-i, 0);
+    vector<vector<unsigned int> > runSuccessors(end-i);
+    vector<unsigned int> ready;
+    for (unsigned int m = i; m < end; m++) {
+      const vector<unsigned int> &p = records[m].predecessors;
+      for (unsigned int q = 0; q < p.size(); q++) {
+        if (p[q] >= i && p[q] != m) {
+          numPending[m-i]++;
+          runSuccessors[p[q]-i].push_back(m);
+        }
+      }
+      if (numPending[m-i] == 0) ready.push_back(m);
+    }
+
+    while (!ready.empty()) {
+      unsigned int best = 0;
+      int bestScore = 0;
+      int bestRecency = 0;
+      for (unsigned int c = 0; c < ready.size(); c++) {
+        DspRecordSignals *r = &records[ready[c]];
+        int score = 0;
+        int recency = -1;
+        for (unsigned int q = 0; q < r->reads.size(); q++) {
+          unsigned int k = r->reads[q];
+          if (isMovable[k] && numRemainingReaders[k] == 1) score++;
+          recency = max(recency, positions[(*intervals)[k].start]);
+        }
+        for (unsigned int q = 0; q < r->writes.size(); q++) {
+          if (isMovable[r->writes[q]] && numReaders[r->writes[q]] > 0) score--;
+        }
+        if (c == 0 || score > bestScore || (score == bestScore &&
+            (recency > bestRecency || (recency == bestRecency && ready[c] < ready[best])))) {
+          best = c;
+          bestScore = score;
+          bestRecency = recency;
+        }
+      }
+
+      unsigned int m = ready[best];
+      ready.erase(ready.begin() + best);
+      positions[m] = order.size();
+      order.push_back(m);
+      for (unsigned int q = 0; q < records[m].reads.size(); q++) numRemainingReaders[records[m].reads[q]]--;
+      for (unsigned int q = 0; q < runSuccessors[m-i].size(); q++) {
+        unsigned int successor = runSuccessors[m-i][q];
+        if (--numPending[successor-i] == 0) ready.push_back(successor);
+      }
+    }
+    i = end;
+  }
+
+  if (countLiveSignals(order, records, numReaders, isMovable) > numLiveBuffersBefore) {
+    // the original order is kept if it is better
+    for (unsigned int o = 0; o < numNodes; o++) order[o] = o;
+  }
+
+  // batches are formed in each run, from the order found so far. They are dropped again if holding
+  // records back for them makes more signals live at once than in the original order.
+  runStarts.push_back(numNodes);
+  vector<unsigned int> unbatchedOrder(order);
+  vector<unsigned int> batchLengths(numNodes, 1);
+  for (unsigned int r = 0; r+1 < runStarts.size(); r++) {
+    batchRun(&order, &batchLengths, runStarts[r], runStarts[r+1], records, nodes);
+  }
+  numLiveBuffersAfter = countLiveSignals(order, records, numReaders, isMovable);
+  if (numLiveBuffersAfter > numLiveBuffersBefore) {
+    order.swap(unbatchedOrder);
+    batchLengths.assign(numNodes, 1);
+    numLiveBuffersAfter = countLiveSignals(order, records, numReaders, isMovable);
+  }
+  for (unsigned int o = 0; o < numNodes; o++) positions[order[o]] = o;
+
+  // move the records, their slots and the bounds of the intervals to the new order
+  vector<DspPlanNode> reorderedNodes;
+  vector<int> reorderedSlots;
+  reorderedNodes.reserve(numNodes);
+  reorderedSlots.reserve(slotIntervals->size());
+  for (unsigned int k = 0; k < numIntervals; k++) {
+    (*intervals)[k].start = positions[(*intervals)[k].start];
+    (*intervals)[k].end = (*intervals)[k].start;
+  }
+  for (unsigned int o = 0; o < numNodes; o++) {
+    DspPlanNode *n = &nodes[order[o]];
+    reorderedNodes.push_back(*n);
+    reorderedNodes.back().batchLength = batchLengths[o];
+    if (n->graph != NULL) continue;
+    nodeIndices[n->dspObject] = o;
+    reorderedSlots.insert(reorderedSlots.end(), slotIntervals->begin() + slotOffsets[order[o]],
+        slotIntervals->begin() + slotOffsets[order[o]+1]);
+    for (unsigned int q = 0; q < records[order[o]].reads.size(); q++) {
+      DspBufferInterval *interval = &(*intervals)[records[order[o]].reads[q]];
+      interval->end = max(interval->end, o);
+    }
+  }
+  nodes.swap(reorderedNodes);
+  slotIntervals->swap(reorderedSlots);
+}
+
+void DspPlan::restoreAliasedInlets() {
+  set<float *> receiveBuffers;
+  for (unsigned int i = 0; i < nodes.size(); i++) {
+    DspPlanNode *n = &nodes[i];
+    if (n->graph == NULL && n->dspObject->get_object_type() == object::Type::DSP_RECEIVE) {
+      receiveBuffers.insert(n->dspObject->get_dsp_buffer_at_outlet(0));
+    }
+  }
+
+  // an inlet which has since been connected elsewhere by the process order is left alone
+  for (unsigned int a = 0; a < aliasedInlets.size(); a++) {
+    DspAliasedInlet *alias = &aliasedInlets[a];
+    if (nodeIndices.find(alias->dspObject) != nodeIndices.end() &&
+        receiveBuffers.find(alias->receiveBuffer) != receiveBuffers.end() &&
+        alias->dspObject->get_dsp_buffer_at_inlet(alias->inletIndex) == alias->sendBuffer) {
+      alias->dspObject->set_dsp_buffer_at_inlet(alias->receiveBuffer, alias->inletIndex);
+    }
+  }
+  aliasedInlets.clear();
+}
+
+void DspPlan::indexBuffers(float *zeroBuffer) {
+  map<float *, unsigned int> bufferIndices;
+  buffers.push_back(zeroBuffer);
+  isBufferSilent.push_back(1);
+  bufferIndices[zeroBuffer] = 0;
+
+  for (unsigned int i = 0; i < nodes.size(); i++) {
+    DspPlanNode *n = &nodes[i];
+    if (n->graph != NULL) continue; // guard records have no buffers
+
+    DspObject *dspObject = n->dspObject;
+    n->bufferOffset = nodeBuffers.size();
+    n->numInletBuffers = dspObject->getNumDspInlets();
+    n->numOutletBuffers = dspObject->getNumDspOutlets();
+    n->canBeSilent = dspObject->canPropagateSilence();
+    for (unsigned int j = 0; j < n->numInletBuffers + n->numOutletBuffers; j++) {
+      float *buffer = (j < n->numInletBuffers)
+          ? dspObject->get_dsp_buffer_at_inlet(j)
+          : dspObject->get_dsp_buffer_at_outlet(j - n->numInletBuffers);
+      if (buffer == NULL) {
+        // nothing is known about an unresolved buffer, and it cannot be zeroed
+        n->canBeSilent = false;
+      }
+      map<float *, unsigned int>::iterator it = bufferIndices.find(buffer);
+      if (it == bufferIndices.end()) {
+        // the contents of all other buffers are unknown until they are written by the plan
+        it = bufferIndices.insert(pair<float *, unsigned int>(buffer, buffers.size())).first;
+        buffers.push_back(buffer);
+        isBufferSilent.push_back(0);
+      }
+      nodeBuffers.push_back(it->second);
+    }
+  }
+
+  // a receive~ whose readers all read its send~ directly need not copy anything
+  vector<unsigned int> numReaders(buffers.size(), 0);
+  for (unsigned int i = 0; i < nodes.size(); i++) {
+    DspPlanNode *n = &nodes[i];
+    if (n->graph != NULL) continue;
+    for (unsigned int j = 0; j < n->numInletBuffers; j++) {
+      numReaders[nodeBuffers[n->bufferOffset + j]]++;
+    }
+  }
+  for (unsigned int i = 0; i < nodes.size(); i++) {
+    DspPlanNode *n = &nodes[i];
+    if (n->graph == NULL && n->numOutletBuffers > 0 &&
+        n->dspObject->get_object_type() == object::Type::DSP_RECEIVE) {
+      n->isBypassed = (numReaders[nodeBuffers[n->bufferOffset + n->numInletBuffers]] == 0);
+    }
+  }
+
+  // a send~ need not copy its input if every receive~ of the copy is one of the above. Those
+  // which are still processed (e.g. feedback) rule it out here. Those outside of the plan (i.e.
+  // in reblocked subgraphs or other graphs) are only known by their number, which may change
+  // without this plan being compiled again (see updateBypassedSends()).
+  map<float *, unsigned int> numBypassedReceives; // by the buffer at the outlet of the send~
+  set<float *> copiedSendBuffers;
+  for (unsigned int i = 0; i < nodes.size(); i++) {
+    DspPlanNode *n = &nodes[i];
+    if (n->graph == NULL && n->dspObject->get_object_type() == object::Type::DSP_RECEIVE) {
+      float *sendBuffer = n->dspObject->get_dsp_buffer_at_inlet(0);
+      if (n->isBypassed) numBypassedReceives[sendBuffer]++;
+      else copiedSendBuffers.insert(sendBuffer);
+    }
+  }
+  for (unsigned int i = 0; i < nodes.size(); i++) {
+    DspPlanNode *n = &nodes[i];
+    if (n->graph == NULL && n->dspObject->get_object_type() == object::Type::DSP_SEND) {
+      float *sendBuffer = n->dspObject->get_dsp_buffer_at_outlet(0);
+      if (copiedSendBuffers.find(sendBuffer) == copiedSendBuffers.end()) {
+        bypassableSends.push_back(pair<unsigned int, unsigned int>(i, numBypassedReceives[sendBuffer]));
+      }
+    }
+  }
+  updateBypassedSends();
+}
+
+void DspPlan::updateBypassedSends() {
+  for (unsigned int i = 0; i < bypassableSends.size(); i++) {
+    DspPlanNode *n = &nodes[bypassableSends[i].first];
+    n->isBypassed = (reinterpret_cast<DspSend *>(n->dspObject)->getNumReceives() ==
+        bypassableSends[i].second);
+  }
+}
+
+bool DspPlan::getIndexOfObject(DspObject *dspObject, unsigned int *nodeIndex) {
+  map<DspObject *, unsigned int>::iterator it = nodeIndices.find(dspObject);
+  if (it == nodeIndices.end()) return false;
+  *nodeIndex = it->second;
+  return true;
+}
+
+inline bool DspPlan::isSilent(DspPlanNode *n) {
+  DspObject *dspObject = n->dspObject;
+  if (!n->canBeSilent || dspObject->hasPendingMessages()) return false;
+  const unsigned int *bufferIndex = nodeBuffers.data() + n->bufferOffset;
+  unsigned int silentInletMask = 0;
+  for (unsigned int i = 0; i < n->numInletBuffers && i < 32; i++) {
+    if (isBufferSilent[bufferIndex[i]]) silentInletMask |= (1u << i);
+  }
+  return dspObject->isSilentBlock(silentInletMask);
+}
+
+inline void DspPlan::silenceOutlets(DspPlanNode *n) {
+  const unsigned int *bufferIndex = nodeBuffers.data() + n->bufferOffset;
+  for (unsigned int i = n->numInletBuffers; i < n->numInletBuffers + n->numOutletBuffers; i++) {
+    unsigned int j = bufferIndex[i];
+    if (!isBufferSilent[j]) {
+      memset(buffers[j], 0, n->toIndex * sizeof(float));
+      isBufferSilent[j] = 1;
+    }
+  }
+}
+
+inline bool DspPlan::processSilence(DspPlanNode *n) {
+  if (!isSilent(n)) return false;
+  silenceOutlets(n);
+  return true;
+}
+
+inline void DspPlan::processNode(DspPlanNode *n) {
+  if (n->isBypassed || processSilence(n)) return;
+  DspObject *dspObject = n->dspObject;
+  const unsigned int *bufferIndex = nodeBuffers.data() + n->bufferOffset;
+
+  // NOTE: the process function is read from the object on every call because it is swapped
+  // at runtime when messages arrive (see DspObject::receive_message())
+  dspObject->process_function(dspObject, n->fromIndex, n->toIndex);
+  for (unsigned int i = n->numInletBuffers; i < n->numInletBuffers + n->numOutletBuffers; i++) {
+    isBufferSilent[bufferIndex[i]] = 0;
+  }
+}
+
+void DspPlan::processBatch(DspPlanNode *n) {
+  DspObject *batch[n->batchLength];
+  DspPlanNode *members[n->batchLength];
+  int numObjects = 0;
+  for (unsigned int k = 0; k < n->batchLength; k++) {
+    DspPlanNode *m = n + k;
+    if (m->isBypassed) continue;
+    DspObject *dspObject = m->dspObject;
+    bool hasMessages = (dspObject->process_function != dspObject->process_functionNoMessage);
+    if (hasMessages || isSilent(m)) {
+      // The buffers were assigned for the members running one after another, such that this one
+      // may write a buffer which an earlier member reads. Those are processed first.
+      processBatchMembers(n, batch, members, numObjects);
+      numObjects = 0;
+      if (hasMessages) {
+        processNode(m); // the messages are processed at their block index
+      } else {
+        silenceOutlets(m);
+      }
+    } else {
+      batch[numObjects] = dspObject;
+      members[numObjects++] = m;
+    }
+  }
+  processBatchMembers(n, batch, members, numObjects);
+}
+
+void DspPlan::processBatchMembers(DspPlanNode *n, DspObject **batch, DspPlanNode **members,
+    int numObjects) {
+  if (numObjects == 0) return;
+  n->dspObject->process_functionBatch(batch, numObjects, n->fromIndex, n->toIndex);
+  for (int k = 0; k < numObjects; k++) {
+    DspPlanNode *m = members[k];
+    const unsigned int *bufferIndex = nodeBuffers.data() + m->bufferOffset;
+    for (unsigned int i = m->numInletBuffers; i < m->numInletBuffers + m->numOutletBuffers; i++) {
+      isBufferSilent[bufferIndex[i]] = 0;
+    }
+  }
+}
+
+void DspPlan::execute() {
+  updateBypassedSends();
+  DspPlanNode *node = nodes.data();
+  const unsigned int numNodes = nodes.size();
+  unsigned int i = 0;
+  while (i < numNodes) {
+    DspPlanNode *n = node + i;
+    if (n->graph != NULL) {
+      // guard record. Skip the subgraph entirely if it is switched off.
+      i = n->graph->isSwitchedOn() ? i+1 : n->skipIndex;
+    } else if (n->batchLength > 1) {
+      processBatch(n);
+      i += n->batchLength;
+    } else {
+      processNode(n);
+      ++i;
+    }
+  }
+}
+
+void DspPlan::executeNode(unsigned int nodeIndex) {
+  DspPlanNode *n = &nodes[nodeIndex];
+  if (n->graph == NULL && n->isActive) {
+    processNode(n);
+  }
+}
+
+void DspPlan::updateActiveNodes() {
+  updateBypassedSends();
+  const unsigned int numNodes = nodes.size();
+  unsigned int i = 0;
+  while (i < numNodes) {
+    DspPlanNode *n = &nodes[i];
+    n->isActive = true;
+    if (n->graph != NULL && !n->graph->isSwitchedOn()) {
+      // deactivate everything belonging to the switched-off subgraph
+      for (unsigned int j = i+1; j < n->skipIndex; j++) {
+        nodes[j].isActive = false;
+      }
+      i = n->skipIndex;
+    } else {
+      ++i;
+    }
+  }
+}
+
+void DspPlan::computeDependencies() {
+  const unsigned int numNodes = nodes.size();
+  vector<vector<unsigned int> > predecessors(numNodes);
+
+  // the last record to write each buffer, and all records which have read it since
+  map<float *, unsigned int> lastWriter;
+  map<float *, vector<unsigned int> > readersSinceWrite;
+
+  // records which are not parallel safe are barriers. Everything before a barrier must complete
+  // before it runs, and everything after it must wait for it.
+  bool hasBarrier = false;
+  unsigned int lastBarrier = 0;
+  vector<unsigned int> sinceBarrier;
+
+  for (unsigned int i = 0; i < numNodes; i++) {
+    DspPlanNode *n = &nodes[i];
+    if (n->graph != NULL) continue; // guard records have no dependencies
+
+    DspObject *dspObject = n->dspObject;
+    vector<unsigned int> *p = &predecessors[i];
+
+    if (!dspObject->isParallelSafe()) {
+      p->insert(p->end(), sinceBarrier.begin(), sinceBarrier.end());
+      if (hasBarrier) p->push_back(lastBarrier);
+      hasBarrier = true;
+      lastBarrier = i;
+      sinceBarrier.clear();
+    } else {
+      if (hasBarrier) p->push_back(lastBarrier);
+      sinceBarrier.push_back(i);
+    }
+
+    // read after write
+    for (unsigned int j = 0; j < dspObject->getNumDspInlets(); j++) {
+      float *buffer = dspObject->get_dsp_buffer_at_inlet(j);
+      if (buffer == NULL) continue;
+      map<float *, unsigned int>::iterator it = lastWriter.find(buffer);
+      if (it != lastWriter.end()) p->push_back(it->second);
+    }
+
+    // write after write, write after read
+    for (unsigned int j = 0; j < dspObject->getNumDspOutlets(); j++) {
+      float *buffer = dspObject->get_dsp_buffer_at_outlet(j);
+      if (buffer == NULL) continue;
+      map<float *, unsigned int>::iterator it = lastWriter.find(buffer);
+      if (it != lastWriter.end()) p->push_back(it->second);
+      vector<unsigned int> *readers = &readersSinceWrite[buffer];
+      p->insert(p->end(), readers->begin(), readers->end());
+    }
+
+    // update the buffer state only after all dependencies of this record have been found, such
+    // that an object which processes in-place does not depend on itself
+    for (unsigned int j = 0; j < dspObject->getNumDspInlets(); j++) {
+      float *buffer = dspObject->get_dsp_buffer_at_inlet(j);
+      if (buffer != NULL) readersSinceWrite[buffer].push_back(i);
+    }
+    for (unsigned int j = 0; j < dspObject->getNumDspOutlets(); j++) {
+      float *buffer = dspObject->get_dsp_buffer_at_outlet(j);
+      if (buffer == NULL) continue;
+      lastWriter[buffer] = i;
+      readersSinceWrite[buffer].clear();
+    }
+
+    // remove duplicate and self dependencies
+    sort(p->begin(), p->end());
+    p->erase(unique(p->begin(), p->end()), p->end());
+    p->erase(remove(p->begin(), p->end(), i), p->end());
+  }
+
+  // invert the predecessor lists into a contiguous successor array
+  numPredecessors = vector<unsigned int>(numNodes, 0);
+  successorOffsets = vector<unsigned int>(numNodes+1, 0);
+  for (unsigned int i = 0; i < numNodes; i++) {
+    numPredecessors[i] = predecessors[i].size();
+    for (unsigned int k = 0; k < predecessors[i].size(); k++) {
+      successorOffsets[predecessors[i][k]+1]++;
+    }
+  }
+  for (unsigned int i = 0; i < numNodes; i++) {
+    successorOffsets[i+1] += successorOffsets[i];
+  }
+  successors = vector<unsigned int>(successorOffsets[numNodes]);
+  vector<unsigned int> fill(successorOffsets.begin(), successorOffsets.end()-1);
+  for (unsigned int i = 0; i < numNodes; i++) {
+    for (unsigned int k = 0; k < predecessors[i].size(); k++) {
+      successors[fill[predecessors[i][k]]++] = i;
+    }
+  }
+}
@@ -0,0 +1,285 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _DSP_PLAN_H_
+#define _DSP_PLAN_H_
+
+#include <map>
+#include <vector>
+using namespace std;
+
+class BufferPool;
+class DspObject;
+class PdGraph;
+struct DspBufferInterval;
+
+/**
+ * A single record in a <code>DspPlan</code>. Each record either executes one <code>DspObject</code>
+ * over the given block range, or (if <code>graph</code> is non-NULL) guards the records belonging
+ * to a subgraph. If the subgraph is switched off, execution jumps to <code>skipIndex</code>.
+ * The buffers at the inlets and then the outlets of the object are listed in the plan's
+ * <code>nodeBuffers</code>, beginning at <code>bufferOffset</code>. A bypassed record is not
+ * executed at all, e.g. a <code>receive~</code> whose output is no longer read by anything.
+ * If <code>batchLength</code> is greater than one, the record heads a batch of that many adjacent
+ * records which are processed together (see <code>DspObject::processFunctionBatch</code>).
+ */
+typedef struct DspPlanNode {
+  DspObject *dspObject;
+  PdGraph *graph;
+  int fromIndex;
+  int toIndex;
+  unsigned int skipIndex;
+  bool isActive;
+  bool canBeSilent;
+  unsigned int bufferOffset;
+  unsigned int numInletBuffers;
+  unsigned int numOutletBuffers;
+  bool isBypassed;
+  unsigned int batchLength;
+} DspPlanNode;
+
+/**
+ * An inlet which reads the buffer at the inlet of a <code>send~</code> directly, instead of the
+ * copy at the outlet of a <code>receive~</code>.
+ */
+typedef struct DspAliasedInlet {
+  DspObject *dspObject;
+  unsigned int inletIndex;
+  float *receiveBuffer; // the buffer at the outlet of the receive~
+  float *sendBuffer; // the buffer which is read instead
+} DspAliasedInlet;
+
+/**
+ * A <code>DspPlan</code> is the flattened process order of a root <code>PdGraph</code>, including
+ * all of its subgraphs (except those which are reblocked). Instead of walking a <code>list</code> per graph and recursing through
+ * <code>PdGraph::processGraph</code>, the plan is a single contiguous array which is run in a tight
+ * loop. The plan must be recompiled whenever the process order of any graph in the tree changes.
+ *
+ * When compiled, the plan also records the dependencies between its records, derived from the
+ * buffers that each object reads and writes in the serial order. This allows a
+ * <code>DspScheduler</code> to execute independent branches concurrently with the same result as
+ * the serial loop.
+ *
+ * Before anything else, the buffers from the root <code>BufferPool</code> are reassigned with a
+ * liveness pass over the flattened order, such that the number of distinct block buffers equals
+ * the largest number of signals which are live at the same time. If reordering is enabled, the
+ * records between barriers are first put into another valid order which ends signals as early as
+ * possible and reads them soon after they are written, which lowers that number and keeps the
+ * buffers in flight few enough to stay in the cache. Independent records of objects which can be
+ * processed as a batch (e.g. filters, one per voice) are then moved next to each other, and are
+ * executed with a single call (the <code>DspScheduler</code> still executes them one by one).
+ * Finally, the hot state of the objects is laid out in the <code>ObjectArena</code> in the order
+ * of the plan.
+ *
+ * Subgraphs which are not reblocked cost nothing at their boundaries. Their <code>inlet~</code>
+ * and <code>outlet~</code> objects are not records of the plan, as the objects on either side
+ * already read and write the same buffer. When that buffer is moved by the plan, they are updated
+ * to match.
+ *
+ * A <code>receive~</code> which follows its <code>send~</code> in the plan does not copy the signal
+ * again. Its readers are instead pointed at the buffer at the inlet of the <code>send~</code>, which
+ * then lives until the last of them. A <code>receive~</code> which precedes its <code>send~</code>
+ * (i.e. feedback) still reads the copy made by the <code>send~</code>, delayed by one block. If no
+ * <code>receive~</code> reads the copy, the <code>send~</code> is not processed either.
+ *
+ * The plan also tracks which buffers are known to be silent (i.e. contain only zeros). The zero
+ * buffer is always silent. Objects which report that they are silent for the given silent inlets
+ * are not processed, and their outlets are marked silent. A silent outlet buffer is only zeroed
+ * when it was not already silent.
+ */
+class DspPlan {
+
+  public:
+    DspPlan();
+    ~DspPlan();
+
+    /** Flattens the current process order of the given graph and all of its subgraphs. */
+    void compile(PdGraph *graph);
+
+    /** Removes all records from the plan. */
+    void clear();
+
+    /** Executes all records in the plan, in order. */
+    void execute();
+
+    /**
+     * Executes the record at the given index. Guard records and records in switched-off subgraphs
+     * do nothing. Used by the <code>DspScheduler</code>.
+     */
+    void executeNode(unsigned int nodeIndex);
+
+    /**
+     * Updates the active flag of all records according to the switch state of their subgraphs,
+     * and the bypassed flag of <code>send~</code> records (see <code>updateBypassedSends()</code>).
+     */
+    void updateActiveNodes();
+
+    /**
+     * Finds the record which executes the given object. Returns <code>false</code> if the object
+     * is not in the plan.
+     */
+    bool getIndexOfObject(DspObject *dspObject, unsigned int *nodeIndex);
+
+    /** Returns the object executed by the given record, or <code>NULL</code> for guard records. */
+    DspObject *getObjectAtIndex(unsigned int nodeIndex) {
+      return (nodes[nodeIndex].graph == NULL) ? nodes[nodeIndex].dspObject : NULL;
+    }
+
+    bool isEmpty() { return nodes.empty(); }
+    unsigned int getNumNodes() { return nodes.size(); }
+
+    /** Returns the number of records which must be executed before the given record. */
+    unsigned int getNumPredecessors(unsigned int nodeIndex) { return numPredecessors[nodeIndex]; }
+
+    /**
+     * Enables reordering of the records for buffer locality on the next compilation. Off by
+     * default, as it changes the order in which independent objects are processed.
+     */
+    void setReordering(bool isReordering) { this->isReordering = isReordering; }
+
+    /**
+     * Returns the largest number of pool buffers that are live at the same time in the original
+     * process order and in the compiled order. Both are equal if the plan was not reordered.
+     */
+    void getNumLiveBuffers(unsigned int *numBefore, unsigned int *numAfter) {
+      *numBefore = numLiveBuffersBefore;
+      *numAfter = numLiveBuffersAfter;
+    }
+
+    /** Returns the records which depend on the given record. The length is returned in n. */
+    unsigned int *getSuccessors(unsigned int nodeIndex, unsigned int *n) {
+      *n = successorOffsets[nodeIndex+1] - successorOffsets[nodeIndex];
+      return successors.data() + successorOffsets[nodeIndex];
+    }
+
+  private:
+    /** Recursively appends the process order of the given graph to the plan. */
+    void appendGraph(PdGraph *graph);
+
+    /**
+     * Reassigns the pool buffers of all records. Each write of a buffer to an outlet begins a
+     * signal which lives until its last read at an inlet. Signals are coloured with buffers in the
+     * order in which they begin, reusing the buffers of signals which have ended (interval graph
+     * colouring, which is optimal for a fixed order). Buffers which are read before they are
+     * written, or which are held by objects which cannot have their outlet buffers set (e.g. subgraphs),
+     * are left where they are.
+     */
+    void assignBuffers(BufferPool *bufferPool);
+
+    /**
+     * Counts the live buffers of the given intervals and, if enabled, reorders the records for
+     * locality and batches them. Called by <code>assignBuffers()</code> once the intervals are
+     * known in the original order, such that each interval remains the same signal. The intervals and the slots are moved
+     * along with the records.
+     */
+    void reorderForLocality(vector<DspBufferInterval> *intervals, vector<int> *slotIntervals,
+        const vector<unsigned char> &isPinned);
+
+    /**
+     * Points the inlets which were aliased by the last compilation back at their
+     * <code>receive~</code>, if both objects are still in the plan.
+     */
+    void restoreAliasedInlets();
+
+    /** Lists the buffers of each record and resets the silence flags. */
+    void indexBuffers(float *zeroBuffer);
+
+    /**
+     * Bypasses each <code>send~</code> whose <code>receive~</code>s are all bypassed records of
+     * this plan. A <code>receive~</code> which is added elsewhere (e.g. in another graph) is
+     * counted by the <code>send~</code> at once, such that it is checked before every block.
+     */
+    void updateBypassedSends();
+
+    /**
+     * Processes the object of the given record, or marks its outlets silent if the object is
+     * silent in this block.
+     */
+    inline void processNode(DspPlanNode *n);
+
+    /**
+     * Marks the outlets of the given record silent and returns true if its object is silent in this
+     * block. Returns false if the object must be processed.
+     */
+    inline bool processSilence(DspPlanNode *n);
+
+    /** Returns true if the object of the given record is silent in this block. */
+    inline bool isSilent(DspPlanNode *n);
+
+    /** Zeroes the outlet buffers of the given record which are not already silent. */
+    inline void silenceOutlets(DspPlanNode *n);
+
+    /**
+     * Processes the batch headed by the given record. Members which are bypassed, silent or have
+     * pending messages are processed on their own, in the order of the plan. The members batched
+     * before such a member are processed before it.
+     */
+    void processBatch(DspPlanNode *n);
+
+    /** Processes the given members of the batch headed by <code>n</code> with a single call. */
+    void processBatchMembers(DspPlanNode *n, DspObject **batch, DspPlanNode **members,
+        int numObjects);
+
+    /**
+     * Computes the dependencies between all records. A record depends on the last writer of each
+     * buffer that it reads or writes, and on all readers of each buffer that it writes since the
+     * last write (buffers are reused by the <code>BufferPool</code>). Objects which are not
+     * parallel safe act as barriers.
+     */
+    void computeDependencies();
+
+    vector<DspPlanNode> nodes;
+
+    /** Every buffer which is read or written by the plan. */
+    vector<float *> buffers;
+
+    /**
+     * Set if the buffer with the same index contains only zeros. Not a <code>vector<bool></code>,
+     * such that the flags of different buffers can be written concurrently.
+     */
+    vector<unsigned char> isBufferSilent;
+
+    /** The indices of the inlet and outlet buffers of all records, stored contiguously. */
+    vector<unsigned int> nodeBuffers;
+
+    /** The record index of every object in the plan. */
+    map<DspObject *, unsigned int> nodeIndices;
+
+    /** Inlets which read a send~ buffer directly. Kept across compilations. */
+    vector<DspAliasedInlet> aliasedInlets;
+
+    /**
+     * The record of each send~ whose receive~s in the plan are all bypassed, and their number. The
+     * send~ is bypassed while it has no other receive~.
+     */
+    vector<pair<unsigned int, unsigned int> > bypassableSends;
+
+    vector<unsigned int> numPredecessors;
+
+    bool isReordering;
+    unsigned int numLiveBuffersBefore;
+    unsigned int numLiveBuffersAfter;
+
+    /** Successors of each record, stored contiguously. Record i owns [offsets[i], offsets[i+1]). */
+    vector<unsigned int> successorOffsets;
+    vector<unsigned int> successors;
+};
+
+#endif // _DSP_PLAN_H_
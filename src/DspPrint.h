@@ -35,6 +35,9 @@ class DspPrint : public DspObject {
 
     static const char *get_object_label();
     std::string toString();
+
+    /** Printing to the context is not thread-safe. */
+    bool isParallelSafe() { return false; }
     
   private:
     void process_message(int inlet_index, PdMessage *message);
@@ -22,6 +22,8 @@
 
 #include "BufferPool.h"
 #include "DspReceive.h"
+#include "DspSend.h"
+#include "pd::Context.h"
 #include "PdGraph.h"
 
 message::Object *DspReceive::new_object(pd::Message *init_message, PdGraph *graph) {
@@ -31,7 +33,7 @@ message::Object *DspReceive::new_object(pd::Message *init_message, PdGraph *grap
 DspReceive::DspReceive(pd::Message *init_message, PdGraph *graph) : DspObject(1, 0, 0, 1, graph) {
   if (init_message->is_symbol(0)) {
     name = utils::copy_string(init_message->get_symbol(0));
-    dspBufferAtOutlet[0] = ALLOC_ALIGNED_BUFFER(graph->get_block_size() * sizeof(float));
+    dspBufferAtOutlet[0] = graph->get_buffer_pool()->getArena()->allocate(graph->get_block_size() * sizeof(float));
   } else {
     name = NULL;
     graph->print_err("receive~ not initialised with a name.");
@@ -41,11 +43,39 @@ DspReceive::DspReceive(pd::Message *init_message, PdGraph *graph) : DspObject(1,
   // this pointer contains the send buffer
   // default to zero buffer
   dspBufferAtInlet[0] = graph->get_buffer_pool()->get_zero_buffer();
+  dspSend = NULL;
 }
 
 DspReceive::~DspReceive() {
   free(name);
-  FREE_ALIGNED_BUFFER(dspBufferAtOutlet[0]);
+  graph->get_buffer_pool()->getArena()->release(dspBufferAtOutlet[0], block_sizeInt * sizeof(float));
+}
+
+void DspReceive::onBlockSizeUpdate(int block_size) {
+  BufferArena *arena = graph->get_buffer_pool()->getArena();
+  if (name != NULL) {
+    arena->release(dspBufferAtOutlet[0], block_sizeInt * sizeof(float));
+    dspBufferAtOutlet[0] = arena->allocate(block_size * sizeof(float));
+  }
+  DspObject::onBlockSizeUpdate(block_size);
+  // the graph is not attached, so there is not yet any send~ buffer to refer to
+  set_dsp_buffer_at_inlet(graph->get_buffer_pool()->get_zero_buffer(), 0);
+}
+
+void DspReceive::set_dsp_buffer_at_inlet(float *buffer, unsigned int inlet_index) {
+  // the send~ may already be unregistered, and so is not looked up again
+  if (dspSend != NULL) {
+    dspSend->removeReceive();
+    dspSend = NULL;
+  }
+  DspObject::set_dsp_buffer_at_inlet(buffer, inlet_index);
+  if (name != NULL && buffer != graph->get_buffer_pool()->get_zero_buffer()) {
+    DspSend *send = graph->getContext()->get_dsp_send(name);
+    if (send != NULL && send->get_dsp_buffer_at_outlet(0) == buffer) {
+      send->addReceive();
+      dspSend = send;
+    }
+  }
 }
 
 void DspReceive::process_message(int inlet_index, pd::Message *message) {
@@ -25,6 +25,8 @@
 
 #include "DspObject.h"
 
+class DspSend;
+
 /** [receive~ symbol], [r~ symbol] */
 class DspReceive : public DspObject {
   
@@ -42,11 +44,25 @@ class DspReceive : public DspObject {
     void process_message(int inlet_index, PdMessage *message);
   
     bool canSetBufferAtOutlet(unsigned int outlet_index);
+
+    /**
+     * The context sets the inlet buffer to the buffer of the matching send~, or to the zero buffer.
+     * The send~ is told which of its receive~s read its buffer.
+     */
+    void set_dsp_buffer_at_inlet(float *buffer, unsigned int inlet_index);
+
+    void onBlockSizeUpdate(int block_size);
+
+    /** Reads the buffer of a send~ which is not connected in the graph. */
+    bool isParallelSafe() { return false; }
   
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
   
     char *name;
+
+    /** The send~ whose buffer is read, or <code>NULL</code>. */
+    DspSend *dspSend;
 };
 
 inline const char *DspReceive::get_name() {
@@ -47,6 +47,16 @@ DspRfft::~DspRfft() {
   #endif // __APPLE__
 }
 
+void DspRfft::onBlockSizeUpdate(int block_size) {
+  DspObject::onBlockSizeUpdate(block_size);
+  #if __APPLE__
+  vDSP_destroy_fftsetup(fftSetup);
+  log2n = lrintf(log2f((float) block_sizeInt));
+  fftSetup = vDSP_create_fftsetup(log2n, kFFTRadix2);
+  zeroBuffer = graph->get_buffer_pool()->get_zero_buffer(); // the zero buffer also has the new size
+  #endif // __APPLE__
+}
+
 void DspRfft::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
   DspRfft *d = reinterpret_cast<DspRfft *>(dspObject);
   
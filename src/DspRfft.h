@@ -36,6 +36,8 @@ class DspRfft : public DspObject {
     
     static const char *get_object_label();
     std::string toString();
+
+    void onBlockSizeUpdate(int block_size);
   
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
@@ -43,6 +43,15 @@ DspRifft::~DspRifft() {
   #endif // __APPLE__
 }
 
+void DspRifft::onBlockSizeUpdate(int block_size) {
+  DspObject::onBlockSizeUpdate(block_size);
+  #if __APPLE__
+  vDSP_destroy_fftsetup(fftSetup);
+  log2n = lrintf(log2f((float) block_sizeInt));
+  fftSetup = vDSP_create_fftsetup(log2n, kFFTRadix2);
+  #endif // __APPLE__
+}
+
 void DspRifft::processDspWithIndex(int fromIndex, int toIndex) {
   #if __APPLE__
   DSPSplitComplex inputVector;
@@ -36,6 +36,8 @@ class DspRifft : public DspObject {
     
     static const char *get_object_label();
     std::string toString();
+
+    void onBlockSizeUpdate(int block_size);
     
   private:
     void processDspWithIndex(int fromIndex, int toIndex);
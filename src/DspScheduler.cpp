@@ -0,0 +1,293 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <sched.h>
+#include <stdlib.h>
+#if __SSE__
+#include <xmmintrin.h>
+#endif
+#include "DspPlan.h"
+#include "DspScheduler.h"
+
+/** The number of failed attempts to find a record after which a worker yields its time slice. */
+#define DSP_SCHEDULER_SPIN_ROUNDS 64
+
+/** The number of failed attempts after which a worker (other than the first) parks. */
+#define DSP_SCHEDULER_PARK_ROUNDS 128
+
+/** Tells the processor that this is a spin-wait loop, which saves power and the sibling thread. */
+static inline void spinPause() {
+  #if __SSE__
+  _mm_pause();
+  #elif __arm__ || __aarch64__
+  __asm__ __volatile__ ("yield");
+  #endif
+}
+
+DspScheduler::DspScheduler(unsigned int numThreads) {
+  plan = NULL;
+  numNodesRemaining = 0;
+  blockIndex = 0;
+  numParkedWorkers = 0;
+  workGeneration = 0;
+  isRunning = true;
+  pthread_mutex_init(&blockLock, NULL);
+  pthread_cond_init(&blockCondition, NULL);
+
+  if (numThreads < 1) numThreads = 1;
+  for (unsigned int i = 0; i < numThreads; i++) {
+    Worker *worker = new Worker();
+    worker->scheduler = this;
+    worker->index = i;
+    worker->lastBlockIndex = 0;
+    worker->ring = NULL;
+    worker->top = 0;
+    worker->bottom = 0;
+    workers.push_back(worker);
+  }
+  resize(1);
+
+  // the first worker is the thread calling execute()
+  for (unsigned int i = 1; i < numThreads; i++) {
+    pthread_create(&workers[i]->thread, NULL, &workerThread, workers[i]);
+  }
+}
+
+DspScheduler::~DspScheduler() {
+  pthread_mutex_lock(&blockLock);
+  isRunning = false;
+  pthread_cond_broadcast(&blockCondition);
+  pthread_mutex_unlock(&blockLock);
+
+  for (unsigned int i = 1; i < workers.size(); i++) {
+    pthread_join(workers[i]->thread, NULL);
+  }
+  for (unsigned int i = 0; i < workers.size(); i++) {
+    ReadyRing *ring = workers[i]->ring;
+    retiredRings.push_back(ring);
+    delete workers[i];
+  }
+  for (unsigned int i = 0; i < retiredRings.size(); i++) {
+    free(retiredRings[i]->nodeIndices);
+    delete retiredRings[i];
+  }
+  pthread_cond_destroy(&blockCondition);
+  pthread_mutex_destroy(&blockLock);
+}
+
+void *DspScheduler::workerThread(void *arg) {
+  Worker *worker = reinterpret_cast<Worker *>(arg);
+  DspScheduler *scheduler = worker->scheduler;
+  while (true) {
+    pthread_mutex_lock(&scheduler->blockLock);
+    while (scheduler->isRunning && scheduler->blockIndex == worker->lastBlockIndex) {
+      pthread_cond_wait(&scheduler->blockCondition, &scheduler->blockLock);
+    }
+    worker->lastBlockIndex = scheduler->blockIndex;
+    bool isRunning = scheduler->isRunning;
+    pthread_mutex_unlock(&scheduler->blockLock);
+
+    if (!isRunning) break;
+    scheduler->runWorker(worker);
+  }
+  return NULL;
+}
+
+void DspScheduler::prepare(DspPlan *plan) {
+  resize(plan->getNumNodes());
+}
+
+void DspScheduler::resize(unsigned int numNodes) {
+  if (pendingCounts.size() < numNodes) pendingCounts.resize(numNodes);
+
+  // every record is pushed at most once per block, so a ring never holds more than all of them
+  uintptr_t length = 1;
+  while (length < numNodes) length <<= 1;
+  for (unsigned int i = 0; i < workers.size(); i++) {
+    ReadyRing *ring = workers[i]->ring;
+    if (ring == NULL || ring->mask + 1 < length) {
+      ReadyRing *newRing = new ReadyRing();
+      newRing->mask = length - 1;
+      newRing->nodeIndices = (unsigned int *) calloc(length, sizeof(unsigned int));
+      __sync_synchronize();
+      workers[i]->ring = newRing;
+      if (ring != NULL) retiredRings.push_back(ring);
+    }
+  }
+}
+
+void DspScheduler::execute(DspPlan *plan) {
+  const unsigned int numNodes = plan->getNumNodes();
+  if (numNodes == 0) return;
+
+  // resolve the switch~ state of all subgraphs before any records are executed
+  plan->updateActiveNodes();
+
+  this->plan = plan;
+  if (pendingCounts.size() < numNodes) resize(numNodes); // the plan was not prepared
+  for (unsigned int i = 0; i < numNodes; i++) {
+    pendingCounts[i] = plan->getNumPredecessors(i);
+  }
+
+  // the remaining count must be set before any record is made available, as a worker still
+  // leaving the previous block may already pick it up
+  __sync_synchronize();
+  numNodesRemaining = numNodes;
+  __sync_synchronize();
+
+  // all records without predecessors are pushed onto the deque of this thread, from which the
+  // other workers steal them. The start of the block wakes all workers, including parked ones.
+  // The pending counts are not read here, as a worker which is still spinning may already be
+  // releasing the successors of the first records.
+  for (unsigned int i = 0; i < numNodes; i++) {
+    if (plan->getNumPredecessors(i) == 0) pushNode(workers[0], i);
+  }
+
+  if (workers.size() > 1) {
+    pthread_mutex_lock(&blockLock);
+    ++blockIndex;
+    pthread_cond_broadcast(&blockCondition);
+    pthread_mutex_unlock(&blockLock);
+  }
+
+  // returns once the records which are still executing on other threads have completed
+  runWorker(workers[0]);
+  __sync_synchronize();
+}
+
+void DspScheduler::runWorker(Worker *worker) {
+  unsigned int nodeIndex = 0;
+  unsigned int numFailedRounds = 0;
+  while (numNodesRemaining > 0) {
+    if (popNode(worker, &nodeIndex)) {
+      numFailedRounds = 0;
+      plan->executeNode(nodeIndex);
+
+      // release all successors of this record. Those without outstanding predecessors are ready.
+      unsigned int numSuccessors = 0;
+      unsigned int *successors = plan->getSuccessors(nodeIndex, &numSuccessors);
+      bool hasPushed = false;
+      for (unsigned int i = 0; i < numSuccessors; i++) {
+        if (__sync_sub_and_fetch(&pendingCounts[successors[i]], 1) == 0) {
+          pushNode(worker, successors[i]);
+          hasPushed = true;
+        }
+      }
+      if (hasPushed) wakeWorkers();
+
+      // only decrement after all successors have been released, such that the block cannot end
+      // while this worker still touches the state of the current block
+      __sync_sub_and_fetch(&numNodesRemaining, 1);
+    } else if (++numFailedRounds < DSP_SCHEDULER_SPIN_ROUNDS) {
+      spinPause();
+    } else if (worker->index == 0 || numFailedRounds < DSP_SCHEDULER_PARK_ROUNDS) {
+      sched_yield();
+    } else {
+      parkWorker(worker);
+      numFailedRounds = 0;
+    }
+  }
+}
+
+void DspScheduler::pushNode(Worker *worker, unsigned int nodeIndex) {
+  uintptr_t b = worker->bottom;
+  ReadyRing *ring = worker->ring;
+  ring->nodeIndices[b & ring->mask] = nodeIndex;
+  __sync_synchronize(); // the record must be visible before the bottom which publishes it
+  worker->bottom = b + 1;
+}
+
+void DspScheduler::wakeWorkers() {
+  // the barrier pairs with the one in parkWorker(), such that either the worker sees the pushed
+  // records before it waits, or this thread sees the parked worker
+  __sync_synchronize();
+  if (numParkedWorkers > 0) {
+    pthread_mutex_lock(&blockLock);
+    ++workGeneration;
+    pthread_cond_broadcast(&blockCondition);
+    pthread_mutex_unlock(&blockLock);
+  }
+}
+
+bool DspScheduler::popNode(Worker *worker, unsigned int *nodeIndex) {
+  // the owner works from the bottom of its own deque, where the most recently readied (and most
+  // likely cache-warm) records are
+  uintptr_t b = worker->bottom - 1;
+  worker->bottom = b;
+  __sync_synchronize();
+  uintptr_t t = worker->top;
+  intptr_t size = (intptr_t) (b - t);
+  if (size >= 0) {
+    ReadyRing *ring = worker->ring;
+    *nodeIndex = ring->nodeIndices[b & ring->mask];
+    if (size > 0) return true;
+
+    // this is the last record, which a thief may be taking at the same time
+    bool isTaken = __sync_bool_compare_and_swap(&worker->top, t, t + 1);
+    worker->bottom = b + 1;
+    if (isTaken) return true;
+  } else {
+    worker->bottom = b + 1;
+  }
+
+  // steal from the top of the other workers' deques
+  const unsigned int numWorkers = workers.size();
+  for (unsigned int i = 1; i < numWorkers; i++) {
+    if (stealNode(workers[(worker->index + i) % numWorkers], nodeIndex)) return true;
+  }
+  return false;
+}
+
+bool DspScheduler::stealNode(Worker *victim, unsigned int *nodeIndex) {
+  uintptr_t t = victim->top;
+  __sync_synchronize();
+  uintptr_t b = victim->bottom;
+  if ((intptr_t) (b - t) <= 0) return false;
+  __sync_synchronize(); // the record may only be read after the bottom which published it
+  ReadyRing *ring = victim->ring;
+  unsigned int n = ring->nodeIndices[t & ring->mask];
+  // fails if the owner or another thief has taken the record in the meantime
+  if (!__sync_bool_compare_and_swap(&victim->top, t, t + 1)) return false;
+  *nodeIndex = n;
+  return true;
+}
+
+bool DspScheduler::hasReadyNodes() {
+  for (unsigned int i = 0; i < workers.size(); i++) {
+    if ((intptr_t) (workers[i]->bottom - workers[i]->top) > 0) return true;
+  }
+  return false;
+}
+
+void DspScheduler::parkWorker(Worker *worker) {
+  pthread_mutex_lock(&blockLock);
+  unsigned int generation = workGeneration;
+  __sync_add_and_fetch(&numParkedWorkers, 1); // a full barrier
+  if (!hasReadyNodes()) {
+    while (isRunning && numNodesRemaining > 0 && generation == workGeneration &&
+        blockIndex == worker->lastBlockIndex) {
+      pthread_cond_wait(&blockCondition, &blockLock);
+    }
+  }
+  __sync_sub_and_fetch(&numParkedWorkers, 1);
+  // a new block may have begun while parked, which this worker now takes part in
+  worker->lastBlockIndex = blockIndex;
+  pthread_mutex_unlock(&blockLock);
+}
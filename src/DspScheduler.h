@@ -0,0 +1,150 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _DSP_SCHEDULER_H_
+#define _DSP_SCHEDULER_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+using namespace std;
+
+class DspPlan;
+
+/**
+ * The <code>DspScheduler</code> executes a <code>DspPlan</code> across a pool of worker threads.
+ * Each worker owns a lock-free (Chase-Lev) deque of records which are ready to run. A worker pushes
+ * and pops at the bottom of its own deque and, when it is empty, steals from the top of the deques
+ * of the other workers. When a record completes, the pending count of each of its successors is
+ * decremented, and those that become ready are pushed onto the deque of the completing worker.
+ * The storage of the deques is allocated by <code>prepare()</code>, such that nothing is allocated
+ * or locked while a block is executed.
+ *
+ * The thread calling <code>execute()</code> participates as the first worker. The plan's
+ * dependencies encode all buffer hazards of the serial order, so the output is identical to that
+ * of <code>DspPlan::execute()</code>.
+ *
+ * A worker which finds nothing to do spins with a pause for a while, then yields its time slice,
+ * and finally parks until work is pushed or the next block begins. The calling thread never parks,
+ * but only pauses and yields until the remaining records have been executed by the other workers.
+ */
+class DspScheduler {
+
+  public:
+    /** Creates a scheduler with the given number of threads, including the calling thread. */
+    DspScheduler(unsigned int numThreads);
+    ~DspScheduler();
+
+    /**
+     * Allocates the per-block state for the given plan. Should be called whenever the plan has been
+     * compiled, and not while it is executed. If the plan has outgrown the state, it is otherwise
+     * allocated by <code>execute()</code>.
+     */
+    void prepare(DspPlan *plan);
+
+    /** Executes the plan for one block. Returns only once all records have been executed. */
+    void execute(DspPlan *plan);
+
+    unsigned int getNumThreads() { return workers.size(); }
+
+  private:
+    /** The storage of a deque. The length is a power of two, and <code>mask</code> is one less. */
+    typedef struct ReadyRing {
+      uintptr_t mask;
+      unsigned int *nodeIndices;
+    } ReadyRing;
+
+    /**
+     * A worker and its deque. The deque holds the records in [top, bottom), modulo the length of
+     * the ring. Both indices only ever increase (with wrap-around), and are never reset between
+     * blocks, such that a late thief from a previous block cannot succeed.
+     */
+    typedef struct Worker {
+      DspScheduler *scheduler;
+      unsigned int index;
+      pthread_t thread;
+      unsigned int lastBlockIndex;
+      ReadyRing *volatile ring;
+      volatile uintptr_t top;
+      char padding[64]; // keeps the thieves' top and the owner's bottom on separate cache lines
+      volatile uintptr_t bottom;
+    } Worker;
+
+    static void *workerThread(void *arg);
+
+    /** Executes records until none are remaining in the current block. */
+    void runWorker(Worker *worker);
+
+    /** Allocates the deques and the pending counts for a plan with the given number of records. */
+    void resize(unsigned int numNodes);
+
+    /** Pushes a ready record onto the given worker's deque. Only called by the owner. */
+    void pushNode(Worker *worker, unsigned int nodeIndex);
+
+    /** Pops a ready record from the given worker's deque, or steals one from another worker. */
+    bool popNode(Worker *worker, unsigned int *nodeIndex);
+
+    /** Wakes the parked workers, if any, after records have been pushed. */
+    void wakeWorkers();
+
+    /** Steals the oldest record from the given worker's deque. */
+    bool stealNode(Worker *victim, unsigned int *nodeIndex);
+
+    /** Returns true if any deque contains a record. */
+    bool hasReadyNodes();
+
+    /**
+     * Blocks the given worker until a record is pushed or the next block begins. Never called for
+     * the first worker.
+     */
+    void parkWorker(Worker *worker);
+
+    vector<Worker *> workers;
+
+    /**
+     * Rings which have been replaced by larger ones. A thief which is late from the previous block
+     * may still read them, so they are only deleted with the scheduler.
+     */
+    vector<ReadyRing *> retiredRings;
+
+    /** The plan being executed in the current block. */
+    DspPlan *plan;
+
+    /** The number of outstanding predecessors of each record in the current block. */
+    vector<int> pendingCounts;
+
+    /** The number of records which have not yet been executed in the current block. */
+    volatile int numNodesRemaining;
+
+    /** Incremented at the start of every block. Worker threads wait for it to change. */
+    unsigned int blockIndex;
+
+    /** The number of workers which are parked, or about to park. */
+    volatile int numParkedWorkers;
+
+    /** Incremented (under <code>blockLock</code>) when records are pushed while workers are parked. */
+    unsigned int workGeneration;
+
+    bool isRunning;
+    pthread_mutex_t blockLock;
+    pthread_cond_t blockCondition;
+};
+
+#endif // _DSP_SCHEDULER_H_
@@ -20,6 +20,7 @@
  *
  */
 
+#include "BufferPool.h"
 #include "DspSend.h"
 #include "PdGraph.h"
 
@@ -30,30 +31,38 @@ message::Object *DspSend::new_object(pd::Message *init_message, PdGraph *graph)
 DspSend::DspSend(pd::Message *init_message, PdGraph *graph) : DspObject(0, 1, 0, 0, graph) {
   if (init_message->is_symbol(0)) {
     name = utils::copy_string(init_message->get_symbol(0));
-    dspBufferAtOutlet[0] = ALLOC_ALIGNED_BUFFER(graph->get_block_size()*sizeof(float));
+    dspBufferAtOutlet[0] = graph->get_buffer_pool()->getArena()->allocate(graph->get_block_size()*sizeof(float));
   } else {
     name = NULL;
     graph->print_err("send~ not initialised with a name.");
   }
+  numReceives = 0;
   process_function = &processSignal;
 }
 
 DspSend::~DspSend() {
   free(name);
-  FREE_ALIGNED_BUFFER(dspBufferAtOutlet[0]);
+  graph->get_buffer_pool()->getArena()->release(dspBufferAtOutlet[0], block_sizeInt*sizeof(float));
+}
+
+void DspSend::onBlockSizeUpdate(int block_size) {
+  BufferArena *arena = graph->get_buffer_pool()->getArena();
+  if (name != NULL) {
+    arena->release(dspBufferAtOutlet[0], block_sizeInt * sizeof(float));
+    dspBufferAtOutlet[0] = arena->allocate(block_size * sizeof(float));
+  }
+  DspObject::onBlockSizeUpdate(block_size);
 }
 
 /*
- * It would be very nice to not have to use memcpys with send~ and receive~, but unfortunately
- * things become very complicated very quickly. If s~ is already in an attached graph, then
- * everything works out fine. If s~ does not yet exist, then it is also easy for r~ to use the
- * zero buffer as its output. Ideally, we'd like to remove s~ and r~ entirely from the dsp graph
- * and all objects receiving from r~ to simply refer to the buffer at s~. But for that we'd need
- * to make sure that the s~ buffer is accordingly retained and not reused before all r~ receivers
- * have had a chance to use it.
+ * The objects reading from a r~ which follows its s~ in the DspPlan are pointed at the buffer at
+ * the inlet of the s~ directly, and the plan keeps that buffer from being reused before the last
+ * of them. Such a r~ is not processed at all. The copy below is still needed by any r~ which
+ * precedes its s~ (feedback, delayed by one block), which is in a reblocked subgraph or another
+ * graph, or whose s~ signal cannot be moved. If there is no such r~, the plan bypasses the s~.
  */
 void DspSend::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
-  // make a defensive copy of the input in case the buffer is reused before all receives
+  // make a defensive copy of the input in case the buffer is reused before all unaliased receives
   // have had the chance to refer to it
   DspSend *d = reinterpret_cast<DspSend *>(dspObject);
   memcpy(d->dspBufferAtOutlet[0], d->dspBufferAtInlet[0], toIndex*sizeof(float));
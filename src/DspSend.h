@@ -38,11 +38,27 @@ class DspSend : public DspObject {
     std::string toString();
   
     object::Type get_object_type();
+
+    void onBlockSizeUpdate(int block_size);
+
+    /** send~ buffers are read by receive~ objects which are not connected in the graph. */
+    bool isParallelSafe() { return false; }
+
+    /** Called by a receive~ when it begins or stops reading the buffer at the outlet. */
+    void addReceive() { ++numReceives; }
+    void removeReceive() { --numReceives; }
+
+    /**
+     * Returns the number of receive~ objects which read the buffer at the outlet, in any graph.
+     * The <code>DspPlan</code> skips the copy if it accounts for all of them.
+     */
+    unsigned int getNumReceives() { return numReceives; }
     
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
   
     char *name;
+    unsigned int numReceives;
 };
 
 inline std::string DspSend::toString() {
@@ -35,6 +35,9 @@ class DspSignal : public DspObject {
   
     static const char *get_object_label();
     std::string toString();
+
+    bool canPropagateSilence() { return true; }
+    bool isSilentBlock(unsigned int silentInletMask) { return (constant == 0.0f); }
   
   private:
     static void processScalar(DspObject *dspObject, int fromIndex, int toIndex);
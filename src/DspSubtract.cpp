@@ -31,7 +31,7 @@ message::Object *DspSubtract::new_object(pd::Message *init_message, PdGraph *gra
 
 DspSubtract::DspSubtract(pd::Message *init_message, PdGraph *graph) : DspObject(2, 2, 0, 1, graph) {
   constant = init_message->is_float(0) ? init_message->get_float(0) : 0.0f;
-  process_functionNoMessage = &processScalar;
+  updateProcessFunction();
 }
 
 DspSubtract::~DspSubtract() {
@@ -46,8 +46,23 @@ string DspSubtract::toString() {
 }
 
 void DspSubtract::onInletConnectionUpdate(unsigned int inlet_index) {
-  process_function = (incomingDspConnections[0].size() > 0 && incomingDspConnections[1].size() > 0)
-      ? &processSignal : processScalar;
+  updateProcessFunction();
+}
+
+void DspSubtract::onBlockSizeUpdate(int block_size) {
+  DspObject::onBlockSizeUpdate(block_size);
+  updateProcessFunction();
+}
+
+void DspSubtract::updateProcessFunction() {
+  // because this can only be called at block boundaries, it is guaranteed that no messages will
+  // be in the message queue.
+  if (incomingDspConnections[0].size() > 0 && incomingDspConnections[1].size() > 0) {
+    process_function = DSP_SELECT_BLOCK_FUNCTION(processSignalBlock, block_sizeInt, processSignal);
+  } else {
+    process_function = DSP_SELECT_BLOCK_FUNCTION(processScalarBlock, block_sizeInt, processScalar);
+  }
+  process_functionNoMessage = process_function;
 }
 
 void DspSubtract::process_message(int inlet_index, pd::Message *message) {
@@ -67,3 +82,23 @@ void DspSubtract::processScalar(DspObject *dspObject, int fromIndex, int toIndex
   ArrayArithmetic::subtract(d->dspBufferAtInlet[0], d->constant,
       d->dspBufferAtOutlet[0], fromIndex, toIndex);
 }
+
+template <int N>
+void DspSubtract::processSignalBlock(DspObject *dspObject, int fromIndex, int toIndex) {
+  if (fromIndex == 0 && toIndex == N) {
+    DspSubtract *d = reinterpret_cast<DspSubtract *>(dspObject);
+    ArrayArithmetic::subtractBlock<N>(d->dspBufferAtInlet[0], d->dspBufferAtInlet[1], d->dspBufferAtOutlet[0]);
+  } else {
+    processSignal(dspObject, fromIndex, toIndex);
+  }
+}
+
+template <int N>
+void DspSubtract::processScalarBlock(DspObject *dspObject, int fromIndex, int toIndex) {
+  if (fromIndex == 0 && toIndex == N) {
+    DspSubtract *d = reinterpret_cast<DspSubtract *>(dspObject);
+    ArrayArithmetic::subtractBlock<N>(d->dspBufferAtInlet[0], d->constant, d->dspBufferAtOutlet[0]);
+  } else {
+    processScalar(dspObject, fromIndex, toIndex);
+  }
+}
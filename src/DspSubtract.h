@@ -36,10 +36,16 @@ class DspSubtract : public DspObject {
     std::string toString();
   
     void onInletConnectionUpdate(unsigned int inlet_index);
+    void onBlockSizeUpdate(int block_size);
+
+    bool canProcessInPlace() { return true; }
 
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
     static void processScalar(DspObject *dspObject, int fromIndex, int toIndex);
+    template <int N> static void processSignalBlock(DspObject *dspObject, int fromIndex, int toIndex);
+    template <int N> static void processScalarBlock(DspObject *dspObject, int fromIndex, int toIndex);
+    void updateProcessFunction();
     void process_message(int inlet_index, PdMessage *message);
   
     float constant;
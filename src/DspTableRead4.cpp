@@ -69,36 +69,9 @@ void DspTableRead4::processDspWithIndex(int fromIndex, int toIndex) {
   if (table != NULL) { // ensure that there is a table to read from!
     int bufferLength = 0;
     float *buffer = table->getBuffer(&bufferLength);
-    #if __APPLE__
-    //float zero = 0.0f;
-    //float bufferLengthFloat = (float) (bufferLength-2);
-    //vDSP_vclip(input_buffer+startSampleIndex, 1, &zero, &bufferLengthFloat,
-    //    input_buffer+startSampleIndex, 1, endSampleIndex-startSampleIndex);
-    // NOTE(mhroth): is isn't clear what the clipping behaviour of vDSP_vlint is, but I
-    // *think* that it is doing the right thing (i.e., clipping OOB indicies)
-    int duration = toIndex - fromIndex;
-    vDSP_vsadd(dspBufferAtInlet[0]+fromIndex, 1, &offset, dspBufferAtOutlet[0]+fromIndex, 1, duration);
-    vDSP_vlint(buffer, dspBufferAtOutlet[0]+fromIndex, 1, dspBufferAtOutlet[0]+fromIndex, 1,
-        duration, bufferLength);
-    #else
-    float *input_buffer = dspBufferAtInlet[0];
-    int maxIndex = bufferLength-1;
-    for (int i = fromIndex; i < toIndex; i++) {
-      float xf = input_buffer[i] + offset;
-      int xi = (int) xf;
-      if (xi <= 0) {
-        dspBufferAtOutlet[0][i] = buffer[0];
-      } else if (xi >= maxIndex) {
-        dspBufferAtOutlet[0][i] = buffer[maxIndex];
-      } else {
-        // 2-point linear interpolation (basic and fast)
-        float dx = xf - ((float) xi);
-        float y0 = buffer[xi];
-        float y1 = buffer[xi+1];
-        float slope = (y1 - y0);
-        dspBufferAtOutlet[0][i] = (slope * dx) + y0;
-      }
-    }
-    #endif
+    // the indices are clipped into the table by interpolate()
+    ArrayArithmetic::add(dspBufferAtInlet[0], offset, dspBufferAtOutlet[0], fromIndex, toIndex);
+    ArrayArithmetic::interpolate(buffer, bufferLength, dspBufferAtOutlet[0], dspBufferAtOutlet[0],
+        fromIndex, toIndex);
   }
 }
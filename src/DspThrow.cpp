@@ -20,6 +20,7 @@
  *
  */
 
+#include "DspCatch.h"
 #include "DspThrow.h"
 #include "pd::Context.h"
 #include "PdGraph.h"
@@ -31,17 +32,16 @@ message::Object *DspThrow::new_object(pd::Message *init_message, PdGraph *graph)
 DspThrow::DspThrow(pd::Message *init_message, PdGraph *graph) : DspObject(0, 1, 0, 0, graph) {
   if (init_message->is_symbol(0)) {
     name = utils::copy_string(init_message->get_symbol(0));
-    buffer = ALLOC_ALIGNED_BUFFER(graph->get_block_size() * sizeof(float));
   } else {
     name = NULL;
-    buffer = NULL;
     graph->print_err("throw~ may not be initialised without a name. \"set\" message not supported.");
   }
+  dspCatch = NULL;
   process_function = &processSignal;
 }
 
 DspThrow::~DspThrow() {
-  FREE_ALIGNED_BUFFER(buffer);
+  if (dspCatch != NULL) dspCatch->removeThrow(this);
   free(name);
 }
 
@@ -53,7 +53,7 @@ void DspThrow::process_message(int inlet_index, pd::Message *message) {
 
 void DspThrow::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
   DspThrow *d = reinterpret_cast<DspThrow *>(dspObject);
-  memcpy(d->buffer, d->dspBufferAtInlet[0], toIndex*sizeof(float));
+  if (d->dspCatch != NULL) d->dspCatch->accumulate(d->dspBufferAtInlet[0], fromIndex, toIndex);
 }
 
 bool DspThrow::is_leaf_node() {
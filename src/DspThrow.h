@@ -29,7 +29,9 @@ class DspCatch;
 
 /**
  * [throw~ symbol]
- * Implements the sending end of a many-to-one audio connection.
+ * Implements the sending end of a many-to-one audio connection. The input is added directly to the
+ * buffer of the associated <code>catch~</code>, which is ordered after all of its throw~s which it
+ * does not feed. The input of a throw~ which runs after the catch~ is output in the next block.
  */
 class DspThrow : public DspObject {
   
@@ -38,7 +40,8 @@ class DspThrow : public DspObject {
     DspThrow(PdMessage *init_message, PdGraph *graph);
     ~DspThrow();
     
-    float *getBuffer() { return buffer; }
+    /** Sets the catch~ to which the input is added. <code>NULL</code> if there is none. */
+    void setCatch(DspCatch *dspCatch) { this->dspCatch = dspCatch; }
   
     const char *get_name() { return name; }
     static const char *get_object_label() { return "throw~"; }
@@ -48,12 +51,18 @@ class DspThrow : public DspObject {
     void process_message(int inlet_index, PdMessage *message);
   
     bool isLeafNode();
+
+    /** Writes to the buffer of a catch~ which is not connected in the graph. */
+    bool isParallelSafe() { return false; }
+
+    /** A silent throw~ adds nothing to its catch~, and so need not be processed. */
+    bool canPropagateSilence() { return true; }
     
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
   
     char *name;
-    float *buffer;
+    DspCatch *dspCatch;
 };
 
 #endif // _DSP_THROW_H_
@@ -24,47 +24,90 @@
 #include "DspVCF.h"
 #include "PdGraph.h"
 
+// the size of Pd's cosine table, from which the pole of the filter is interpolated
+#define COSTABSIZE 512
+#define UNITBIT32 1572864.0 // 3*2^19, such that bit 32 has place value 1
+
+// initialise the static class variables
+float *DspVCF::cos_table = NULL;
+int DspVCF::refCount = 0;
+
 message::Object *DspVCF::new_object(pd::Message *init_message, PdGraph *graph) {
   return new DspVCF(init_message, graph);
 }
 
 DspVCF::DspVCF(pd::Message *init_message, PdGraph *graph) : DspObject(3, 3, 0, 2, graph) {
   sample_rate = graph->get_sample_rate();
-  calculateFilterCoefficients(this->sample_rate/2.0f, 1.0f); // initialise the filter completely open
-  tap_0 = tap_1 = 0.0f;
+  q = init_message->is_float(0) ? init_message->get_float(0) : 0.0f;
+  if (q < 0.0f) q = 0.0f;
+  real = imaginary = 0.0f;
+  refCount++;
+  if (cos_table == NULL) {
+    // built as in Pd, such that the table (and so the filter) is the same
+    cos_table = (float *) malloc((COSTABSIZE + 1) * sizeof(float));
+    float phase = 0.0f;
+    float phaseIncrement = (2.0 * 3.14159) / COSTABSIZE;
+    for (int i = 0; i <= COSTABSIZE; i++, phase += phaseIncrement) {
+      cos_table[i] = cos(phase);
+    }
+  }
 }
 
 DspVCF::~DspVCF() {
-  // nothing to do
+  if (--refCount == 0) {
+    free(cos_table);
+    cos_table = NULL;
+  }
 }
 
 const char *DspVCF::get_object_label() {
   return "vcf~";
 }
 
-void DspVCF::calculateFilterCoefficients(float f, float q) {
-  float r, oneminusr, omega;
-  if (f < 0.001f) f = 10.0f;
-  if (q < 0.0f) q = 0.0f;
-  this->centerFrequency = f;
-  this->q = q;
-  omega = f * (2.0f * M_PI) / sample_rate;
-  if (q < 0.001) oneminusr = 1.0f;
-  else oneminusr = omega/q;
-  if (oneminusr > 1.0f) oneminusr = 1.0f;
-  r = 1.0f - oneminusr;
-  coef1 = 2.0f * sigbp_qcos(omega) * r;
-  coef2 = - r * r;
-  gain = 2 * oneminusr * (oneminusr + r * omega);
+void DspVCF::calculateFilterCoefficients(float *frequencies, float *coefficientsReal,
+    float *coefficientsImaginary, float *gains, int fromIndex, int toIndex) {
+  const float qinv = (q > 0.0f) ? 1.0f/q : 0.0f;
+  const float ampcorrect = 2.0f - 2.0f / (q + 2.0f);
+  const float isr = 6.28318f / sample_rate;
+  for (int i = fromIndex; i < toIndex; i++) {
+    float cf = frequencies[i] * isr;
+    if (cf < 0.0f) cf = 0.0f;
+    float cfindx = cf * (float) (COSTABSIZE/6.28318f);
+    float r = (qinv > 0.0f) ? 1.0f - cf * qinv : 0.0f;
+    if (r < 0.0f) r = 0.0f;
+    float oneminusr = 1.0f - r;
+    
+    // Pd splits the index with its UNITBIT32 trick, which rounds the fraction to 32 bits. Beyond the
+    // range of an int (or for NaN), r is zero and so the index does not matter.
+    double phase = ((double) cfindx + UNITBIT32) - UNITBIT32;
+    double index = floor(phase);
+    float frac = (float) (phase - index);
+    int tabindex = (index < 2147483648.0) ? (((int) index) & (COSTABSIZE-1)) : 0;
+    float *addr = cos_table + tabindex;
+    float f1 = addr[0];
+    float f2 = addr[1];
+    coefficientsReal[i] = r * (f1 + frac * (f2 - f1));
+    
+    // a quarter period earlier in the table is the sine
+    addr = cos_table + ((tabindex - (COSTABSIZE/4)) & (COSTABSIZE-1));
+    f1 = addr[0];
+    f2 = addr[1];
+    coefficientsImaginary[i] = r * (f1 + frac * (f2 - f1));
+    
+    gains[i] = ampcorrect * oneminusr;
+  }
 }
 
-float DspVCF::sigbp_qcos(float f) {
-  if (f >= -(0.5f * M_PI) && f <= (0.5f * M_PI)) {
-    float g = f*f;
-    return (((g*g*g * (-1.0f/720.0f) + g*g*(1.0f/24.0f)) - g*0.5) + 1);
-  } else {
-    return 0.0f;
+bool DspVCF::isSilentBlock(unsigned int silentInletMask) {
+  return (silentInletMask & 0x1) && hasTailDecayed();
+}
+
+bool DspVCF::hasTailDecayed() {
+  if (fabsf(real) < DSP_SILENCE_THRESHOLD && fabsf(imaginary) < DSP_SILENCE_THRESHOLD) {
+    real = imaginary = 0.0f;
+    return true;
   }
+  return false;
 }
 
 void DspVCF::process_message(int inlet_index, pd::Message *message) {
@@ -72,21 +115,41 @@ void DspVCF::process_message(int inlet_index, pd::Message *message) {
   if (inlet_index == 2) {
     if (message->is_float(0)) {
       q = message->get_float(0); // update the resonance (q)
+      if (q < 0.0f) q = 0.0f;
     }
   }
 }
 
 void DspVCF::processDspWithIndex(int fromIndex, int toIndex) {
-  /*
+  if (fromIndex >= toIndex) return; // e.g. a message at the very start of the block
+  // The coefficients do not depend on the state of the filter, and so are all computed before the
+  // recursion. The center frequencies are then all read before any output is written.
+  float coefficientsReal[block_sizeInt] __attribute__((aligned(16)));
+  float coefficientsImaginary[block_sizeInt] __attribute__((aligned(16)));
+  float gains[block_sizeInt] __attribute__((aligned(16)));
+  calculateFilterCoefficients(dspBufferAtInlet[1], coefficientsReal, coefficientsImaginary, gains,
+      fromIndex, toIndex);
+
+  // the recursion of Pd's sigvcf_perform, with its order of operations
+  float *input = dspBufferAtInlet[0];
+  float *bandpass = dspBufferAtOutlet[0];
+  float *lowpass = dspBufferAtOutlet[1];
+  float re = real;
+  float im = imaginary;
   for (int i = fromIndex; i < toIndex; i++) {
-    calculateFilterCoefficients(dspBufferAtInlet1[i], q);
-    dspBufferAtOutlet0[i] = dspBufferAtInlet0[i] + (coef1 * tap_0) + (coef2 * tap_1);
-    tap_1 = tap_0;
-    tap_0 = dspBufferAtOutlet0[i];
+    float re2 = re;
+    re = gains[i] * input[i] + coefficientsReal[i] * re2 - coefficientsImaginary[i] * im;
+    im = coefficientsImaginary[i] * re2 + coefficientsReal[i] * im;
+    bandpass[i] = re;
+    lowpass[i] = im;
   }
-  // dspBufferAtOutlet0[i] *= gain;
-  ArrayArithmetic::multiply(dspBufferAtOutlet0, gain, dspBufferAtOutlet0, fromIndex, toIndex);
-  */
-  // NOTE(mhroth): This object is definitely not working properly. It outputs only zero.
-  ArrayArithmetic::fill(dspBufferAtOutlet[0], 0, fromIndex, toIndex);
+  
+  // flush denormal (and huge) state to zero, as PD_BIGORSMALL does
+  union { float f; unsigned int i; } state;
+  state.f = re;
+  if ((state.i & 0x60000000) == 0 || (state.i & 0x60000000) == 0x60000000) re = 0.0f;
+  state.f = im;
+  if ((state.i & 0x60000000) == 0 || (state.i & 0x60000000) == 0x60000000) im = 0.0f;
+  real = re;
+  imaginary = im;
 }
@@ -25,7 +25,12 @@
 
 #include "DspObject.h"
 
-/** [vcf~], a voltage controlled bandpass filter */
+/**
+ * [vcf~], a voltage controlled filter, as in Pd. The center frequency is given per sample at the
+ * second inlet, and the resonance (q) as the creation argument or at the third inlet. The filter is
+ * a complex one-pole whose pole has the center frequency as its angle. The first outlet is the real
+ * part of its output, a bandpass, and the second is the imaginary part, a lowpass.
+ */
 class DspVCF : public DspObject {
   
   public:
@@ -35,22 +40,32 @@ class DspVCF : public DspObject {
   
     static const char *get_object_label();
     std::string toString();
+
+    /** The filter is silent if its signal input is, regardless of the center frequency. */
+    bool canPropagateSilence() { return true; }
+    bool isSilentBlock(unsigned int silentInletMask);
+    bool hasTailDecayed();
     
   private:
     void process_message(int inlet_index, PdMessage *message);
     void processDspWithIndex(int fromIndex, int toIndex);
   
-    void calculateFilterCoefficients(float f, float q);
-    float sigbp_qcos(float f); // not entirely sure what this is doing. From Pd.
+    /**
+     * Computes the real and imaginary parts of the pole, and the input gain, for each of the given
+     * frequencies. The pole is looked up in the same cosine table as in Pd.
+     */
+    void calculateFilterCoefficients(float *frequencies, float *coefficientsReal,
+        float *coefficientsImaginary, float *gains, int fromIndex, int toIndex);
     
     float sample_rate;
-    float centerFrequency;
     float q;
-    float coef1;
-    float coef2;
-    float gain;
-    float tap_0;
-    float tap_1;
+
+    // the state of the filter, the last output
+    float real;
+    float imaginary;
+
+    static float *cos_table; // COSTABSIZE+1 entries over one period, as Pd's cos_table
+    static int refCount;
 };
 
 inline std::string DspVCF::toString() {
@@ -50,52 +50,25 @@ void DspVariableDelay::processDspWithIndex(int fromIndex, int toIndex) {
   float bufferLengthFloat = (float) bufferLength;
   
   float targetIndexBase = (float) (headIndex - block_sizeInt);
-  #if __APPLE__
-  float xArray[block_sizeInt];
-  float targetIndexBaseArray[block_sizeInt];
-  
-  // calculate delay in samples (vector version of utils::millisecondsToSamples)
-  float samplesPerMillisecond = sample_rate / 1000.0f;
-  vDSP_vsmul(dspBufferAtInlet[0], 1, &samplesPerMillisecond, xArray, 1, block_sizeInt);
-  
-  float zero = 0.0f;
-  float one = 1.0f;
-  vDSP_vclip(xArray, 1, &zero, &bufferLengthFloat, xArray, 1, block_sizeInt); // clip the delay between 0 and the buffer length
-  vDSP_vramp(&targetIndexBase, &one, targetIndexBaseArray, 1, block_sizeInt);  // create targetIndexBaseArray
-  vDSP_vsub(xArray, 1, targetIndexBaseArray, 1, xArray, 1, block_sizeInt); // targetIndexBaseArray - xArray (== targetSampleIndex)
-  
+  float *output = dspBufferAtOutlet[0];
+
+  // calculate delay in samples (vector version of utils::millisecondsToSamples), between 0 and
+  // the buffer length
+  ArrayArithmetic::multiply(dspBufferAtInlet[0], sample_rate / 1000.0f, output, 0, block_sizeInt);
+  ArrayArithmetic::clip(output, 0.0f, bufferLengthFloat, output, 0, block_sizeInt);
+
+  // targetSampleIndex = targetIndexBase + i - delayInSamples
+  float targetIndexBaseArray[block_sizeInt] __attribute__((aligned(16)));
+  ArrayArithmetic::ramp(targetIndexBase, 1.0f, targetIndexBaseArray, 0, block_sizeInt);
+  ArrayArithmetic::subtract(targetIndexBaseArray, output, output, 0, block_sizeInt);
+
   // ensure that targetSampleIndex is positive
-  // TODO(mhroth): vectorise this!
   for (int i = 0; i < block_sizeInt; i++) {
-    if (xArray[i] < 0.0f) {
-      xArray[i] += bufferLengthFloat;
+    if (output[i] < 0.0f) {
+      output[i] += bufferLengthFloat;
     }
   }
-  
-  // do table lookup (in buffer) using xArray as indicies, with linear interpolation 
-  vDSP_vlint(buffer, xArray, 1, dspBufferAtOutlet[0], 1, block_sizeInt, bufferLength);
-  #else
-  float *inputbuffer = dspBufferAtInlet[0];
-  for (int i = 0; i < block_sizeInt; i++, targetIndexBase+=1.0f) {
-    float delayInSamples = utils::millisecondsToSamples(inputbuffer[i], sample_rate);
-    if (delayInSamples < 0.0f) {
-      delayInSamples = 0.0f;
-    } else if (delayInSamples > bufferLengthFloat) {
-      delayInSamples = bufferLengthFloat;
-    }
-    
-    float targetSampleIndex = targetIndexBase - delayInSamples;
-    if (targetSampleIndex < 0.0f) {
-      targetSampleIndex += bufferLengthFloat;
-    }
-    
-    // 2-point linear interpolation (basic and fast)
-    int x0 = (int) targetSampleIndex;
-    float dx = targetSampleIndex - ((float) x0);
-    float y0 = buffer[x0];
-    float y1 = buffer[x0+1];
-    float slope = (y1 - y0); // /(x1 - x0) == 1.0f!
-    dspBufferAtOutlet[0][i] = (slope * dx) + y0;
-  }
-  #endif
+
+  // do table lookup (in buffer) with linear interpolation. buffer[bufferLength] mirrors buffer[0].
+  ArrayArithmetic::interpolate(buffer, bufferLength+1, output, output, 0, block_sizeInt);
 }
@@ -142,21 +142,14 @@ void DspVariableLine::processSignal(DspObject *dspObject, int fromIndex, int toI
     int n = toIndex - fromIndex;
     if (n < (int) d->numSamplesToTarget) {
       // can update entire buffer
-      #if __APPLE__
-      vDSP_vramp(&(d->lastOutputSample), &(d->slope), d->dspBufferAtOutlet[0]+fromIndex, 1, n);
-      #else
-
-      #endif
+      ArrayArithmetic::ramp(d->lastOutputSample, d->slope, d->dspBufferAtOutlet[0], fromIndex, toIndex);
 
       d->lastOutputSample = d->dspBufferAtOutlet[0][toIndex-1] + d->slope;
       d->numSamplesToTarget -= n;
     } else {
       // must update slope in this buffer
-      #if __APPLE__
-      vDSP_vramp(&(d->lastOutputSample), &(d->slope), d->dspBufferAtOutlet[0]+fromIndex, 1, (int) d->numSamplesToTarget);
-      #else
-
-      #endif
+      ArrayArithmetic::ramp(d->lastOutputSample, d->slope, d->dspBufferAtOutlet[0], fromIndex,
+          fromIndex + (int) d->numSamplesToTarget);
       // update the path
       d->slope = 0.0f;
       d->lastOutputSample = d->target;
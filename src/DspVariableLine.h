@@ -41,6 +41,11 @@ class DspVariableLine : public DspObject {
   
     // override sendMessage in order to update path
     void sendMessage(int outlet_index, PdMessage *message);
+
+    bool canPropagateSilence() { return true; }
+    bool isSilentBlock(unsigned int silentInletMask) {
+      return (numSamplesToTarget <= 0.0f) && (target == 0.0f) && messageList.empty();
+    }
     
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
@@ -0,0 +1,227 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "GraphLoader.h"
+#include "PdAbstractionDataBase.h"
+#include "pd::Context.h"
+#include "PdFileParser.h"
+#include "PdGraph.h"
+
+GraphLoader::GraphLoader(ZGContext *context) {
+  this->context = context;
+  isRunning = true;
+  loadedStack = NULL;
+  readyList = NULL;
+  returnedStack = NULL;
+  abstractionDatabase = NULL;
+  pthread_mutex_init(&requestLock, NULL);
+  pthread_cond_init(&requestCondition, NULL);
+  pthread_create(&thread, NULL, &loaderThread, this);
+}
+
+GraphLoader::~GraphLoader() {
+  pthread_mutex_lock(&requestLock);
+  isRunning = false;
+  requests.clear();
+  pthread_cond_signal(&requestCondition);
+  pthread_mutex_unlock(&requestLock);
+  pthread_join(thread, NULL);
+
+  // delete all graphs which were never attached
+  LoadedGraph *loadedGraph = readyList;
+  while (loadedGraph != NULL) {
+    LoadedGraph *next = loadedGraph->next;
+    delete loadedGraph->graph;
+    delete loadedGraph;
+    loadedGraph = next;
+  }
+  loadedGraph = loadedStack;
+  while (loadedGraph != NULL) {
+    LoadedGraph *next = loadedGraph->next;
+    delete loadedGraph->graph;
+    delete loadedGraph;
+    loadedGraph = next;
+  }
+  deleteReturnedRecords();
+
+  pthread_cond_destroy(&requestCondition);
+  pthread_mutex_destroy(&requestLock);
+}
+
+void GraphLoader::loadFile(const char *directory, const char *filename, void *userInfo) {
+  LoadRequest request;
+  request.directory = string(directory);
+  request.filename = string(filename);
+  request.userInfo = userInfo;
+
+  pthread_mutex_lock(&requestLock);
+  requests.push_back(request);
+  pthread_cond_signal(&requestCondition);
+  pthread_mutex_unlock(&requestLock);
+}
+
+void GraphLoader::loadString(const char *netlist, void *userInfo) {
+  LoadRequest request;
+  request.netlist = string(netlist);
+  request.userInfo = userInfo;
+
+  pthread_mutex_lock(&requestLock);
+  requests.push_back(request);
+  pthread_cond_signal(&requestCondition);
+  pthread_mutex_unlock(&requestLock);
+}
+
+void *GraphLoader::loaderThread(void *arg) {
+  reinterpret_cast<GraphLoader *>(arg)->runLoader();
+  return NULL;
+}
+
+void GraphLoader::runLoader() {
+  pthread_mutex_lock(&requestLock);
+  while (true) {
+    while (isRunning && requests.empty()) {
+      pthread_cond_wait(&requestCondition, &requestLock);
+    }
+    if (!isRunning) break;
+    LoadRequest request = requests.front();
+    requests.pop_front();
+    pthread_mutex_unlock(&requestLock);
+
+    deleteReturnedRecords();
+
+    // abstractions may be (un)registered while the graph is loading
+    context->lock();
+    PdAbstractionDataBase abstractions(*context->get_abstraction_database());
+    context->unlock();
+    abstractionDatabase = &abstractions;
+
+    PdFileParser *parser = request.netlist.empty()
+        ? new PdFileParser(request.directory, request.filename)
+        : new PdFileParser(request.netlist);
+    parser->setLoader(this);
+    PdGraph *graph = parser->execute(context);
+    delete parser;
+    abstractionDatabase = NULL;
+
+    if (graph != NULL) {
+      if (!request.directory.empty()) {
+        // ensure that the root directory is added to the declared path set
+        graph->addDeclarePath(request.directory.c_str());
+      }
+      graph->prepare_to_attach();
+    }
+
+    if (graph != NULL || !callbacks.empty()) {
+      LoadedGraph *loadedGraph = new LoadedGraph();
+      loadedGraph->graph = graph;
+      loadedGraph->userInfo = request.userInfo;
+      loadedGraph->callbacks.swap(callbacks);
+      push(&loadedStack, loadedGraph);
+    }
+
+    pthread_mutex_lock(&requestLock);
+  }
+  pthread_mutex_unlock(&requestLock);
+}
+
+void GraphLoader::push(LoadedGraph *volatile *stack, LoadedGraph *loadedGraph) {
+  LoadedGraph *head;
+  do {
+    head = *stack;
+    loadedGraph->next = head;
+  } while (!__sync_bool_compare_and_swap(stack, head, loadedGraph));
+}
+
+void GraphLoader::deleteReturnedRecords() {
+  LoadedGraph *loadedGraph = __sync_lock_test_and_set(&returnedStack, (LoadedGraph *) NULL);
+  while (loadedGraph != NULL) {
+    LoadedGraph *next = loadedGraph->next;
+    delete loadedGraph;
+    loadedGraph = next;
+  }
+}
+
+ZGGraph *GraphLoader::attachNext(void **userInfo) {
+  PdGraph *graph = NULL;
+  while (graph == NULL) {
+    if (readyList == NULL) {
+      // take all loaded graphs at once, and reverse them into the order in which they were loaded
+      LoadedGraph *loadedGraph = __sync_lock_test_and_set(&loadedStack, (LoadedGraph *) NULL);
+      while (loadedGraph != NULL) {
+        LoadedGraph *next = loadedGraph->next;
+        loadedGraph->next = readyList;
+        readyList = loadedGraph;
+        loadedGraph = next;
+      }
+      if (readyList == NULL) return NULL;
+    }
+
+    LoadedGraph *loadedGraph = readyList;
+    readyList = loadedGraph->next;
+    graph = loadedGraph->graph;
+    if (userInfo != NULL) *userInfo = loadedGraph->userInfo;
+    makeCallbacks(loadedGraph);
+    push(&returnedStack, loadedGraph);
+  }
+
+  // The graph is already ordered and the objects to register are collected, see
+  // PdGraph::prepare_to_attach(). The registrations themselves are made here, on this thread.
+  graph->setLoader(NULL);
+  context->attach_graph(graph);
+  return graph;
+}
+
+void GraphLoader::makeCallbacks(LoadedGraph *loadedGraph) {
+  for (vector<QueuedCallback>::iterator it = loadedGraph->callbacks.begin();
+      it != loadedGraph->callbacks.end(); ++it) {
+    const char *text = it->text.c_str();
+    switch (it->function) {
+      case ZG_PRINT_STD: context->print_std("%s", text); break;
+      case ZG_PRINT_ERR: context->print_err("%s", text); break;
+      case ZG_CANNOT_FIND_OBJECT: {
+        if (context->callback_function != NULL) {
+          char *dir = (char *) context->callback_function(ZG_CANNOT_FIND_OBJECT,
+              context->callback_user_data, (void *) text);
+          if (dir != NULL) {
+            free(dir); // the object is not created, as when the graph is loaded synchronously
+          } else {
+            context->print_err("Unknown object or abstraction '%s'.", text);
+          }
+        }
+        break;
+      }
+      default: break;
+    }
+  }
+}
+
+ZGObject *GraphLoader::newObject(const char *objectLabel, ZGMessage *initMessage, ZGGraph *graph) {
+  context->lock();
+  MessageObject *messageObject = context->new_object(objectLabel, initMessage, graph);
+  context->unlock();
+  return messageObject;
+}
+
+void GraphLoader::queueCallback(ZGCallbackFunction function, const char *text) {
+  QueuedCallback callback;
+  callback.function = function;
+  callback.text = string(text);
+  callbacks.push_back(callback);
+}
@@ -0,0 +1,155 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GRAPH_LOADER_H_
+#define _GRAPH_LOADER_H_
+
+#include <list>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "ZenGarden.h"
+using namespace std;
+
+class PdAbstractionDataBase;
+
+/**
+ * A <code>GraphLoader</code> parses graphs on its own thread, such that the audio thread never waits
+ * for a (large) patch or abstraction to be parsed. Each graph is fully prepared while it is still
+ * detached: objects are created, the process order is computed, buffers are resolved from the
+ * graph's own <code>BufferPool</code> and the plan is compiled. The audio thread collects finished
+ * graphs at a block boundary with <code>attachNext()</code>, which never waits on the loader thread.
+ *
+ * Attaching is not free, however. The objects of the graph are registered with the context (e.g.
+ * receivers, tables, <code>send~</code>/<code>receive~</code>) on the calling thread, which may
+ * allocate and takes the context lock. The cost is proportional to the number of registered
+ * objects, not to the size of the patch.
+ *
+ * The loader thread shares little with the context. Graph ids are taken and objects are created
+ * under the context lock, so that neither races with other threads and externals may be
+ * (un)registered at any time. Abstractions are looked up in a copy of the abstraction database,
+ * taken when each graph begins to load. Everything which is printed while a graph is loaded, and
+ * any other call of the context callback, is queued with the graph and made by
+ * <code>attachNext()</code> on its caller's thread.
+ */
+class GraphLoader {
+
+  public:
+    GraphLoader(ZGContext *context);
+
+    /** Stops the loader thread. Graphs which have not been attached are deleted. */
+    ~GraphLoader();
+
+    /** Queues a file to be loaded. The <code>userInfo</code> is returned with the graph. */
+    void loadFile(const char *directory, const char *filename, void *userInfo);
+
+    /** Queues a netlist to be loaded. The <code>userInfo</code> is returned with the graph. */
+    void loadString(const char *netlist, void *userInfo);
+
+    /**
+     * Attaches the next graph which has finished loading to the context and returns it. Returns
+     * NULL if no graph is ready. Must be called from the audio thread between blocks. Does not wait
+     * on the loader thread, but registering the objects of the graph may allocate and takes the
+     * context lock. The callbacks which were queued while the graph was loaded are made first, also
+     * for graphs which failed to load.
+     */
+    ZGGraph *attachNext(void **userInfo);
+
+    /**
+     * Creates an object for the parser on the loader thread. The context lock is held meanwhile, as
+     * the factories of the context may be (un)registered on another thread.
+     */
+    ZGObject *newObject(const char *objectLabel, ZGMessage *initMessage, ZGGraph *graph);
+
+    /** Returns the copy of the abstraction database for the graph which is being loaded. */
+    PdAbstractionDataBase *getAbstractionDatabase() { return abstractionDatabase; }
+
+    /**
+     * Queues a call of the context callback with the given string, e.g. a message which was printed
+     * on the loader thread. The call is made when the graph which is being loaded is attached.
+     */
+    void queueCallback(ZGCallbackFunction function, const char *text);
+
+  private:
+    typedef struct LoadRequest {
+      string directory;
+      string filename;
+      string netlist;
+      void *userInfo;
+    } LoadRequest;
+
+    /** A call of the context callback which is made when the graph is attached. */
+    typedef struct QueuedCallback {
+      ZGCallbackFunction function;
+      string text;
+    } QueuedCallback;
+
+    /**
+     * A graph which has been loaded, linked into the stack of loaded graphs. The graph is NULL if
+     * it could not be loaded, but there are callbacks to make.
+     */
+    typedef struct LoadedGraph {
+      ZGGraph *graph;
+      void *userInfo;
+      vector<QueuedCallback> callbacks;
+      struct LoadedGraph *next;
+    } LoadedGraph;
+
+    static void *loaderThread(void *arg);
+    void runLoader();
+
+    /** Pushes the record onto the given lock-free stack. */
+    static void push(LoadedGraph *volatile *stack, LoadedGraph *loadedGraph);
+
+    /** Deletes all records which the audio thread has returned. */
+    void deleteReturnedRecords();
+
+    /** Makes the queued callbacks of the given graph on the calling thread. */
+    void makeCallbacks(LoadedGraph *loadedGraph);
+
+    ZGContext *context;
+    pthread_t thread;
+
+    /** The callbacks queued for the graph which is being loaded. Only accessed by the loader thread. */
+    vector<QueuedCallback> callbacks;
+
+    /** The copy of the abstraction database for the graph which is being loaded. */
+    PdAbstractionDataBase *abstractionDatabase;
+
+    /** Requests waiting for the loader thread. Only accessed by non-realtime threads. */
+    list<LoadRequest> requests;
+    bool isRunning;
+    pthread_mutex_t requestLock;
+    pthread_cond_t requestCondition;
+
+    /** Graphs pushed by the loader thread, most recent first. */
+    LoadedGraph *volatile loadedStack;
+
+    /** Graphs taken by the audio thread, in the order in which they were loaded. */
+    LoadedGraph *readyList;
+
+    /**
+     * Records which have been attached by the audio thread, to be deleted by the loader thread
+     * (the audio thread never frees memory).
+     */
+    LoadedGraph *volatile returnedStack;
+};
+
+#endif // _GRAPH_LOADER_H_
@@ -0,0 +1,40 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "MessageBlock.h"
+#include "PdGraph.h"
+
+message::Object *MessageBlock::new_object(pd::Message *init_message, PdGraph *graph) {
+  return new MessageBlock(init_message, graph);
+}
+
+MessageBlock::MessageBlock(pd::Message *init_message, PdGraph *graph) : MessageSwitch(init_message, graph) {
+  // nothing to do
+}
+
+MessageBlock::~MessageBlock() {
+  // nothing to do
+}
+
+void MessageBlock::process_message(int inlet_index, pd::Message *message) {
+  if (message->is_symbol_str(0, "set")) {
+    setBlockSize(message, 1);
+  }
+}
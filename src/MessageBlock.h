@@ -0,0 +1,52 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _MESSAGE_BLOCK_H_
+#define _MESSAGE_BLOCK_H_
+
+#include "MessageSwitch.h"
+
+/**
+ * [block~] sets the block size and overlap of its graph in the same way as [switch~], but cannot
+ * turn the graph on or off.
+ */
+class MessageBlock : public MessageSwitch {
+
+  public:
+    static MessageObject *new_object(PdMessage *init_message, PdGraph *graph);
+    MessageBlock(PdMessage *init_message, PdGraph *graph);
+    ~MessageBlock();
+
+    static const char *get_object_label();
+    std::string toString();
+
+  private:
+    void process_message(int inlet_index, PdMessage *message);
+};
+
+inline const char *MessageBlock::get_object_label() {
+  return "block~";
+}
+
+inline std::string MessageBlock::toString() {
+  return MessageBlock::get_object_label();
+}
+
+#endif // _MESSAGE_BLOCK_H_
@@ -28,7 +28,10 @@ message::Object *MessageSwitch::new_object(pd::Message *init_message, PdGraph *g
 }
 
 MessageSwitch::MessageSwitch(pd::Message *init_message, PdGraph *graph) : message::Object(1, 0, graph) {
-  // TODO(mhroth): parse object arguments 
+  // without arguments, the block size of the graph is not changed
+  if (init_message->is_float(0)) {
+    setBlockSize(init_message, 0);
+  }
 }
 
 MessageSwitch::~MessageSwitch() {
@@ -38,5 +41,18 @@ MessageSwitch::~MessageSwitch() {
 void MessageSwitch::process_message(int inlet_index, pd::Message *message) {
   if (message->is_float(0)) {
     graph->setSwitch(message->get_float(0) != 0.0f);
+  } else if (message->is_symbol_str(0, "set")) {
+    setBlockSize(message, 1);
+  }
+}
+
+void MessageSwitch::setBlockSize(pd::Message *message, int index) {
+  int block_size = message->is_float(index) ? (int) message->get_float(index) : 0;
+  // as in Pd, an overlap of zero is no overlap
+  int overlap = (message->is_float(index+1) && message->get_float(index+1) >= 1.0f)
+      ? (int) message->get_float(index+1) : 1;
+  if (message->is_float(index+2) && message->get_float(index+2) != 1.0f) {
+    graph->print_err("[%s]: up- and downsampling are not supported.", toString().c_str());
   }
+  graph->setBlockSize(block_size, overlap);
 }
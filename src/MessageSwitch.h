@@ -27,8 +27,7 @@
 
 /* 
  * Even though switch~ acts on the DSP domain, it only processes messages. Thus it is represented
- * internally as a message object.
- * TODO(mhroth): This object currently only turns DSP processing on and off.
+ * internally as a message object. Up- and downsampling are not supported.
  */
 /** [switch~] */
 class MessageSwitch : public MessageObject {
@@ -41,8 +40,14 @@ class MessageSwitch : public MessageObject {
     static const char *get_object_label();
     std::string toString();
 
-  private:
+  protected:
     void process_message(int inlet_index, PdMessage *message);
+
+    /**
+     * Sets the block size and overlap of the graph from the elements of the message beginning at
+     * the given index, as in <code>[switch~ 1024 4]</code> or <code>[set 1024 4(</code>.
+     */
+    void setBlockSize(PdMessage *message, int index);
 };
 
 inline const char *MessageSwitch::get_object_label() {
@@ -0,0 +1,154 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "DspObject.h"
+#include "ObjectArena.h"
+
+#define OBJECT_ARENA_PAD(_numBytes) \
+    ((((_numBytes) + OBJECT_ARENA_ALIGNMENT - 1) / OBJECT_ARENA_ALIGNMENT) * OBJECT_ARENA_ALIGNMENT)
+
+// the arena of each thread, such that graphs may be loaded concurrently
+static pthread_key_t currentArenaKey;
+static pthread_once_t currentArenaKeyOnce = PTHREAD_ONCE_INIT;
+
+static void createCurrentArenaKey() {
+  pthread_key_create(&currentArenaKey, NULL);
+}
+
+void ObjectArena::setCurrentArena(ObjectArena *arena) {
+  pthread_once(&currentArenaKeyOnce, &createCurrentArenaKey);
+  pthread_setspecific(currentArenaKey, arena);
+}
+
+ObjectArena *ObjectArena::getCurrentArena() {
+  pthread_once(&currentArenaKeyOnce, &createCurrentArenaKey);
+  return (ObjectArena *) pthread_getspecific(currentArenaKey);
+}
+
+ObjectArena::ObjectArena() {
+  slabOffset = OBJECT_ARENA_SLAB_SIZE; // no slab yet
+  numBytesAllocated = 0;
+  compactedState = NULL;
+  compactedStateSize = 0;
+}
+
+ObjectArena::~ObjectArena() {
+  for (unsigned int i = 0; i < slabs.size(); i++) {
+    free(slabs[i]);
+  }
+  free(compactedState);
+}
+
+void *ObjectArena::allocate(size_t numBytes) {
+  size_t size = OBJECT_ARENA_PAD(numBytes);
+  void *pointer = NULL;
+
+  map<size_t, vector<void *> >::iterator it = freeLists.find(size);
+  if (it != freeLists.end() && !it->second.empty()) {
+    pointer = it->second.back();
+    it->second.pop_back();
+  } else if (size > OBJECT_ARENA_SLAB_SIZE) {
+    // objects larger than a slab get a slab of their own, which is not carved any further. It is
+    // listed before the current slab, which must remain the last.
+    if (posix_memalign(&pointer, OBJECT_ARENA_ALIGNMENT, size) != 0) return NULL;
+    slabs.insert(slabs.empty() ? slabs.end() : slabs.end()-1, (char *) pointer);
+  } else {
+    if (slabOffset + size > OBJECT_ARENA_SLAB_SIZE) {
+      void *slab = NULL;
+      if (posix_memalign(&slab, OBJECT_ARENA_ALIGNMENT, OBJECT_ARENA_SLAB_SIZE) != 0) return NULL;
+      slabs.push_back((char *) slab);
+      slabOffset = 0;
+    }
+    pointer = slabs.back() + slabOffset;
+    slabOffset += size;
+  }
+
+  memset(pointer, 0, size);
+  numBytesAllocated += size;
+  return pointer;
+}
+
+void ObjectArena::release(void *pointer, size_t numBytes) {
+  if (pointer == NULL) return;
+  size_t size = OBJECT_ARENA_PAD(numBytes);
+  freeLists[size].push_back(pointer);
+  numBytesAllocated -= size;
+}
+
+void ObjectArena::allocateHotState(DspObject *dspObject, size_t numBytes) {
+  releaseHotState(dspObject);
+  dspObject->hotState = allocate(numBytes);
+  dspObject->hotStateSize = numBytes;
+}
+
+void ObjectArena::releaseHotState(DspObject *dspObject) {
+  if (dspObject->hotState == NULL) return;
+  if (isCompacted(dspObject->hotState)) {
+    // the space is reclaimed with the whole block at the next compaction
+    vector<DspObject *>::iterator it = find(compactedObjects.begin(), compactedObjects.end(), dspObject);
+    if (it != compactedObjects.end()) *it = NULL;
+  } else {
+    release(dspObject->hotState, dspObject->hotStateSize);
+  }
+  dspObject->hotState = NULL;
+  dspObject->hotStateSize = 0;
+}
+
+void ObjectArena::compactHotState(const vector<DspObject *> &dspObjects) {
+  size_t size = 0;
+  for (unsigned int i = 0; i < dspObjects.size(); i++) {
+    if (dspObjects[i]->hotState != NULL) size += OBJECT_ARENA_PAD(dspObjects[i]->hotStateSize);
+  }
+
+  char *state = NULL;
+  if (size > 0 && posix_memalign((void **) &state, BUFFER_ARENA_ALIGNMENT, size) != 0) return;
+
+  vector<DspObject *> objects;
+  size_t offset = 0;
+  for (unsigned int i = 0; i < dspObjects.size(); i++) {
+    DspObject *dspObject = dspObjects[i];
+    if (dspObject->hotState == NULL) continue;
+    memcpy(state + offset, dspObject->hotState, dspObject->hotStateSize);
+    if (!isCompacted(dspObject->hotState)) release(dspObject->hotState, dspObject->hotStateSize);
+    dspObject->hotState = state + offset;
+    offset += OBJECT_ARENA_PAD(dspObject->hotStateSize);
+    objects.push_back(dspObject);
+  }
+
+  // objects which are left in the previous block (i.e. which are no longer in the process order)
+  // are moved to the slabs
+  for (unsigned int i = 0; i < compactedObjects.size(); i++) {
+    DspObject *dspObject = compactedObjects[i];
+    if (dspObject != NULL && isCompacted(dspObject->hotState)) {
+      void *hotState = allocate(dspObject->hotStateSize);
+      memcpy(hotState, dspObject->hotState, dspObject->hotStateSize);
+      dspObject->hotState = hotState;
+    }
+  }
+
+  free(compactedState);
+  compactedState = state;
+  compactedStateSize = size;
+  compactedObjects.swap(objects);
+}
@@ -0,0 +1,116 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _OBJECT_ARENA_H_
+#define _OBJECT_ARENA_H_
+
+#include <stddef.h>
+#include <map>
+#include <vector>
+using namespace std;
+
+class DspObject;
+
+/**
+ * The alignment of every allocation in the arena. Objects and their state may contain 128-bit
+ * vectors.
+ */
+#define OBJECT_ARENA_ALIGNMENT 16
+
+/** The size of each slab from which objects are carved. */
+#define OBJECT_ARENA_SLAB_SIZE (64 * 1024)
+
+/**
+ * An <code>ObjectArena</code> holds the objects of a root graph and all of its subgraphs. Objects
+ * which are created through the <code>ObjectFactoryMap</code> are carved from large slabs in the
+ * order in which they are created (i.e. the order of the patch), instead of being scattered across
+ * the heap. An object which is deleted leaves its space to the next object of the same size.
+ *
+ * The state that a <code>DspObject</code> touches in every block (e.g. the taps of a filter or
+ * the phase of an oscillator) is allocated from the arena separately as its <i>hot state</i>.
+ * Once the process order is known, <code>compactHotState()</code> copies the hot state of all
+ * objects into one contiguous block in that order, such that each block walks through it
+ * sequentially.
+ */
+class ObjectArena {
+
+  public:
+    ObjectArena();
+    ~ObjectArena();
+
+    /** Returns zeroed memory of at least <code>numBytes</code>. */
+    void *allocate(size_t numBytes);
+
+    /** Returns memory of the given size to the arena. <code>NULL</code> is ignored. */
+    void release(void *pointer, size_t numBytes);
+
+    /** Allocates zeroed hot state of the given size for the object. */
+    void allocateHotState(DspObject *dspObject, size_t numBytes);
+
+    /** Releases the hot state of the object, wherever it currently is. */
+    void releaseHotState(DspObject *dspObject);
+
+    /**
+     * Moves the hot state of the given objects into a single contiguous block, in the given order.
+     * The hot state of objects which are not listed (e.g. those of reblocked subgraphs) is moved
+     * out of the previous block, which is then freed. Not thread safe with respect to processing.
+     */
+    void compactHotState(const vector<DspObject *> &dspObjects);
+
+    /** The number of bytes currently handed out by the arena, excluding the compacted block. */
+    size_t getNumBytesAllocated() { return numBytesAllocated; }
+
+    /** The size of the block which holds the compacted hot state. */
+    size_t getNumHotStateBytes() { return compactedStateSize; }
+
+    unsigned int getNumSlabs() { return slabs.size(); }
+
+    /**
+     * Sets the arena from which <code>DspObject</code>s are allocated on the calling thread, or
+     * <code>NULL</code> for the heap. Set by the <code>ObjectFactoryMap</code> around the creation
+     * of each object.
+     */
+    static void setCurrentArena(ObjectArena *arena);
+    static ObjectArena *getCurrentArena();
+
+  private:
+    /** Returns <code>true</code> if the pointer is in the block of compacted hot state. */
+    bool isCompacted(void *pointer) {
+      return (char *) pointer >= compactedState && (char *) pointer < compactedState + compactedStateSize;
+    }
+
+    vector<char *> slabs;
+
+    /** The number of bytes used in the last slab. */
+    size_t slabOffset;
+
+    /** Released allocations, by their (padded) size. */
+    map<size_t, vector<void *> > freeLists;
+
+    size_t numBytesAllocated;
+
+    char *compactedState;
+    size_t compactedStateSize;
+
+    /** The objects with state in the compacted block, or NULL where the object has since gone. */
+    vector<DspObject *> compactedObjects;
+};
+
+#endif // _OBJECT_ARENA_H_
@@ -20,7 +20,9 @@
  *
  */
 
+#include "ObjectArena.h"
 #include "ObjectFactoryMap.h"
+#include "PdGraph.h"
 
 // all standard message objects
 #include "MessageAbsoluteValue.h"
@@ -28,6 +30,7 @@
 #include "MessageArcTangent.h"
 #include "MessageArcTangent2.h"
 #include "MessageBang.h"
+#include "MessageBlock.h"
 #include "MessageCosine.h"
 #include "MessageCputime.h"
 #include "MessageChange.h"
@@ -161,6 +164,7 @@ ObjectFactoryMap::ObjectFactoryMap() {
   object_factory_map[string(MessageBang::get_object_label())] = &MessageBang::new_object;
   object_factory_map[string("bng")] = &MessageBang::new_object;
   object_factory_map[string("b")] = &MessageBang::new_object;
+  object_factory_map[string(MessageBlock::get_object_label())] = &MessageBlock::new_object;
   object_factory_map[string(MessageChange::get_object_label())] = &MessageChange::new_object;
   object_factory_map[string(MessageClip::get_object_label())] = &MessageClip::new_object;
   object_factory_map[string(MessageCosine::get_object_label())] = &MessageCosine::new_object;
@@ -308,5 +312,12 @@ void ObjectFactoryMap::unregister_external_object(const char *object_label) {
 
 message::Object *ObjectFactoryMap::new_object(const char *object_label, pd::Message *init_message, PdGraph *graph) {
   message::Object *(*new_object)(pd::Message *, PdGraph *) = object_factory_map[string(object_label)];
-  return (new_object != NULL) ? new_object(init_message, graph) : NULL;
+  if (new_object == NULL) return NULL;
+
+  // dsp objects are allocated from the arena of the graph tree, in the order of the patch
+  ObjectArena *previousArena = ObjectArena::getCurrentArena();
+  ObjectArena::setCurrentArena((graph != NULL) ? graph->get_object_arena() : NULL);
+  message::Object *messageObject = new_object(init_message, graph);
+  ObjectArena::setCurrentArena(previousArena);
+  return messageObject;
 }
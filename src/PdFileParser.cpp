@@ -20,6 +20,8 @@
  *
  */
 
+#include <stdarg.h>
+#include "GraphLoader.h"
 #include "MessageFloat.h"
 #include "MessageMessageBox.h"
 #include "MessageSymbol.h"
@@ -33,6 +35,7 @@
 PdFileParser::PdFileParser(string directory, string filename) {
   rootPath = string(directory);
   fileName = string(filename);
+  loader = NULL;
 
   FILE *fp = fopen((directory+filename).c_str(), "rb"); // open the file in binary mode
   pos = 0; // initialise position in stringDesc
@@ -61,6 +64,7 @@ PdFileParser::PdFileParser(string directory, string filename) {
 PdFileParser::PdFileParser(string aString) {
   // if we're just loading a string, the default root path is "/"
   rootPath = string("/");
+  loader = NULL;
 
   if (aString.empty()) {
     isDone = true;
@@ -149,7 +153,8 @@ PdGraph *PdFileParser::execute(pd::Message *initMsg, PdGraph *graph, pd::Context
         PdGraph *newGraph = NULL;
         if (graph == NULL) { // if no parent graph exists
           init_message->from_timestamp(0.0, 0); // make a dummy init_message
-          newGraph = new PdGraph(init_message, NULL, context, context->get_next_graph_id(), "zg_root");
+          newGraph = new PdGraph(init_message, NULL, context, getNextGraphId(context), "zg_root");
+          newGraph->setLoader(loader); // prints are queued while the graph is loaded on another thread
           if (!rootPath.empty()) {
             // inform the root graph of where it is in the file system, if this information exists.
             // This will allow abstractions to be correctly loaded.
@@ -161,7 +166,7 @@ PdGraph *PdFileParser::execute(pd::Message *initMsg, PdGraph *graph, pd::Context
             newGraph = new PdGraph(graph->getArguments(), graph, context, graph->get_graphId(), canvasName);
           } else {
             // a graph made as an abstraction
-            newGraph = new PdGraph(initMsg, graph, context, context->get_next_graph_id(), (rootPath+fileName).c_str());
+            newGraph = new PdGraph(initMsg, graph, context, getNextGraphId(context), (rootPath+fileName).c_str());
             isSubPatch = true;
           }
           graph->addObject(0, 0, newGraph); // add the new graph to the current one as an object
@@ -170,7 +175,7 @@ PdGraph *PdFileParser::execute(pd::Message *initMsg, PdGraph *graph, pd::Context
         // the new graph is pushed onto the stack
         graph = newGraph;
     } else {
-        context->print_err("Unrecognised #N object type: \"%s\".", line);
+        printErr(context, "Unrecognised #N object type: \"%s\".", line);
       }
     } else if (!strcmp(hashType, "#X")) {
       char *objectType = strtok(NULL, " ");
@@ -194,10 +199,11 @@ PdGraph *PdFileParser::execute(pd::Message *initMsg, PdGraph *graph, pd::Context
             resBuffer, RESOLUTION_BUFFER_LENGTH);
 
         // create the object
-        message::Object *message_obj = context->new_object(resBufferLabel, init_message, graph);
+        message::Object *message_obj = newObject(context, resBufferLabel, init_message, graph);
         if (message_obj == NULL) { // object could not be created based on any known object factory functions
-          if (context->get_abstraction_database()->existsAbstraction(object_label)) {
-            PdFileParser *parser = new PdFileParser(context->get_abstraction_database()->getAbstraction(object_label));
+          if (getAbstractionDatabase(context)->existsAbstraction(object_label)) {
+            PdFileParser *parser = new PdFileParser(getAbstractionDatabase(context)->getAbstraction(object_label));
+            parser->setLoader(loader);
             message_obj = parser->execute(init_message, graph, context, false);
             delete parser;
           } else {
@@ -206,18 +212,10 @@ PdGraph *PdFileParser::execute(pd::Message *initMsg, PdGraph *graph, pd::Context
             if (directory.empty()) {
               // if the system cannot find the file itself, make a final effort to find the file via
               // the user supplied callback
-              if (context->callback_function != NULL) {
-                char *dir = (char *) context->callback_function(ZG_CANNOT_FIND_OBJECT,
-                  context->callback_user_data, object_label);
-                if (dir != NULL) {
-                // TODO(mhroth): create new object based on returned path
-                  free(dir); // free the returned objectpath
-                } else {
-                  context->print_err("Unknown object or abstraction '%s'.", object_label);
-                }
-              }
+              cannotFindObject(context, object_label);
             }
             PdFileParser *parser = new PdFileParser(directory, filename);
+            parser->setLoader(loader);
             message_obj = parser->execute(init_message, graph, context, false);
             delete parser;
           }
@@ -230,7 +228,7 @@ PdGraph *PdFileParser::execute(pd::Message *initMsg, PdGraph *graph, pd::Context
         float coordinates.y = (float) atoi(strtok(NULL, " ")); // read the second canvas coordinate
         char *objectInitString = strtok(NULL, "\n\r"); // get the message initialisation string (including trailing ';')
         init_message->from_timestamp_and_symbol(0.0, objectInitString);
-        message::Object *message_obj = context->new_object(
+        message::Object *message_obj = newObject(context,
           MessageMessageBox::get_object_label(), init_message, graph);
         graph->addObject(coordinates.x, coordinates.y, message_obj);
       } else if (!strcmp(objectType, "connect")) {
@@ -243,14 +241,14 @@ PdGraph *PdFileParser::execute(pd::Message *initMsg, PdGraph *graph, pd::Context
         float coordinates.x = (float) atoi(strtok(NULL, " "));
         float coordinates.y = (float) atoi(strtok(NULL, " "));
         init_message->from_timestamp_and_float(0.0, 0.0f);
-        message::Object *message_obj = context->new_object(
+        message::Object *message_obj = newObject(context,
             MessageFloat::get_object_label(), init_message, graph); // defines a number box
         graph->addObject(coordinates.x, coordinates.y, message_obj);
       } else if (!strcmp(objectType, "symbolatom")) {
         float coordinates.x = (float) atoi(strtok(NULL, " "));
         float coordinates.y = (float) atoi(strtok(NULL, " "));
         init_message->from_timestamp_and_symbol(0.0, NULL);
-        message::Object *message_obj = context->new_object(
+        message::Object *message_obj = newObject(context,
             MessageSymbol::get_object_label(), init_message, graph);
         graph->addObject(coordinates.x, coordinates.y, message_obj);
       } else if (!strcmp(objectType, "restore")) {
@@ -263,7 +261,7 @@ PdGraph *PdFileParser::execute(pd::Message *initMsg, PdGraph *graph, pd::Context
         float coordinates.y = (float) atoi(strtok(NULL, " "));
         char *comment = strtok(NULL, ";"); // get the comment
         init_message->from_timestamp_and_symbol(0.0, comment);
-        message::Object *messageText = context->new_object(
+        message::Object *messageText = newObject(context,
             MessageText::get_object_label(), init_message, graph);
         graph->addObject(coordinates.x, coordinates.y, messageText);
       } else if (!strcmp(objectType, "declare")) {
@@ -276,7 +274,7 @@ PdGraph *PdFileParser::execute(pd::Message *initMsg, PdGraph *graph, pd::Context
             graph->addDeclarePath(init_message->get_symbol(1));
           }
         } else {
-          context->print_err("declare \"%s\" flag is not supported.", init_message->get_symbol(0));
+          printErr(context, "declare \"%s\" flag is not supported.", init_message->get_symbol(0));
         }
       } else if (!strcmp(objectType, "array")) {
         // creates a new table
@@ -284,18 +282,18 @@ PdGraph *PdFileParser::execute(pd::Message *initMsg, PdGraph *graph, pd::Context
         char *objectInitString = strtok(NULL, ";"); // get the object initialisation string
         char resBuffer[RESOLUTION_BUFFER_LENGTH];
         init_message->from_string_and_args(4, objectInitString, graph->getArguments(), resBuffer, RESOLUTION_BUFFER_LENGTH);
-        lastArrayCreated = reinterpret_cast<MessageTable *>(context->new_object("table", init_message, graph));
+        lastArrayCreated = reinterpret_cast<MessageTable *>(newObject(context, "table", init_message, graph));
         lastArrayCreatedIndex = 0;
         graph->addObject(0, 0, lastArrayCreated);
-        context->print_std("PdFileParser: Replacer array with table, name: '%s'", init_message->get_symbol(0));
+        printStd(context, "PdFileParser: Replacer array with table, name: '%s'", init_message->get_symbol(0));
       } else if (!strcmp(objectType, "coords")) {
         continue;
       } else {
-        context->print_err("Unrecognised #X object type: \"%s\"", message.c_str());
+        printErr(context, "Unrecognised #X object type: \"%s\"", message.c_str());
       }
     } else if (!strcmp(hashType, "#A")) {
       if (lastArrayCreated == NULL) {
-        context->print_err("#A line but no array were created");
+        printErr(context, "#A line but no array were created");
       } else {
         int bufferLength = 0;
         float *buffer = lastArrayCreated->getBuffer(&bufferLength);
@@ -304,7 +302,7 @@ PdGraph *PdFileParser::execute(pd::Message *initMsg, PdGraph *graph, pd::Context
         int index = atoi(strtok(NULL, " ;"));
         while ((token = strtok(NULL, " ;")) != NULL) {
           if (index >= bufferLength) {
-            context->print_err("#A trying to add value at index %d while buffer length is %d", index, bufferLength);
+            printErr(context, "#A trying to add value at index %d while buffer length is %d", index, bufferLength);
             break;
           }
           buffer[index] = atof(token);
@@ -317,9 +315,75 @@ PdGraph *PdFileParser::execute(pd::Message *initMsg, PdGraph *graph, pd::Context
         }
       }
     } else {
-      context->print_err("Unrecognised hash type: \"%s\"", message.c_str());
+      printErr(context, "Unrecognised hash type: \"%s\"", message.c_str());
     }
   }
 
   return graph;
 }
+
+
+#pragma mark - Context
+
+int PdFileParser::getNextGraphId(pd::Context *context) {
+  context->lock();
+  int graphId = context->get_next_graph_id();
+  context->unlock();
+  return graphId;
+}
+
+MessageObject *PdFileParser::newObject(pd::Context *context, const char *object_label,
+    pd::Message *init_message, PdGraph *graph) {
+  return (loader != NULL) ? loader->newObject(object_label, init_message, graph)
+      : context->new_object(object_label, init_message, graph);
+}
+
+PdAbstractionDataBase *PdFileParser::getAbstractionDatabase(pd::Context *context) {
+  return (loader != NULL) ? loader->getAbstractionDatabase() : context->get_abstraction_database();
+}
+
+void PdFileParser::cannotFindObject(pd::Context *context, const char *object_label) {
+  if (loader != NULL) {
+    // the callback is made when the graph is attached, see GraphLoader::makeCallbacks()
+    loader->queueCallback(ZG_CANNOT_FIND_OBJECT, object_label);
+  } else if (context->callback_function != NULL) {
+    char *dir = (char *) context->callback_function(ZG_CANNOT_FIND_OBJECT,
+      context->callback_user_data, (void *) object_label);
+    if (dir != NULL) {
+    // TODO(mhroth): create new object based on returned path
+      free(dir); // free the returned objectpath
+    } else {
+      context->print_err("Unknown object or abstraction '%s'.", object_label);
+    }
+  }
+}
+
+void PdFileParser::printErr(pd::Context *context, const char *msg, ...) {
+  int maxStringLength = 1024;
+  char stringBuffer[maxStringLength];
+  va_list ap;
+  va_start(ap, msg);
+  vsnprintf(stringBuffer, maxStringLength-1, msg, ap);
+  va_end(ap);
+
+  if (loader != NULL) {
+    loader->queueCallback(ZG_PRINT_ERR, stringBuffer);
+  } else {
+    context->print_err("%s", stringBuffer);
+  }
+}
+
+void PdFileParser::printStd(pd::Context *context, const char *msg, ...) {
+  int maxStringLength = 1024;
+  char stringBuffer[maxStringLength];
+  va_list ap;
+  va_start(ap, msg);
+  vsnprintf(stringBuffer, maxStringLength-1, msg, ap);
+  va_end(ap);
+
+  if (loader != NULL) {
+    loader->queueCallback(ZG_PRINT_STD, stringBuffer);
+  } else {
+    context->print_std("%s", stringBuffer);
+  }
+}
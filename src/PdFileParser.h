@@ -29,6 +29,9 @@
 #include <string.h>
 #include "StaticUtils.h"
 
+class GraphLoader;
+class MessageObject;
+class PdAbstractionDataBase;
 class pd::Context;
 class PdGraph;
 
@@ -49,9 +52,28 @@ class PdFileParser {
   
     PdGraph *execute(pd::Context *context);
 
+    /**
+     * Sets the loader on whose thread the graph is parsed. The parser then reaches the context only
+     * through the loader, and prints through it.
+     */
+    void setLoader(GraphLoader *loader) { this->loader = loader; }
+
   private:
     PdGraph *execute(PdMessage *initMsg, PdGraph *graph, pd::Context *context, bool isSubPatch);
 
+    /** Returns a new graph id. Graphs may be parsed on several threads, so it is taken under the lock. */
+    int getNextGraphId(pd::Context *context);
+
+    MessageObject *newObject(pd::Context *context, const char *object_label, PdMessage *init_message,
+        PdGraph *graph);
+    PdAbstractionDataBase *getAbstractionDatabase(pd::Context *context);
+
+    /** Reports an object which cannot be found to the context callback. */
+    void cannotFindObject(pd::Context *context, const char *object_label);
+
+    void printErr(pd::Context *context, const char *msg, ...);
+    void printStd(pd::Context *context, const char *msg, ...);
+
     /**
      * Returns the next logical message in the file, or <code>NULL</code> if the end of the file
      * has been reached.
@@ -72,6 +94,9 @@ class PdFileParser {
     string rootPath;
     string fileName; // the name of the file that is being parsed
     bool isDone;
+
+    /** The loader on whose thread the graph is parsed. NULL if it is parsed on the caller's thread. */
+    GraphLoader *loader;
 };
 
 #endif // _PD_FILE_PARSER_H_
@@ -23,6 +23,8 @@
 #ifndef _PD_GRAPH_H_
 #define _PD_GRAPH_H_
 
+#include <map>
+#include <set>
 #include "DspObject.h"
 #include "message::OrderedQueue.h"
 
@@ -31,14 +33,19 @@ class DeclareList;
 class DelayReceiver;
 class DspCatch;
 class DspDelayWrite;
+class DspMessagePool;
+class DspPlan;
+class DspScheduler;
 class DspReceive;
 class DspSend;
 class DspThrow;
+class GraphLoader;
 class LetInterface;
 class MessageObject;
 class MessageReceive;
 class message::Send;
 class MessageTable;
+class ObjectArena;
 class pd::Context;
 
 class PdGraph : public DspObject {
@@ -87,6 +94,12 @@ class PdGraph : public DspObject {
     float *get_dsp_buffer_at_inlet(int inlet_index);
     float *get_dsp_buffer_at_outlet(int outlet_index);
 
+    /**
+     * Appends the inlet~ and outlet~ objects of this graph to the given lists. Unless the graph is
+     * reblocked, they do not process audio and only pass buffers between the graph and its parent.
+     */
+    void get_dsp_lets(vector<DspObject *> *dspInlets, vector<DspObject *> *dspOutlets);
+
 
 #pragma mark -
 
@@ -98,14 +111,27 @@ class PdGraph : public DspObject {
 
     bool doesProcessAudio();
 
+    /** Reblocked graphs run their own loop, and so cannot share a block with any other object. */
+    bool isParallelSafe() { return !isReblocked; }
+
     /** Turn the audio processing of this graph on or off. */
     void setSwitch(bool switched);
 
     /** Returns <code>true</code> if the audio processing of this graph is turned on. <code>false</code> otherwise. */
     bool isSwitchedOn();
 
-    /** Set the current block size of this subgraph. */
-    void setBlockSize(int block_size);
+    /**
+     * Set the block size and overlap of this subgraph, as with [block~]. Both must be powers of two.
+     * A block size of zero is that of the parent graph. The block size may only be changed while
+     * the graph is not attached to a context.
+     */
+    void setBlockSize(int block_size, int overlap);
+
+    /**
+     * Returns <code>true</code> if this graph is processed with a block size or overlap which
+     * differs from that of its parent, <code>false</code> otherwise.
+     */
+    bool is_reblocked() { return isReblocked; }
 
     /** Get the current block size of this subgraph. */
     int get_block_size();
@@ -153,6 +179,48 @@ class PdGraph : public DspObject {
     list<DspObject *> getProcessOrder();
     bool isLeafNode();
 
+    /** Returns the local process order of this graph. Subgraphs appear as single nodes. */
+    const list<DspObject *> &get_dsp_node_list() { return dspNodeList; }
+
+    /**
+     * Marks the flattened <code>DspPlan</code> of the root graph as stale. It is recompiled when
+     * the outermost edit in progress unlocks the context (see <code>unlockContextIfAttached()</code>),
+     * or when the graph is attached.
+     */
+    void invalidate_dsp_plan();
+
+    /**
+     * Sets the number of threads with which the DSP of this (root) graph is processed. Independent
+     * branches of the graph are then processed concurrently. The result is identical to serial
+     * processing. One thread (the default) disables parallel processing.
+     */
+    void set_num_dsp_threads(unsigned int numThreads);
+
+    /**
+     * Backs the block buffers of this (root) graph with huge pages if possible. Only buffers which
+     * are allocated afterwards are affected, so this should be set before the graph is populated.
+     */
+    void set_use_huge_pages(bool useHugePages);
+
+    /**
+     * Returns the number of bytes of block buffers currently in use by this graph and all of its
+     * subgraphs. If <code>numBytesReserved</code> is not <code>NULL</code>, it is set to the total
+     * memory footprint of the buffer arena.
+     */
+    size_t get_buffer_footprint(size_t *numBytesReserved);
+
+    /**
+     * Allows the <code>DspPlan</code> of this (root) graph to reorder independent objects such
+     * that fewer block buffers are live at the same time. The output is unchanged. Off by default.
+     */
+    void set_dsp_reordering(bool isReordering);
+
+    /**
+     * Returns the largest number of block buffers which are live at the same time in the process
+     * order of this (root) graph, before and after reordering, as of the last compilation.
+     */
+    void get_live_buffer_high_water(unsigned int *numBefore, unsigned int *numAfter);
+
     /**
      * Sends the given message to all [receive] objects with the given <code>name</code>.
      * This function is used by message boxes to send messages described be the syntax:
@@ -176,6 +244,20 @@ class PdGraph : public DspObject {
 
     void attachToContext(bool isAttached);
 
+    /**
+     * Computes the process order, resolves all buffers and collects all objects which must be
+     * registered with the context, such that attaching the graph is quick. Only applies to root
+     * graphs which are not attached. The graph must not be changed until it is attached.
+     */
+    void prepare_to_attach();
+
+    /**
+     * Sets the loader on whose thread this root graph is being loaded. Until it is reset to
+     * <code>NULL</code>, everything which is printed in this graph tree is queued by the loader, such
+     * that it is delivered on the thread which attaches the graph.
+     */
+    void setLoader(GraphLoader *loader) { this->loader = loader; }
+
     /**
      * Searches all declared paths to find a file matching the given name. The given filename
      * should be a relative path, NOT a full path.
@@ -218,17 +300,42 @@ class PdGraph : public DspObject {
     /** Locks the context if this graph is attached. */
     void lockContextIfAttached();
 
-    /** Unlocks the context if this graph is attached. */
+    /**
+     * Unlocks the context if this graph is attached. If this ends the outermost edit of the graph
+     * tree, its plan is compiled first if it is stale.
+     */
     void unlockContextIfAttached();
 
     BufferPool *get_buffer_pool();
 
+    /** Returns the arena of the root graph, from which all objects in this graph tree are allocated. */
+    ObjectArena *get_object_arena();
+
+    /** Returns the pool of the root graph, into which all objects in this graph tree spill messages. */
+    DspMessagePool *get_message_pool();
+
     /** Set the graph name. */
     void setName(string newName) { name = newName; }
 
   private:
     static void processGraph(DspObject *dspObject, int fromIndex, int toIndex);
 
+    /**
+     * Processes one block of the parent graph. The inlets buffer the parent's input and the local
+     * objects are processed whenever another hop of samples is available. The outlets overlap-add
+     * the local blocks and return one block to the parent.
+     */
+    void process_reblocked();
+
+    /**
+     * Applies the block size of the given parent block size (or the size set with
+     * <code>setBlockSize()</code>) to all objects in this graph and its subgraphs.
+     */
+    void update_block_size(int parentBlockSize);
+
+    /** Returns the number of samples of the parent graph which are processed per segment. */
+    int get_reblocking_step_size();
+
     /** Create a new object based on its initialisation string. */
     MessageObject *new_object(char *objectType, char *object_label, PdMessage *init_message, PdGraph *graph);
 
@@ -241,6 +348,54 @@ class PdGraph : public DspObject {
 
     void addLetObjectToLetList(MessageObject *inletObject, float newPosition, vector<MessageObject *> *letList);
 
+    /**
+     * Updates the process order and dsp buffers after a connection has been added to or removed
+     * from this graph. Only the affected part of the order is changed. The entire tree is
+     * reordered if the change cannot be made locally.
+     */
+    void update_process_order(MessageObject *fromObject, int outlet_index,
+        MessageObject *toObject, int inlet_index, bool isConnected);
+
+    bool add_dsp_connection_to_order(DspObject *fromObject, int outlet_index,
+        DspObject *toObject, int inlet_index);
+    bool remove_dsp_connection_from_order(DspObject *fromObject, int outlet_index,
+        DspObject *toObject, int inlet_index);
+
+    /** Appends an object which has not yet been ordered to the end of the local process order. */
+    void append_dsp_node(DspObject *dspObject);
+
+    /**
+     * Restores a valid local order after a new connection from <code>fromObject</code> to an
+     * earlier <code>toObject</code> (Pearce & Kelly). Only the nodes ordered between the two objects
+     * which are reachable from either of them are moved. Returns <code>false</code> if the
+     * connection creates a loop or the moved nodes cannot be reordered locally.
+     */
+    bool reorder_dsp_nodes(DspObject *fromObject, DspObject *toObject, vector<DspObject *> *movedNodes);
+
+    /**
+     * Gives each outlet of the given objects a buffer which is not overwritten before all of its
+     * connected inlets have been processed. An outlet which already has an exclusive buffer keeps
+     * it, and all others are given one. Returns <code>false</code> if an outlet is connected to an
+     * object which is not local or to an inlet which sums several connections. Only called on root
+     * graphs.
+     */
+    bool update_dsp_buffers(vector<DspObject *> &producers);
+
+    /** Returns the exclusive buffers at the outlets of the given object to the pool. Root graphs only. */
+    void return_exclusive_dsp_buffers(DspObject *dspObject);
+
+    /** Appends all objects in this graph and its subgraphs to the given list. */
+    void collect_objects_to_register(vector<MessageObject *> *objects);
+
+    /** Rebuilds <code>dspNodeOrder</code> and <code>dspNodeIterators</code> from <code>dspNodeList</code>. */
+    void update_dsp_node_order();
+
+    /**
+     * Compiles the <code>dspPlan</code> of this (root) graph if it is stale. Called by the thread
+     * which edits or attaches the graph while the context is locked, never by the audio thread.
+     */
+    void update_dsp_plan();
+
     /** The <code>pd::Context</code> to which this graph belongs. */
     pd::Context *context;
 
@@ -259,6 +414,21 @@ class PdGraph : public DspObject {
     /** True if the graph is switch on and should process audio. False otherwise. */
     bool switched;
 
+    /** The block size set with <code>setBlockSize()</code>. Zero if the parent's is used. */
+    int requestedBlockSize;
+
+    /** The number of blocks which overlap. The graph is processed every block_size/overlap samples. */
+    int overlap;
+
+    /** True if the block size or overlap of this graph differs from its parent. */
+    bool isReblocked;
+
+    /** True if this graph or any of its parents is reblocked. */
+    bool isInReblockedGraph;
+
+    /** The number of samples of the parent graph received since the graph was last processed. */
+    int samplesSinceLastRun;
+
     /** The parent graph. NULL if this graph is the root. */
     PdGraph *parentGraph;
 
@@ -271,6 +441,55 @@ class PdGraph : public DspObject {
      */
     list<DspObject *> dspNodeList;
 
+    /** The position of each object in <code>dspNodeList</code>. Positions are not contiguous. */
+    map<DspObject *, unsigned int> dspNodeOrder;
+
+    /** The element of each object in <code>dspNodeList</code>, such that it can be moved locally. */
+    map<DspObject *, list<DspObject *>::iterator> dspNodeIterators;
+
+    /**
+     * Buffers which were taken from the <code>BufferPool</code> when the process order was updated
+     * locally. Each is owned by the outlet of one object. They are returned to the pool when that
+     * object is removed, or when the tree is next reordered in full. Only used by root graphs.
+     */
+    set<float *> exclusiveDspBuffers;
+
+    /**
+     * The flattened process order of this graph and all subgraphs. Only used by root graphs.
+     * It is recompiled by <code>update_dsp_plan()</code> when <code>isDspPlanDirty</code> is set.
+     */
+    DspPlan *dspPlan;
+    bool isDspPlanDirty;
+
+    /**
+     * The number of edits of this graph tree which currently hold the context lock. Edits nest
+     * (e.g. removing an object removes its connections), and the plan is only compiled once the
+     * outermost one is complete. Only used by root graphs.
+     */
+    unsigned int numNestedEdits;
+
+    /** Executes the <code>dspPlan</code> in parallel. NULL if processing is serial. */
+    DspScheduler *dspScheduler;
+
+    /** The pool from which all buffers in this graph tree are taken. NULL unless this is a root graph. */
+    BufferPool *bufferPool;
+
+    /** The arena of all objects in this graph tree. NULL unless this is a root graph. */
+    ObjectArena *objectArena;
+
+    /** The message slots of all objects in this graph tree. NULL unless this is a root graph. */
+    DspMessagePool *messagePool;
+
+    /**
+     * Set by <code>prepare_to_attach()</code>. The process order is not recomputed when the graph
+     * is attached, and the objects in <code>preparedObjects</code> are registered in one pass.
+     */
+    bool isProcessOrderPrepared;
+    vector<MessageObject *> preparedObjects;
+
+    /** The loader which is loading this graph tree. NULL unless this is a root graph being loaded. */
+    GraphLoader *loader;
+
     /** A list of all inlet (message or audio) nodes in this subgraph. */
     vector<MessageObject *> inletList; // in fact contains only MessageInlet and DspInlet objects
 
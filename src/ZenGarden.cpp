@@ -24,6 +24,9 @@
 #include <Accelerate/Accelerate.h>
 #endif
 #include <string.h>
+#include "ArrayArithmetic.h"
+#include "ContextBatch.h"
+#include "GraphLoader.h"
 #include "MessageTable.h"
 #include "PdAbstractionDataBase.h"
 #include "pd::Context.h"
@@ -141,6 +144,7 @@ char *zg_object_to_string(ZGObject *object) {
 
 ZGContext *zg_context_new(int num_input_channels, int num_output_channels, int block_size, float sample_rate,
       void *(*callback_function)(ZGCallbackFunction, void *, void *), void *userData) {
+  ArrayArithmetic::init(); // select the widest kernels which this machine supports
   return new pd::Context(num_input_channels, num_output_channels, block_size, sample_rate,
       callback_function, userData);
 }
@@ -152,8 +156,12 @@ void zg_context_delete(ZGContext *context) {
 ZGGraph *zg_context_new_empty_graph(pd::Context *context) {
   pd::Message *init_message = PD_MESSAGE_ON_STACK(0); // create an empty message to use for initialisation
   init_message->from_timestamp(0.0, 0);
-  // the new graph has no parent graph and is created in the given context with a unique id
-  PdGraph *graph = new PdGraph(init_message, NULL, context, context->get_next_graph_id(), "zg_free");
+  // the new graph has no parent graph and is created in the given context with a unique id. Ids are
+  // also taken by the loader thread of a GraphLoader, so the context is locked.
+  context->lock();
+  int graphId = context->get_next_graph_id();
+  context->unlock();
+  PdGraph *graph = new PdGraph(init_message, NULL, context, graphId, "zg_free");
   return graph;
 }
 
@@ -176,6 +184,13 @@ void zg_context_process(pd::Context *context, float *input_buffers, float *outpu
   context->process(input_buffers, output_buffers);
 }
 
+int zg_context_process_frames(ZGContext *context, float *input_buffers, float *output_buffers,
+    unsigned int num_frames, ZGFrameLayout layout) {
+  pd::FrameLayout frameLayout = (layout == ZG_FRAMES_INTERLEAVED)
+      ? pd::FrameLayout::Interleaved : pd::FrameLayout::Planar;
+  return context->process_frames(input_buffers, output_buffers, num_frames, frameLayout).is_ok() ? 0 : -1;
+}
+
 void zg_context_process_s(ZGContext *context, short *input_buffers, short *output_buffers) {
   const int num_input_channels = context->get_num_input_channels();
   const int num_output_channels = context->get_num_output_channels();
@@ -295,11 +310,59 @@ ZGGraph *zg_context_get_graphs(ZGContext *context, unsigned int *n) {
 
 void zg_context_register_external_object(ZGContext *context, const char *object_label,
     ZGObject *(*factory)(ZGMessage *message, ZGGraph *graph)) {
+  context->lock(); // objects may be created on the thread of a GraphLoader
   context->register_external_object(object_label, factory);
+  context->unlock();
 }
 
 void zg_context_unregister_external_object(ZGContext *context, const char *object_label) {
+  context->lock();
   context->unregister_external_object(object_label);
+  context->unlock();
+}
+
+
+#pragma mark - Context Batch Process
+
+ZGContextBatch *zg_context_batch_new(unsigned int num_threads, int pin_threads) {
+  return new ContextBatch(num_threads, pin_threads != 0);
+}
+
+void zg_context_batch_delete(ZGContextBatch *batch) {
+  delete batch;
+}
+
+void zg_context_batch_process(ZGContextBatch *batch, ZGContext **contexts, float **input_buffers,
+    float **output_buffers, unsigned int n, double *render_times) {
+  batch->process(contexts, input_buffers, output_buffers, n, render_times);
+}
+
+void zg_context_batch_remove_context(ZGContextBatch *batch, ZGContext *context) {
+  batch->removeContext(context);
+}
+
+
+#pragma mark - Graph Loader
+
+ZGGraphLoader *zg_graph_loader_new(ZGContext *context) {
+  return new GraphLoader(context);
+}
+
+void zg_graph_loader_delete(ZGGraphLoader *loader) {
+  delete loader;
+}
+
+void zg_graph_loader_load_file(ZGGraphLoader *loader, const char *directory, const char *filename,
+    void *userinfo) {
+  loader->loadFile(directory, filename, userinfo);
+}
+
+void zg_graph_loader_load_string(ZGGraphLoader *loader, const char *netlist, void *userinfo) {
+  loader->loadString(netlist, userinfo);
+}
+
+ZGGraph *zg_graph_loader_attach_next(ZGGraphLoader *loader, void **userinfo) {
+  return loader->attachNext(userinfo);
 }
 
 
@@ -384,6 +447,26 @@ void zg_graph_remove_connection(ZGGraph *graph, ZGObject *fromObject, int outlet
   graph->removeConnection(fromObject, outlet_index, toObject, inlet_index);
 }
 
+void zg_graph_set_num_dsp_threads(ZGGraph *graph, unsigned int numThreads) {
+  graph->set_num_dsp_threads(numThreads);
+}
+
+void zg_graph_set_huge_pages(ZGGraph *graph, int useHugePages) {
+  graph->set_use_huge_pages(useHugePages != 0);
+}
+
+size_t zg_graph_get_buffer_footprint(ZGGraph *graph, size_t *reserved_bytes) {
+  return graph->get_buffer_footprint(reserved_bytes);
+}
+
+void zg_graph_set_dsp_reordering(ZGGraph *graph, int reorder) {
+  graph->set_dsp_reordering(reorder != 0);
+}
+
+void zg_graph_get_live_buffer_high_water(ZGGraph *graph, unsigned int *before, unsigned int *after) {
+  graph->get_live_buffer_high_water(before, after);
+}
+
 unsigned int zg_graph_get_dollar_zero(ZGGraph *graph) {
   return (graph != NULL) ? (unsigned int) graph->getArguments()->get_float(0) : 0;
 }
@@ -491,9 +574,13 @@ char *zg_message_to_string(ZGMessage *message) {
 }
 
 void zg_context_register_memorymapped_abstraction(ZGContext *context, const char *object_label, const char *abstraction) {
+  context->lock(); // the database is copied by the thread of a GraphLoader
   context->get_abstraction_database()->addAbstraction(object_label, abstraction);
+  context->unlock();
 }
 
 void zg_context_unregister_memorymapped_abstraction(ZGContext *context, const char *object_label) {
+  context->lock();
   context->get_abstraction_database()->removeAbstraction(object_label);
+  context->unlock();
 }
@@ -23,6 +23,7 @@
 #ifndef _ZENGARDEN_H_
 #define _ZENGARDEN_H_
 
+#include <stddef.h>
 #include "ZGCallbackFunction.h"
 
 /**
@@ -30,10 +31,14 @@
  * along with the <code>libzengarden</code> library in your project in order to integrate it.
  */
 #ifdef __cplusplus
+class ContextBatch;
+class GraphLoader;
 class pd::Context;
 class PdGraph;
 class MessageObject;
 class PdMessage;
+typedef ContextBatch ZGContextBatch;
+typedef GraphLoader ZGGraphLoader;
 typedef pd::Context ZGContext;
 typedef PdGraph ZGGraph;
 typedef MessageObject ZGObject;
@@ -42,6 +47,8 @@ extern "C" {
 #else
 typedef void ZGGraph;
 typedef void ZGContext;
+typedef void ZGContextBatch;
+typedef void ZGGraphLoader;
 typedef void ZGObject;
 typedef void ZGMessage;
 #endif
@@ -73,6 +80,11 @@ typedef enum ZGConnectionType {
   ZG_CONNECTION_DSP
 } ZGConnectionType;
 
+typedef enum ZGFrameLayout {
+  ZG_FRAMES_PLANAR,
+  ZG_FRAMES_INTERLEAVED
+} ZGFrameLayout;
+
 
 #pragma mark - Context
 
@@ -150,6 +162,41 @@ typedef enum ZGConnectionType {
   /** Returns all objects in this graph. The returned array, with length n, must be freed by the caller. */
   ZGObject **zg_graph_get_objects(ZGGraph *graph, unsigned int *n);
 
+  /**
+   * Sets the number of threads used to process the audio of the given (root) graph. Independent
+   * branches of the graph are processed concurrently, with output identical to serial processing.
+   * The calling thread of zg_context_process() is counted as one of the threads. A value of one
+   * (the default) disables parallel processing.
+   */
+  void zg_graph_set_num_dsp_threads(ZGGraph *graph, unsigned int numThreads);
+
+  /**
+   * Backs the audio buffers of the given (root) graph with huge pages where the system supports
+   * them. Should be called before any objects are added to the graph.
+   */
+  void zg_graph_set_huge_pages(ZGGraph *graph, int useHugePages);
+
+  /**
+   * Returns the number of bytes of audio buffers in use by the given graph. All subgraphs share
+   * one cache-aligned arena, whose total size is written to <code>reserved_bytes</code> if it is
+   * not <code>NULL</code>.
+   */
+  size_t zg_graph_get_buffer_footprint(ZGGraph *graph, size_t *reserved_bytes);
+
+  /**
+   * Allows the objects of the given (root) graph to be processed in another valid order, such
+   * that fewer audio buffers are in use at the same time and each is read soon after it is
+   * written. The output is unchanged. Disabled by default.
+   */
+  void zg_graph_set_dsp_reordering(ZGGraph *graph, int reorder);
+
+  /**
+   * Returns the largest number of audio buffers in use at the same time by the given graph, in
+   * the original process order (<code>before</code>) and in the order which is processed
+   * (<code>after</code>). Both are equal unless reordering is enabled.
+   */
+  void zg_graph_get_live_buffer_high_water(ZGGraph *graph, unsigned int *before, unsigned int *after);
+
 
 #pragma mark - Manage Connections
 
@@ -182,6 +229,77 @@ typedef enum ZGConnectionType {
   /** Process the given context. Audio buffers are channel-interleaved with signed short (16-bit) samples. */
   void zg_context_process_s(ZGContext *context, short *input_buffers, short *output_buffers);
 
+  /**
+   * Process <code>num_frames</code> frames of the given context in one call. <code>num_frames</code>
+   * must be a multiple of the block size. Audio buffers have float (32-bit) samples and are either
+   * planar (all frames of one channel, then the next) or channel-interleaved. Messages are
+   * delivered with the same sample accuracy as when calling <code>zg_context_process()</code> for
+   * every block. Returns 0 on success, or -1 if the frame count or buffers are not valid.
+   */
+  int zg_context_process_frames(ZGContext *context, float *input_buffers, float *output_buffers,
+      unsigned int num_frames, ZGFrameLayout layout);
+
+
+#pragma mark - Context Batch Process
+
+  /**
+   * Create a new batch processor backed by a persistent pool of <code>num_threads</code> worker
+   * threads. If <code>pin_threads</code> is non-zero, each worker is pinned to its own core
+   * (where supported by the platform).
+   */
+  ZGContextBatch *zg_context_batch_new(unsigned int num_threads, int pin_threads);
+
+  /** Delete the batch processor and stop its worker threads. The contexts are not affected. */
+  void zg_context_batch_delete(ZGContextBatch *batch);
+
+  /**
+   * Process one block of each of the <code>n</code> given independent contexts, distributed over
+   * the worker threads. The input and output buffers of context i are input_buffers[i] and
+   * output_buffers[i], formatted as for <code>zg_context_process()</code>. A context is always
+   * processed by the same worker thread. If <code>render_times</code> is not NULL, the time in
+   * seconds spent rendering context i is written to render_times[i]. This function returns once
+   * all contexts have been processed. A context must not be part of two batches at the same time.
+   */
+  void zg_context_batch_process(ZGContextBatch *batch, ZGContext **contexts, float **input_buffers,
+      float **output_buffers, unsigned int n, double *render_times);
+
+  /** Remove a context from the batch processor, e.g. before it is deleted. */
+  void zg_context_batch_remove_context(ZGContextBatch *batch, ZGContext *context);
+
+
+#pragma mark - Graph Loader
+
+  /**
+   * Create a new graph loader for the given context. Graphs are loaded on a background thread
+   * and attached to the context from the audio thread without waiting for them to be parsed.
+   */
+  ZGGraphLoader *zg_graph_loader_new(ZGContext *context);
+
+  /** Delete the graph loader. Loaded graphs which have not yet been attached are deleted. */
+  void zg_graph_loader_delete(ZGGraphLoader *loader);
+
+  /**
+   * Load a graph from file in the background. This function returns immediately. The
+   * <code>userinfo</code> pointer is returned when the graph is attached.
+   */
+  void zg_graph_loader_load_file(ZGGraphLoader *loader, const char *directory, const char *filename,
+      void *userinfo);
+
+  /** Load a graph from a netlist in the background. This function returns immediately. */
+  void zg_graph_loader_load_string(ZGGraphLoader *loader, const char *netlist, void *userinfo);
+
+  /**
+   * Attach the next graph which has finished loading to the context. Its process order and buffers
+   * have already been computed. The graph is returned, and its userinfo pointer is written to
+   * <code>userinfo</code> (if not NULL). Returns NULL if no graph is ready. This function should
+   * be called from the audio thread between calls to <code>zg_context_process()</code>, and does
+   * not wait on the loader. The objects of the graph are registered with the context by this
+   * function, which may allocate memory and takes the context lock. Messages which were printed
+   * while the graph was loaded (and other calls of the context callback) are delivered by this
+   * function, on its caller's thread.
+   */
+  ZGGraph *zg_graph_loader_attach_next(ZGGraphLoader *loader, void **userinfo);
+
 
 #pragma mark - Context Send Message
 
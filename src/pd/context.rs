@@ -33,7 +33,7 @@
 use super::{graph, Graph};
 use crate::{
     allocator::{Allocator, FixedSizeAllocator},
-    error::Error,
+    error::{Error, ErrorKind},
     message::{
         self,
         object::{self, connection},
@@ -166,6 +166,17 @@ pub struct Context<'pd> {
     value_map: heapless::FnvIndexMap<heapless::String<U32>, f32, U32>,
 }
 
+/// Layout of the multichannel buffers passed to [`Context::process_frames`]
+#[derive(Copy, Clone, Debug, Eq, PartialEq)]
+pub enum FrameLayout {
+    /// Channels follow one another: all frames of channel 0, then all frames
+    /// of channel 1, and so on
+    Planar,
+
+    /// Channels alternate within each frame
+    Interleaved,
+}
+
 impl<'pd> Context<'pd> {
     /// Create a new `pd::Context`. This is the first thing you'll need to do in
     /// order to use this crate.
@@ -328,6 +339,117 @@ impl<'pd> Context<'pd> {
             *value = 0.0
         }
 
+        self.process_block();
+
+        // copy the output audio to the given buffer
+        output_buffers.copy_from_slice(self.global_dsp_output_buffers);
+
+        // TODO(tarcieri): multithread support
+        // self.unlock(); // unlock the context
+    }
+
+    /// Render `num_frames` frames in a single call, reading from and writing
+    /// to the given buffers in the given `layout`.
+    ///
+    /// `num_frames` must be a multiple of the block size. Each block is moved
+    /// directly between the caller's buffers and the `adc~`/`dac~` buffers,
+    /// deinterleaving (or interleaving) on the way, and the output buffers are
+    /// cleared in the same pass that copies them out. Messages are delivered
+    /// block by block exactly as with [`Context::process`], so they remain
+    /// sample accurate.
+    pub fn process_frames(
+        &mut self,
+        input_buffers: &[f32],
+        output_buffers: &mut [f32],
+        num_frames: usize,
+        layout: FrameLayout,
+    ) -> Result<(), Error> {
+        let block_size = self.block_size;
+
+        if block_size == 0
+            || num_frames % block_size != 0
+            || input_buffers.len() < num_frames * self.num_input_channels
+            || output_buffers.len() < num_frames * self.num_output_channels
+        {
+            Err(ErrorKind::IndexOutOfBounds)?;
+        }
+
+        // TODO(tarcieri): multithread support
+        // self.lock(); // lock the context
+
+        // The output buffers are left cleared after each block, so they only
+        // need clearing once before the first
+        for value in self.global_dsp_output_buffers.iter_mut() {
+            *value = 0.0
+        }
+
+        for frame in (0..num_frames).step_by(block_size) {
+            // Set up `adc~` buffers
+            for channel in 0..self.num_input_channels {
+                let block = &mut self.global_dsp_input_buffers
+                    [(channel * block_size)..((channel + 1) * block_size)];
+
+                match layout {
+                    FrameLayout::Planar => {
+                        let start = channel * num_frames + frame;
+                        block.copy_from_slice(&input_buffers[start..(start + block_size)]);
+                    }
+                    FrameLayout::Interleaved => {
+                        let stride = self.num_input_channels;
+                        let samples = input_buffers[(frame * stride + channel)..]
+                            .iter()
+                            .step_by(stride);
+
+                        for (value, sample) in block.iter_mut().zip(samples) {
+                            *value = *sample;
+                        }
+                    }
+                }
+            }
+
+            self.process_block();
+
+            // Move the `dac~` output to the given buffer, clearing it for
+            // the next block
+            for channel in 0..self.num_output_channels {
+                let block = &mut self.global_dsp_output_buffers
+                    [(channel * block_size)..((channel + 1) * block_size)];
+
+                match layout {
+                    FrameLayout::Planar => {
+                        let start = channel * num_frames + frame;
+                        let samples = &mut output_buffers[start..(start + block_size)];
+
+                        for (sample, value) in samples.iter_mut().zip(block.iter_mut()) {
+                            *sample = *value;
+                            *value = 0.0;
+                        }
+                    }
+                    FrameLayout::Interleaved => {
+                        let stride = self.num_output_channels;
+                        let samples = output_buffers[(frame * stride + channel)..]
+                            .iter_mut()
+                            .step_by(stride);
+
+                        for (sample, value) in samples.zip(block.iter_mut()) {
+                            *sample = *value;
+                            *value = 0.0;
+                        }
+                    }
+                }
+            }
+        }
+
+        // TODO(tarcieri): multithread support
+        // self.unlock(); // unlock the context
+
+        Ok(())
+    }
+
+    /// Deliver all messages scheduled in the current block and advance the
+    /// block timestamp. The `adc~` buffers must already hold the block's
+    /// input, and the `dac~` buffers must be cleared.
+    fn process_block(&mut self) {
         // Send all messages for this block
         let next_block_start_timestamp = self.block_start_timestamp + self.block_duration;
 
@@ -379,12 +501,6 @@ impl<'pd> Context<'pd> {
         }
 
         self.block_start_timestamp = next_block_start_timestamp;
-
-        // copy the output audio to the given buffer
-        output_buffers.copy_from_slice(self.global_dsp_output_buffers);
-
-        // TODO(tarcieri): multithread support
-        // self.unlock(); // unlock the context
     }
 
     // TODO(tarcieri): pd::Graph
@@ -20,17 +20,25 @@
  *
  */
 
+#include <algorithm>
+#include <set>
+#include "BufferPool.h"
 #include "DeclareList.h"
 #include "DspImplicitAdd.h"
 #include "DspInlet.h"
+#include "DspMessagePool.h"
 #include "DspOutlet.h"
+#include "DspPlan.h"
+#include "DspScheduler.h"
 #include "DspTablePlay.h"
 #include "DspTableRead.h"
 #include "DspTableRead4.h"
+#include "GraphLoader.h"
 #include "MessageInlet.h"
 #include "MessageOutlet.h"
 #include "MessageTableRead.h"
 #include "MessageTableWrite.h"
+#include "ObjectArena.h"
 #include "PdContext.h"
 #include "PdGraph.h"
 #include "utils.h"
@@ -48,10 +56,26 @@ PdGraph::PdGraph(pd::Message *init_message, PdGraph *parentGraph, pd::Context *c
   outletList = vector<message::Object *>();
   nodeList = list<message::Object *>();
   dspNodeList = list<DspObject *>();
+  dspPlan = new DspPlan();
+  isDspPlanDirty = true;
+  numNestedEdits = 0;
+  dspScheduler = NULL;
+  // root graphs resolve their buffers from their own pool, such that they can be ordered without
+  // touching any other graph (e.g. on a GraphLoader thread)
+  bufferPool = (parentGraph == NULL) ? new BufferPool(context->get_block_size()) : NULL;
+  objectArena = (parentGraph == NULL) ? new ObjectArena() : NULL;
+  messagePool = (parentGraph == NULL) ? new DspMessagePool(DSP_MESSAGE_POOL_CAPACITY) : NULL;
+  isProcessOrderPrepared = false;
+  loader = NULL;
   declareList = new DeclareList();
   // all graphs start out unattached to any context, though they exist in a context
   isAttachedToContext = false;
   switched = true; // graphs are switched on by default
+  requestedBlockSize = 0; // graphs use the block size of their parent by default
+  overlap = 1;
+  isReblocked = false;
+  isInReblockedGraph = (parentGraph != NULL) && parentGraph->isInReblockedGraph;
+  samplesSinceLastRun = 0;
   process_function = &processGraph;
 
   // initialise the graph arguments
@@ -68,6 +92,13 @@ PdGraph::PdGraph(pd::Message *init_message, PdGraph *parentGraph, pd::Context *c
 PdGraph::~PdGraph() {
   graphArguments->free_message();
   delete declareList;
+  delete dspScheduler;
+  delete dspPlan;
+
+  // the pool frees the exclusive buffers along with all of its others
+  for (set<float *>::iterator it = exclusiveDspBuffers.begin(); it != exclusiveDspBuffers.end(); ++it) {
+    get_buffer_pool()->returnExclusiveBuffer(*it);
+  }
 
   // remove all implicit +~~ objects
   for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
@@ -83,6 +114,14 @@ PdGraph::~PdGraph() {
   for (list<message::Object *>::iterator it = nodeList.begin(); it != nodeList.end(); ++it) {
     delete *it;
   }
+
+  delete bufferPool;
+
+  // the objects above have returned any message slots which they held
+  delete messagePool;
+
+  // the arena goes last, as all of the objects above may have been allocated from it
+  delete objectArena;
 }
 
 
@@ -91,11 +130,21 @@ PdGraph::~PdGraph() {
 void PdGraph::lockContextIfAttached() {
   if (isAttachedToContext) {
     context->lock();
+    PdGraph *rootGraph = this;
+    while (!rootGraph->isRootGraph()) rootGraph = rootGraph->getParentGraph();
+    rootGraph->numNestedEdits++;
   }
 }
 
 void PdGraph::unlockContextIfAttached() {
   if (isAttachedToContext) {
+    // the plan is compiled once the outermost edit is complete, while the audio thread is still
+    // locked out, such that it only ever executes a finished plan
+    PdGraph *rootGraph = this;
+    while (!rootGraph->isRootGraph()) rootGraph = rootGraph->getParentGraph();
+    if (rootGraph->numNestedEdits > 0 && --rootGraph->numNestedEdits == 0) {
+      rootGraph->update_dsp_plan();
+    }
     context->unlock();
   }
 }
@@ -111,14 +160,28 @@ void PdGraph::addObject(float canvas_x, float canvas_y, message::Object *message
   message_obj->set_coordinates(Coordinates::new(canvas_x, canvas_y));
 
   switch (message_obj->get_object_type()) {
-    case MESSAGE_INLET:
+    case MESSAGE_INLET: {
+      addLetObjectToLetList(message_obj, coordinates.x, &inletList);
+      break;
+    }
     case DSP_INLET: {
       addLetObjectToLetList(message_obj, coordinates.x, &inletList);
+      if (isReblocked) {
+        DspInlet *dspInlet = reinterpret_cast<DspInlet *>(message_obj);
+        dspInlet->setReblocking(true, parentGraph->get_block_size(), get_reblocking_step_size());
+      }
+      break;
+    }
+    case MESSAGE_OUTLET: {
+      addLetObjectToLetList(message_obj, coordinates.x, &outletList);
       break;
     }
-    case MESSAGE_OUTLET:
     case DSP_OUTLET: {
       addLetObjectToLetList(message_obj, coordinates.x, &outletList);
+      if (isReblocked) {
+        DspOutlet *dspOutlet = reinterpret_cast<DspOutlet *>(message_obj);
+        dspOutlet->setReblocking(true, parentGraph->get_block_size(), get_reblocking_step_size());
+      }
       break;
     }
     default: {
@@ -169,7 +232,17 @@ void PdGraph::removeObject(message::Object *object) {
 
       // remove the object from the dspNodeList if the object processes audio
       if (object->doesProcessAudio()) {
-        dspNodeList.remove((DspObject *) object);
+        DspObject *dspObject = (DspObject *) object;
+        map<DspObject *, list<DspObject *>::iterator>::iterator node = dspNodeIterators.find(dspObject);
+        if (node != dspNodeIterators.end()) {
+          dspNodeList.erase(node->second);
+          dspNodeIterators.erase(node);
+        }
+        dspNodeOrder.erase(dspObject);
+        PdGraph *rootGraph = this;
+        while (!rootGraph->isRootGraph()) rootGraph = rootGraph->getParentGraph();
+        rootGraph->return_exclusive_dsp_buffers(dspObject);
+        invalidate_dsp_plan();
       }
 
       // remove the object from any special lists if it is in any of them (e.g., receive, throw~, etc.)
@@ -326,6 +399,21 @@ void PdGraph::unregisterObject(message::Object *message_obj) {
 #pragma mark - Attach to Context
 
 void PdGraph::attach_to_context(bool isAttached) {
+  if (isAttached && isProcessOrderPrepared && !isAttachedToContext) {
+    // the objects to register were collected by prepare_to_attach(), so the tree is not walked
+    isAttachedToContext = true;
+    for (vector<message::Object *>::iterator it = preparedObjects.begin(); it != preparedObjects.end(); ++it) {
+      message::Object *message_obj = *it;
+      if (message_obj->get_object_type() == object::Type::PURE_DATA) {
+        reinterpret_cast<PdGraph *>(message_obj)->isAttachedToContext = true;
+      } else {
+        registerObject(message_obj);
+      }
+    }
+    preparedObjects.clear();
+    return;
+  }
+
   // ensure that this function is only run on attachement change
   if (isAttachedToContext != isAttached) {
     isAttachedToContext = isAttached;
@@ -345,6 +433,28 @@ void PdGraph::attach_to_context(bool isAttached) {
   }
 }
 
+void PdGraph::prepare_to_attach() {
+  if (!isRootGraph() || isAttachedToContext) return;
+
+  // nothing is locked, as the graph is not yet attached
+  compute_deep_local_process_order();
+  update_dsp_plan();
+
+  preparedObjects.clear();
+  collect_objects_to_register(&preparedObjects);
+  isProcessOrderPrepared = true;
+}
+
+void PdGraph::collect_objects_to_register(vector<message::Object *> *objects) {
+  for (list<message::Object *>::iterator it = nodeList.begin(); it != nodeList.end(); ++it) {
+    message::Object *message_obj = *it;
+    objects->push_back(message_obj);
+    if (message_obj->get_object_type() == object::Type::PURE_DATA) {
+      reinterpret_cast<PdGraph *>(message_obj)->collect_objects_to_register(objects);
+    }
+  }
+}
+
 
 #pragma mark - Path Listing
 
@@ -414,15 +524,118 @@ void PdGraph::processGraph(DspObject *dspObject, int fromIndex, int toIndex) {
     // process all dsp objects
     // DSP processing elements are only executed if the graph is switched on
 
-    // TODO(mhroth): iterate depending on local blocksize relative to parent
     // execute all nodes which process audio
-    for (list<DspObject *>::iterator it = d->dspNodeList.begin(); it != d->dspNodeList.end(); ++it) {
-      DspObject *dspObject = *it;
-      dspObject->process_function(dspObject, 0, d->block_sizeInt);
+    if (d->isRootGraph()) {
+      // root graphs execute the flattened plan of the entire graph tree. Subgraphs are inlined
+      // into the plan and are not processed through this function. The plan is never compiled
+      // here, but by the thread which edits the graph (see update_dsp_plan()).
+      if (d->dspScheduler != NULL) {
+        d->dspScheduler->execute(d->dspPlan);
+      } else {
+        d->dspPlan->execute();
+      }
+    } else if (d->isReblocked) {
+      d->process_reblocked();
+    } else {
+      for (list<DspObject *>::iterator it = d->dspNodeList.begin(); it != d->dspNodeList.end(); ++it) {
+        DspObject *dspObject = *it;
+        dspObject->process_function(dspObject, 0, d->block_sizeInt);
+      }
+    }
+  }
+}
+
+void PdGraph::process_reblocked() {
+  int parentBlockSize = parentGraph->get_block_size();
+  int hopSize = block_sizeInt / overlap;
+  int stepSize = get_reblocking_step_size();
+
+  for (vector<message::Object *>::iterator it = inletList.begin(); it != inletList.end(); ++it) {
+    if ((*it)->get_object_type() == DSP_INLET) reinterpret_cast<DspInlet *>(*it)->receiveParentBlock();
+  }
+
+  // the parent block is divided into steps. A local block is processed at the end of each step
+  // at which another hop of samples has been received.
+  for (int i = 0, j = 0; i < parentBlockSize; i += stepSize, j++) {
+    samplesSinceLastRun += stepSize;
+    if (samplesSinceLastRun >= hopSize) {
+      samplesSinceLastRun = 0;
+      for (vector<message::Object *>::iterator it = inletList.begin(); it != inletList.end(); ++it) {
+        if ((*it)->get_object_type() == DSP_INLET) reinterpret_cast<DspInlet *>(*it)->prepareBlock(j);
+      }
+      for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
+        DspObject *dspObject = *it;
+        dspObject->process_function(dspObject, 0, block_sizeInt);
+      }
+    }
+    for (vector<message::Object *>::iterator it = outletList.begin(); it != outletList.end(); ++it) {
+      if ((*it)->get_object_type() == DSP_OUTLET) reinterpret_cast<DspOutlet *>(*it)->emitSamples(i);
     }
   }
 }
 
+void PdGraph::set_num_dsp_threads(unsigned int numThreads) {
+  if (!isRootGraph()) {
+    print_err("The number of dsp threads may only be set on a root graph.");
+    return;
+  }
+
+  lockContextIfAttached();
+  delete dspScheduler;
+  dspScheduler = (numThreads > 1) ? new DspScheduler(numThreads) : NULL;
+  if (dspScheduler != NULL) dspScheduler->prepare(dspPlan);
+  unlockContextIfAttached();
+}
+
+void PdGraph::set_use_huge_pages(bool useHugePages) {
+  if (!isRootGraph()) {
+    print_err("Huge pages may only be enabled on a root graph.");
+    return;
+  }
+  bufferPool->getArena()->setUseHugePages(useHugePages);
+}
+
+size_t PdGraph::get_buffer_footprint(size_t *numBytesReserved) {
+  BufferArena *arena = get_buffer_pool()->getArena();
+  if (numBytesReserved != NULL) *numBytesReserved = arena->getNumBytesReserved();
+  return arena->getNumBytesAllocated();
+}
+
+void PdGraph::set_dsp_reordering(bool isReordering) {
+  if (!isRootGraph()) {
+    print_err("Dsp reordering may only be set on a root graph.");
+    return;
+  }
+
+  lockContextIfAttached();
+  dspPlan->setReordering(isReordering);
+  invalidate_dsp_plan();
+  unlockContextIfAttached();
+}
+
+void PdGraph::get_live_buffer_high_water(unsigned int *numBefore, unsigned int *numAfter) {
+  if (!isRootGraph()) {
+    parentGraph->get_live_buffer_high_water(numBefore, numAfter);
+    return;
+  }
+  dspPlan->getNumLiveBuffers(numBefore, numAfter);
+}
+
+void PdGraph::invalidate_dsp_plan() {
+  if (isRootGraph()) {
+    isDspPlanDirty = true;
+  } else {
+    parentGraph->invalidate_dsp_plan();
+  }
+}
+
+void PdGraph::update_dsp_plan() {
+  if (!isDspPlanDirty) return;
+  dspPlan->compile(this);
+  if (dspScheduler != NULL) dspScheduler->prepare(dspPlan);
+  isDspPlanDirty = false;
+}
+
 
 #pragma mark - Add/Remove Connections (High Level)
 
@@ -439,13 +652,7 @@ void PdGraph::addConnection(message::Object *fromObject, int outlet_index, messa
   lockContextIfAttached();
   toObject->add_connection_from_object_to_inlet(fromObject, outlet_index, inlet_index);
   fromObject->add_connection_to_object_from_outlet(toObject, inlet_index, outlet_index);
-
-  // NOTE(mhroth): very heavy handed approach. Always recompute the process order when adding connections.
-  // In theory this function should check to see if a reordering is even necessary and then only make
-  // the appropriate changes. Usually a complete reevaluation shouldn't be necessary, and otherwise
-  // the use of a linked list to store the node list should make the reordering fast.
-  //  compute_deep_local_process_order();
-
+  update_process_order(fromObject, outlet_index, toObject, inlet_index, true);
   unlockContextIfAttached();
 }
 
@@ -462,13 +669,14 @@ void PdGraph::addConnection(int fromObjectIndex, int outlet_index, int toObjectI
 
 /*
  * removeConnection does not force a reordering of the dspNodeList, as lost connections do not create
- * any new constraints on the dsp object ordering that weren't there already. addConnection does
- * force a reevaluation, as the new connection may force a new constrained how how objects are ordered.
+ * any new constraints on the dsp object ordering that weren't there already. The inlet buffers of
+ * the disconnected object must still be updated.
  */
 void PdGraph::removeConnection(message::Object *fromObject, int outlet_index, message::Object *toObject, int inlet_index) {
   lockContextIfAttached();
   toObject->remove_connection_from_object_to_inlet(fromObject, outlet_index, inlet_index);
   fromObject->remove_connection_to_object_from_outlet(toObject, inlet_index, outlet_index);
+  update_process_order(fromObject, outlet_index, toObject, inlet_index, false);
   unlockContextIfAttached();
 }
 
@@ -605,6 +813,15 @@ float *PdGraph::get_dsp_buffer_at_outlet(int outlet_index) {
   return NULL; // if you've gotten this far, something's gone wrong
 }
 
+void PdGraph::get_dsp_lets(vector<DspObject *> *dspInlets, vector<DspObject *> *dspOutlets) {
+  for (vector<message::Object *>::iterator it = inletList.begin(); it != inletList.end(); ++it) {
+    if ((*it)->get_object_type() == DSP_INLET) dspInlets->push_back(reinterpret_cast<DspObject *>(*it));
+  }
+  for (vector<message::Object *>::iterator it = outletList.begin(); it != outletList.end(); ++it) {
+    if ((*it)->get_object_type() == DSP_OUTLET) dspOutlets->push_back(reinterpret_cast<DspObject *>(*it));
+  }
+}
+
 
 #pragma mark - Process Order
 
@@ -633,6 +850,12 @@ list<DspObject *> PdGraph::get_process_order() {
         default: break;
       }
     }
+    if (isReblocked) {
+      // the buffers at all inlets are now resolved and are read when this graph is processed
+      for (vector<message::Object *>::iterator it = inletList.begin(); it != inletList.end(); ++it) {
+        if ((*it)->get_object_type() == DSP_INLET) reinterpret_cast<DspInlet *>(*it)->releaseParentBuffer();
+      }
+    }
     compute_deep_local_process_order();
     if (doesProcessAudio()) processOrder.push_back(this);
     return processOrder;
@@ -651,6 +874,12 @@ bool PdGraph::is_leaf_node() {
 }
 
 void PdGraph::compute_deep_local_process_order() {
+  // the context orders a graph when it is attached, but a prepared graph is already ordered
+  if (isProcessOrderPrepared) {
+    isProcessOrderPrepared = false;
+    return;
+  }
+
   lockContextIfAttached();
 
   /* clear/reset dspNodeList
@@ -680,6 +909,15 @@ void PdGraph::compute_deep_local_process_order() {
   }
 
   dspNodeList.clear();
+  invalidate_dsp_plan();
+
+  // every buffer is reassigned, so buffers which were set aside by local updates can be shared again
+  if (isRootGraph()) {
+    for (set<float *>::iterator it = exclusiveDspBuffers.begin(); it != exclusiveDspBuffers.end(); ++it) {
+      get_buffer_pool()->returnExclusiveBuffer(*it);
+    }
+    exclusiveDspBuffers.clear();
+  }
 
   // for all leaf nodes, order the tree
   for (list<message::Object *>::iterator it = leafNodeList.begin(); it != leafNodeList.end(); ++it) {
@@ -687,6 +925,7 @@ void PdGraph::compute_deep_local_process_order() {
     list<DspObject *> processSubList = object->get_process_order();
     dspNodeList.splice(dspNodeList.end(), processSubList);
   }
+  update_dsp_node_order();
 
   /* print out process order of local dsp objects (for debugging) */
   /*
@@ -705,6 +944,270 @@ void PdGraph::compute_deep_local_process_order() {
   unlockContextIfAttached();
 }
 
+#pragma mark - Incremental Process Order
+
+// orders the dspNodeList according to dspNodeOrder
+class DspNodeOrderComparator {
+  public:
+    DspNodeOrderComparator(map<DspObject *, unsigned int> *order) : order(order) {}
+    bool operator()(DspObject *a, DspObject *b) { return (*order)[a] < (*order)[b]; }
+  private:
+    map<DspObject *, unsigned int> *order;
+};
+
+// Returns true if the object is a plain local dsp object. Subgraphs and inlet~/outlet~ objects
+// forward their buffers across graph boundaries and are only ordered as part of the full order.
+static bool isLocalDspNode(message::Object *object) {
+  return object->doesProcessAudio() && object->get_object_type() != object::Type::PURE_DATA;
+}
+
+// Returns true if the object can be moved within the local order. Inlets with more than one signal
+// connection are fed by implicit +~~ objects, which are not connected to anything and so would not
+// be moved along with their inputs. Objects connected to subgraphs or outlet~ are left to the full
+// ordering.
+static bool canMoveDspNode(DspObject *dspObject) {
+  for (unsigned int i = 0; i < dspObject->getNumDspInlets(); i++) {
+    if (dspObject->getIncomingDspConnections(i).size() > 1) return false;
+  }
+  for (unsigned int i = 0; i < dspObject->getNumDspOutlets(); i++) {
+    ConnectionSpan outgoing = dspObject->getOutgoingDspConnections(i);
+    for (ConnectionSpan::iterator it = outgoing.begin(); it != outgoing.end(); ++it) {
+      if (!isLocalDspNode((*it).first)) return false;
+      DspObject *toObject = reinterpret_cast<DspObject *>((*it).first);
+      if (toObject->getIncomingDspConnections((*it).second).size() > 1) return false;
+    }
+  }
+  return true;
+}
+
+void PdGraph::update_process_order(message::Object *fromObject, int outlet_index,
+    message::Object *toObject, int inlet_index, bool isConnected) {
+  // unattached graphs are ordered in full when they are attached
+  if (!isAttachedToContext) return;
+
+  // Only signal connections constrain the dsp order. Messages sent from the process function of
+  // a dsp object are scheduled, and so are never received within the same block.
+  if (fromObject->get_connection_type(outlet_index) != DSP) return;
+
+  // the buffers of reblocked graphs are owned by their inlets and outlets, and are not in the plan
+  DspObject *fromDspObject = reinterpret_cast<DspObject *>(fromObject);
+  DspObject *toDspObject = reinterpret_cast<DspObject *>(toObject);
+  bool isUpdated = !isInReblockedGraph && (isConnected
+      ? add_dsp_connection_to_order(fromDspObject, outlet_index, toDspObject, inlet_index)
+      : remove_dsp_connection_from_order(fromDspObject, outlet_index, toDspObject, inlet_index));
+
+  if (isUpdated) {
+    invalidate_dsp_plan(); // compiled once, when the edit is complete
+  } else {
+    PdGraph *rootGraph = this;
+    while (!rootGraph->isRootGraph()) rootGraph = rootGraph->getParentGraph();
+    rootGraph->compute_deep_local_process_order();
+  }
+}
+
+bool PdGraph::add_dsp_connection_to_order(DspObject *fromObject, int outlet_index,
+    DspObject *toObject, int inlet_index) {
+  if (!isLocalDspNode(fromObject) || !isLocalDspNode(toObject)) return false;
+  if (toObject->getIncomingDspConnections(inlet_index).size() > 1) return false;
+
+  append_dsp_node(fromObject);
+  append_dsp_node(toObject);
+
+  vector<DspObject *> producers;
+  if (dspNodeOrder[toObject] < dspNodeOrder[fromObject]) {
+    vector<DspObject *> movedNodes;
+    if (!reorder_dsp_nodes(fromObject, toObject, &movedNodes)) return false;
+
+    // the moved objects write their outlets at a new position, and may now read their inlets
+    // after the buffer has been reused
+    for (vector<DspObject *>::iterator it = movedNodes.begin(); it != movedNodes.end(); ++it) {
+      DspObject *dspObject = *it;
+      producers.push_back(dspObject);
+      for (unsigned int i = 0; i < dspObject->getNumDspInlets(); i++) {
+        ConnectionSpan incoming = dspObject->getIncomingDspConnections(i);
+        if (!incoming.empty()) {
+          producers.push_back(reinterpret_cast<DspObject *>(incoming.front().first));
+        }
+      }
+    }
+  }
+
+  toObject->set_dsp_buffer_at_inlet(fromObject->get_dsp_buffer_at_outlet(outlet_index), inlet_index);
+  producers.push_back(fromObject);
+
+  PdGraph *rootGraph = this;
+  while (!rootGraph->isRootGraph()) rootGraph = rootGraph->getParentGraph();
+  return rootGraph->update_dsp_buffers(producers);
+}
+
+bool PdGraph::remove_dsp_connection_from_order(DspObject *fromObject, int outlet_index,
+    DspObject *toObject, int inlet_index) {
+  // the remaining connections may be summed by a chain of +~~ objects which must be rebuilt
+  if (!isLocalDspNode(toObject) || !toObject->getIncomingDspConnections(inlet_index).empty()) {
+    return false;
+  }
+  // a disconnected inlet reads silence
+  toObject->set_dsp_buffer_at_inlet(get_buffer_pool()->get_zero_buffer(), inlet_index);
+  return true;
+}
+
+void PdGraph::append_dsp_node(DspObject *dspObject) {
+  if (dspNodeOrder.find(dspObject) != dspNodeOrder.end()) return;
+
+  // the end of the order is always valid for a new object, as it has no other signal connections
+  dspNodeOrder[dspObject] = dspNodeList.empty() ? 0 : dspNodeOrder[dspNodeList.back()] + 1;
+  dspNodeIterators[dspObject] = dspNodeList.insert(dspNodeList.end(), dspObject);
+
+  BufferPool *bufferPool = get_buffer_pool();
+  PdGraph *rootGraph = this;
+  while (!rootGraph->isRootGraph()) rootGraph = rootGraph->getParentGraph();
+  for (unsigned int i = 0; i < dspObject->getNumDspInlets(); i++) {
+    dspObject->set_dsp_buffer_at_inlet(bufferPool->get_zero_buffer(), i);
+  }
+  for (unsigned int i = 0; i < dspObject->getNumDspOutlets(); i++) {
+    if (dspObject->canSetBufferAtOutlet(i)) {
+      float *buffer = bufferPool->getExclusiveBuffer();
+      rootGraph->exclusiveDspBuffers.insert(buffer);
+      dspObject->setDspBufferAtOutlet(buffer, i);
+    }
+  }
+}
+
+bool PdGraph::reorder_dsp_nodes(DspObject *fromObject, DspObject *toObject, vector<DspObject *> *movedNodes) {
+  const unsigned int lowerBound = dspNodeOrder[toObject];
+  const unsigned int upperBound = dspNodeOrder[fromObject];
+
+  // all objects reachable from toObject which are ordered before fromObject
+  vector<DspObject *> forward;
+  set<DspObject *> visited;
+  vector<DspObject *> stack(1, toObject);
+  visited.insert(toObject);
+  while (!stack.empty()) {
+    DspObject *dspObject = stack.back(); stack.pop_back();
+    if (!isLocalDspNode(dspObject) || !canMoveDspNode(dspObject)) return false;
+    forward.push_back(dspObject);
+    for (unsigned int i = 0; i < dspObject->getNumDspOutlets(); i++) {
+      ConnectionSpan outgoing = dspObject->getOutgoingDspConnections(i);
+      for (ConnectionSpan::iterator it = outgoing.begin(); it != outgoing.end(); ++it) {
+        DspObject *nextObject = reinterpret_cast<DspObject *>((*it).first);
+        if (nextObject == fromObject) {
+          print_err("A signal loop has been detected between %s and %s.",
+              fromObject->toString().c_str(), toObject->toString().c_str());
+          return false;
+        }
+        map<DspObject *, unsigned int>::iterator order = dspNodeOrder.find(nextObject);
+        if (order != dspNodeOrder.end() && order->second < upperBound && visited.insert(nextObject).second) {
+          stack.push_back(nextObject);
+        }
+      }
+    }
+  }
+
+  // all objects from which fromObject is reachable which are ordered after toObject
+  vector<DspObject *> backward;
+  stack.push_back(fromObject);
+  visited.insert(fromObject);
+  while (!stack.empty()) {
+    DspObject *dspObject = stack.back(); stack.pop_back();
+    if (!isLocalDspNode(dspObject) || !canMoveDspNode(dspObject)) return false;
+    backward.push_back(dspObject);
+    for (unsigned int i = 0; i < dspObject->getNumDspInlets(); i++) {
+      ConnectionSpan incoming = dspObject->getIncomingDspConnections(i);
+      for (ConnectionSpan::iterator it = incoming.begin(); it != incoming.end(); ++it) {
+        DspObject *prevObject = reinterpret_cast<DspObject *>((*it).first);
+        map<DspObject *, unsigned int>::iterator order = dspNodeOrder.find(prevObject);
+        if (order != dspNodeOrder.end() && order->second > lowerBound && visited.insert(prevObject).second) {
+          stack.push_back(prevObject);
+        }
+      }
+    }
+  }
+
+  // the backward objects take the lowest of the positions held by both sets, in their existing
+  // relative order, followed by the forward objects. Only the list elements of the moved objects
+  // are rewritten, all others stay where they are.
+  DspNodeOrderComparator comparator(&dspNodeOrder);
+  sort(forward.begin(), forward.end(), comparator);
+  sort(backward.begin(), backward.end(), comparator);
+  vector<DspObject *> slotObjects(backward);
+  slotObjects.insert(slotObjects.end(), forward.begin(), forward.end());
+  sort(slotObjects.begin(), slotObjects.end(), comparator);
+  vector<unsigned int> positions;
+  vector<list<DspObject *>::iterator> slots;
+  for (vector<DspObject *>::iterator it = slotObjects.begin(); it != slotObjects.end(); ++it) {
+    positions.push_back(dspNodeOrder[*it]);
+    slots.push_back(dspNodeIterators[*it]);
+  }
+  unsigned int k = 0;
+  for (vector<DspObject *>::iterator it = backward.begin(); it != backward.end(); ++it, ++k) {
+    dspNodeOrder[*it] = positions[k];
+    dspNodeIterators[*it] = slots[k];
+    *slots[k] = *it;
+  }
+  for (vector<DspObject *>::iterator it = forward.begin(); it != forward.end(); ++it, ++k) {
+    dspNodeOrder[*it] = positions[k];
+    dspNodeIterators[*it] = slots[k];
+    *slots[k] = *it;
+  }
+
+  movedNodes->insert(movedNodes->end(), backward.begin(), backward.end());
+  movedNodes->insert(movedNodes->end(), forward.begin(), forward.end());
+  return true;
+}
+
+bool PdGraph::update_dsp_buffers(vector<DspObject *> &producers) {
+  // An exclusive buffer is only written by its outlet and only read by the connected inlets, all
+  // of which are ordered after the object. It therefore stays valid wherever the objects are moved.
+  for (vector<DspObject *>::iterator it = producers.begin(); it != producers.end(); ++it) {
+    DspObject *dspObject = *it;
+    if (!isLocalDspNode(dspObject)) return false;
+
+    for (unsigned int i = 0; i < dspObject->getNumDspOutlets(); i++) {
+      // buffers which the object owns itself (e.g. those of r~) are never shared
+      if (!dspObject->canSetBufferAtOutlet(i)) continue;
+      ConnectionSpan outgoing = dspObject->getOutgoingDspConnections(i);
+      if (outgoing.empty()) continue;
+      for (ConnectionSpan::iterator lit = outgoing.begin(); lit != outgoing.end(); ++lit) {
+        if (!isLocalDspNode((*lit).first)) return false;
+        DspObject *toObject = reinterpret_cast<DspObject *>((*lit).first);
+        if (toObject->getIncomingDspConnections((*lit).second).size() > 1) return false;
+      }
+
+      float *buffer = dspObject->get_dsp_buffer_at_outlet(i);
+      if (exclusiveDspBuffers.find(buffer) == exclusiveDspBuffers.end()) {
+        buffer = get_buffer_pool()->getExclusiveBuffer();
+        exclusiveDspBuffers.insert(buffer);
+        dspObject->setDspBufferAtOutlet(buffer, i);
+      }
+      for (ConnectionSpan::iterator lit = outgoing.begin(); lit != outgoing.end(); ++lit) {
+        reinterpret_cast<DspObject *>((*lit).first)->set_dsp_buffer_at_inlet(buffer, (*lit).second);
+      }
+    }
+  }
+  return true;
+}
+
+void PdGraph::return_exclusive_dsp_buffers(DspObject *dspObject) {
+  for (unsigned int i = 0; i < dspObject->getNumDspOutlets(); i++) {
+    set<float *>::iterator it = exclusiveDspBuffers.find(dspObject->get_dsp_buffer_at_outlet(i));
+    if (it != exclusiveDspBuffers.end()) {
+      get_buffer_pool()->returnExclusiveBuffer(*it);
+      exclusiveDspBuffers.erase(it);
+    }
+  }
+}
+
+void PdGraph::update_dsp_node_order() {
+  dspNodeOrder.clear();
+  dspNodeIterators.clear();
+  unsigned int i = 0;
+  for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
+    dspNodeOrder[*it] = i++;
+    dspNodeIterators[*it] = it;
+  }
+}
+
+
 #pragma mark - Print
 
 void PdGraph::print_err(const char *msg, ...) {
@@ -715,7 +1218,13 @@ void PdGraph::print_err(const char *msg, ...) {
   vsnprintf(stringBuffer, maxStringLength-1, msg, ap);
   va_end(ap);
 
-  context->print_err(stringBuffer);
+  PdGraph *rootGraph = this;
+  while (!rootGraph->isRootGraph()) rootGraph = rootGraph->getParentGraph();
+  if (rootGraph->loader != NULL) {
+    rootGraph->loader->queueCallback(ZG_PRINT_ERR, stringBuffer);
+  } else {
+    context->print_err(stringBuffer);
+  }
 }
 
 void PdGraph::print_std(const char *msg, ...) {
@@ -726,12 +1235,22 @@ void PdGraph::print_std(const char *msg, ...) {
   vsnprintf(stringBuffer, maxStringLength-1, msg, ap);
   va_end(ap);
 
-  context->print_std(stringBuffer);
+  PdGraph *rootGraph = this;
+  while (!rootGraph->isRootGraph()) rootGraph = rootGraph->getParentGraph();
+  if (rootGraph->loader != NULL) {
+    rootGraph->loader->queueCallback(ZG_PRINT_STD, stringBuffer);
+  } else {
+    context->print_std(stringBuffer);
+  }
 }
 
 #pragma mark - Get Attributes
 
 double PdGraph::getBlockIndex(pd::Message *message) {
+  // Blocks of reblocked graphs do not coincide with those of the context. Messages take effect at
+  // the start of the next local block.
+  if (isInReblockedGraph) return 0.0;
+
   // sample_rate is in samples/second, but we need samples/millisecond
   return (message->get_timestamp() - context->get_block_start_timestamp()) * 0.001 * context->get_sample_rate();
 }
@@ -789,16 +1308,74 @@ bool PdGraph::doesProcessAudio() {
   return !dspNodeList.empty();
 }
 
-void PdGraph::setBlockSize(int block_size) {
-  // only update blocksize if it is <= the parent's
-  if (block_size <= parentGraph->get_block_size()) {
-    // TODO(mhroth)
-    block_sizeInt = block_size;
-    // update block_duration, etc.
-    // notify all dsp objects and get them to resize their buffers accordingly
+void PdGraph::setBlockSize(int block_size, int overlap) {
+  if (isRootGraph()) {
+    print_err("The block size of a root graph is set by its context.");
+    return;
+  }
+  if (isAttachedToContext) {
+    print_err("The block size of a graph cannot be changed while it is attached to a context.");
+    return;
+  }
+  // block sizes are stored as unsigned shorts by the BufferPool
+  if (block_size < 0 || block_size > 32768 || (block_size & (block_size-1)) != 0 ||
+      overlap < 1 || (overlap & (overlap-1)) != 0) {
+    print_err("Block size %i and overlap %i must be powers of two. Block size remains %i.",
+        block_size, overlap, block_sizeInt);
+    return;
+  }
+  int localBlockSize = (block_size == 0) ? parentGraph->get_block_size() : block_size;
+  if (overlap > localBlockSize) {
+    print_err("Overlap %i may not be larger than the block size %i.", overlap, localBlockSize);
+    return;
+  }
+
+  requestedBlockSize = block_size;
+  this->overlap = overlap;
+  update_block_size(parentGraph->get_block_size());
+}
+
+void PdGraph::update_block_size(int parentBlockSize) {
+  block_sizeInt = (requestedBlockSize == 0) ? parentBlockSize : requestedBlockSize;
+  isReblocked = (block_sizeInt != parentBlockSize) || (overlap > 1);
+  isInReblockedGraph = isReblocked || parentGraph->isInReblockedGraph;
+  samplesSinceLastRun = 0;
+  int stepSize = get_reblocking_step_size();
+
+  for (list<message::Object *>::iterator it = nodeList.begin(); it != nodeList.end(); ++it) {
+    message::Object *message_obj = *it;
+    switch (message_obj->get_object_type()) {
+      case object::Type::PURE_DATA: {
+        reinterpret_cast<PdGraph *>(message_obj)->update_block_size(block_sizeInt);
+        break;
+      }
+      case DSP_INLET: {
+        DspInlet *dspInlet = reinterpret_cast<DspInlet *>(message_obj);
+        dspInlet->onBlockSizeUpdate(block_sizeInt);
+        dspInlet->setReblocking(isReblocked, parentBlockSize, stepSize);
+        break;
+      }
+      case DSP_OUTLET: {
+        DspOutlet *dspOutlet = reinterpret_cast<DspOutlet *>(message_obj);
+        dspOutlet->onBlockSizeUpdate(block_sizeInt);
+        dspOutlet->setReblocking(isReblocked, parentBlockSize, stepSize);
+        break;
+      }
+      default: {
+        if (message_obj->doesProcessAudio()) {
+          reinterpret_cast<DspObject *>(message_obj)->onBlockSizeUpdate(block_sizeInt);
+        }
+        break;
+      }
+    }
   }
 }
 
+int PdGraph::get_reblocking_step_size() {
+  if (isRootGraph()) return block_sizeInt;
+  return min(parentGraph->get_block_size(), block_sizeInt/overlap);
+}
+
 PdGraph *PdGraph::getParentGraph() {
   return parentGraph;
 }
@@ -836,5 +1413,22 @@ list<message::Object *> PdGraph::getNodeList() {
 }
 
 BufferPool *PdGraph::get_buffer_pool() {
-  return context->get_buffer_pool();
+  if (bufferPool != NULL) return bufferPool;
+
+  // subgraphs take their buffers from the root pool for their block size
+  PdGraph *rootGraph = parentGraph;
+  while (!rootGraph->isRootGraph()) rootGraph = rootGraph->parentGraph;
+  return rootGraph->bufferPool->getPoolForSize(block_sizeInt);
+}
+
+ObjectArena *PdGraph::get_object_arena() {
+  PdGraph *rootGraph = this;
+  while (!rootGraph->isRootGraph()) rootGraph = rootGraph->parentGraph;
+  return rootGraph->objectArena;
+}
+
+DspMessagePool *PdGraph::get_message_pool() {
+  PdGraph *rootGraph = this;
+  while (!rootGraph->isRootGraph()) rootGraph = rootGraph->parentGraph;
+  return rootGraph->messagePool;
 }
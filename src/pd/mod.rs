@@ -22,7 +22,10 @@
 mod context;
 pub(crate) mod message;
 
-pub use self::{context::Context, message::Message};
+pub use self::{
+    context::{Context, FrameLayout},
+    message::Message,
+};
 
 use crate::allocator::Allocated;
 use heapless::ArrayLength;
@@ -0,0 +1,205 @@
+/*
+ *  Copyright 2019 NeoBirth Developers
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Checks that every instruction set which <code>ArrayArithmetic</code> can select at run time
+ * produces bit-identical results. Each kernel is run over random ranges of random data (including
+ * signed zeros, infinities, denormals and NaN) with each supported instruction set, and compared
+ * with the scalar path, i.e. written out below exactly as the scalar fallbacks of
+ * ArrayArithmetic.h. Only the sign and payload of a NaN may differ, as the compiler is free to swap
+ * the operands of an addition or multiplication, and with them the NaN which is passed on.
+ * Instruction sets which are not supported by this build or CPU are skipped.
+ *
+ *   c++ -O2 -Isrc test/ArrayArithmeticIsa.cpp src/ArrayArithmetic.cpp -o ArrayArithmeticIsa
+ *   ./ArrayArithmeticIsa
+ *
+ * Exits with a non-zero status if any result differs.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ArrayArithmetic.h"
+
+#define NUM_SAMPLES 320
+#define NUM_ITERATIONS 2000
+#define MAX_INPUTS 20
+
+static const char *isaNames[] = {"default", "avx2", "avx512"};
+
+static int numChecks = 0;
+static int numFailures = 0;
+
+static float randomSample() {
+  switch (rand() % 24) {
+    case 0: return -0.0f;
+    case 1: return 0.0f;
+    case 2: return INFINITY;
+    case 3: return -INFINITY;
+    case 4: return 1e-40f; // denormal
+    case 5: return NAN;
+    default: return (rand() / (float) RAND_MAX - 0.5f) * 1000.0f;
+  }
+}
+
+static void fillRandom(float *buffer) {
+  for (int i = 0; i < NUM_SAMPLES; i++) buffer[i] = randomSample();
+}
+
+/** Compares the whole buffers, such that writes outside of [startIndex, endIndex) are also found. */
+static void compare(const char *kernel, ArrayArithmeticIsa isa, float *output, float *expected,
+    int startIndex, int endIndex) {
+  numChecks++;
+  for (int i = 0; i < NUM_SAMPLES; i++) {
+    if (memcmp(output+i, expected+i, sizeof(float)) != 0 && !(isnan(output[i]) && isnan(expected[i]))) {
+      if (numFailures < 20) {
+        printf("FAIL %s (%s) over [%d, %d) at %d: %a != %a\n", kernel, isaNames[isa],
+            startIndex, endIndex, i, output[i], expected[i]);
+      }
+      numFailures++;
+      return;
+    }
+  }
+}
+
+#pragma mark - Scalar Reference
+
+/** The scalar path of <code>ArrayArithmetic::addManyPass()</code>. */
+static void addManyPass(float **inputs, int numInputs, bool isAccumulating, float *output,
+    int startIndex, int endIndex) {
+  for (int i = startIndex; i < endIndex; i++) {
+    float sum = isAccumulating ? output[i] + inputs[0][i] : inputs[0][i];
+    for (int k = 1; k < numInputs; k++) sum += inputs[k][i];
+    output[i] = sum;
+  }
+}
+
+/** The grouping of <code>ArrayArithmetic::addMany()</code> over the scalar pass above. */
+static void addMany(float **inputs, int numInputs, float *output, int startIndex, int endIndex) {
+  int first = 0;
+  for (int k = 1; k < numInputs; k++) {
+    if (inputs[k] == output) {
+      first = k;
+      break;
+    }
+  }
+  float *group[ARRAY_ARITHMETIC_FAN_IN];
+  int numGrouped = 1;
+  bool isAccumulating = false;
+  group[0] = inputs[first];
+  for (int k = 0; k < numInputs; k++) {
+    if (k == first) continue;
+    group[numGrouped++] = inputs[k];
+    if (numGrouped == ARRAY_ARITHMETIC_FAN_IN) {
+      addManyPass(group, numGrouped, isAccumulating, output, startIndex, endIndex);
+      numGrouped = 0;
+      isAccumulating = true;
+    }
+  }
+  if (numGrouped > 0) addManyPass(group, numGrouped, isAccumulating, output, startIndex, endIndex);
+}
+
+#pragma mark - Kernels
+
+#define CHECK_BINARY(_name, _op) \
+  memcpy(expected, output, NUM_SAMPLES * sizeof(float)); \
+  for (int i = startIndex; i < endIndex; i++) expected[i] = input0[i] _op input1[i]; \
+  ArrayArithmetic::_name(input0, input1, output, startIndex, endIndex); \
+  compare(#_name, isa, output, expected, startIndex, endIndex); \
+  \
+  memcpy(expected, output, NUM_SAMPLES * sizeof(float)); \
+  for (int i = startIndex; i < endIndex; i++) expected[i] = input0[i] _op constant; \
+  ArrayArithmetic::_name(input0, constant, output, startIndex, endIndex); \
+  compare(#_name " (constant)", isa, output, expected, startIndex, endIndex); \
+  \
+  memcpy(expected, input1, NUM_SAMPLES * sizeof(float)); \
+  for (int i = startIndex; i < endIndex; i++) expected[i] = input1[i] _op constant; \
+  ArrayArithmetic::_name(input1, constant, input1, startIndex, endIndex); \
+  compare(#_name " (in place)", isa, input1, expected, startIndex, endIndex);
+
+static void checkIsa(ArrayArithmeticIsa isa) {
+  float *input0 = (float *) aligned_alloc(64, NUM_SAMPLES * sizeof(float));
+  float *input1 = (float *) aligned_alloc(64, NUM_SAMPLES * sizeof(float));
+  float *output = (float *) aligned_alloc(64, NUM_SAMPLES * sizeof(float));
+  float *expected = (float *) aligned_alloc(64, NUM_SAMPLES * sizeof(float));
+  float *inputs[MAX_INPUTS];
+  for (int k = 0; k < MAX_INPUTS; k++) {
+    inputs[k] = (float *) aligned_alloc(64, NUM_SAMPLES * sizeof(float));
+  }
+
+  // the same data for every instruction set
+  srand(1);
+  for (int n = 0; n < NUM_ITERATIONS; n++) {
+    // both short ranges (left to the inline paths) and long ones (dispatched) with any alignment
+    int startIndex = rand() % 64;
+    int endIndex = startIndex + rand() % (NUM_SAMPLES - 64);
+    fillRandom(input0);
+    fillRandom(input1);
+    fillRandom(output);
+    float constant = randomSample();
+
+    CHECK_BINARY(add, +)
+    CHECK_BINARY(subtract, -)
+    CHECK_BINARY(multiply, *)
+    CHECK_BINARY(divide, /)
+
+    memcpy(expected, output, NUM_SAMPLES * sizeof(float));
+    for (int i = startIndex; i < endIndex; i++) expected[i] = constant;
+    ArrayArithmetic::fill(output, constant, startIndex, endIndex);
+    compare("fill", isa, output, expected, startIndex, endIndex);
+
+    // the output is sometimes one of the inputs, as for an implicit add~ in place
+    int numInputs = 1 + rand() % MAX_INPUTS;
+    for (int k = 0; k < numInputs; k++) fillRandom(inputs[k]);
+    int outputIndex = (rand() % 3 == 0) ? rand() % numInputs : -1;
+    float *sum = (outputIndex < 0) ? output : inputs[outputIndex];
+    float *reference[MAX_INPUTS] = {NULL};
+    for (int k = 0; k < numInputs; k++) reference[k] = inputs[k];
+    memcpy(expected, sum, NUM_SAMPLES * sizeof(float));
+    if (outputIndex >= 0) reference[outputIndex] = expected;
+    addMany(reference, numInputs, expected, startIndex, endIndex);
+    ArrayArithmetic::addMany(inputs, numInputs, sum, startIndex, endIndex);
+    compare("addMany", isa, sum, expected, startIndex, endIndex);
+  }
+
+  for (int k = 0; k < MAX_INPUTS; k++) free(inputs[k]);
+  free(expected);
+  free(output);
+  free(input1);
+  free(input0);
+}
+
+int main(int argc, char **argv) {
+  for (int isa = ARRAY_ARITHMETIC_ISA_DEFAULT; isa <= ARRAY_ARITHMETIC_ISA_AVX512; isa++) {
+    if (!ArrayArithmetic::isIsaSupported((ArrayArithmeticIsa) isa)) {
+      printf("%s: not supported, skipped\n", isaNames[isa]);
+      continue;
+    }
+    ArrayArithmetic::setIsa((ArrayArithmeticIsa) isa);
+    int numFailuresBefore = numFailures;
+    checkIsa((ArrayArithmeticIsa) isa);
+    printf("%s: %s\n", isaNames[isa], (numFailures == numFailuresBefore) ? "ok" : "FAILED");
+  }
+  ArrayArithmetic::setIsa(ARRAY_ARITHMETIC_ISA_DEFAULT);
+
+  printf("%d checks, %d failures\n", numChecks, numFailures);
+  return (numFailures == 0) ? 0 : 1;
+}